@@ -0,0 +1,356 @@
+#include "batch.hpp"
+#include "disassembler.hpp"
+#include "flow.hpp"
+#include "mapped_file.hpp"
+#include "rom_set.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <dirent.h>
+#include <fcntl.h>
+#include <map>
+#include <set>
+#include <string.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+// adds a manifest as one image, with the error when it cannot be read. the files it lists go into listed
+static void add_rom_set(const std::string& manifest, std::vector<batch_image>* images, std::set<std::string>* listed)
+{
+    batch_image image;
+    image.path = manifest;
+    image.rom_set = true;
+    std::vector<rom_image> files;
+    if (!read_rom_set(manifest.c_str(), &files, &image.error))
+    {
+        images->push_back(image);
+        return;
+    }
+    for (const rom_image& file : files)
+    {
+        listed->insert(file.path);
+    }
+    images->push_back(image);
+}
+
+std::vector<batch_image> collect_images(const std::vector<std::string>& paths, uint16_t origin)
+{
+    std::vector<batch_image> images;
+    for (const std::string& path : paths)
+    {
+        batch_image image;
+        image.path = path;
+        image.origin = origin;
+        struct stat info;
+        if (stat(path.c_str(), &info) < 0)
+        {
+            // kept so the summary reports it as a failure
+            images.push_back(image);
+            continue;
+        }
+        if (!S_ISDIR(info.st_mode))
+        {
+            if (is_rom_set(path.c_str()))
+            {
+                std::set<std::string> listed;
+                add_rom_set(path, &images, &listed);
+            }
+            else
+            {
+                images.push_back(image);
+            }
+            continue;
+        }
+
+        DIR* dir = opendir(path.c_str());
+        if (!dir)
+        {
+            continue;
+        }
+        std::vector<std::string> entries;
+        while (dirent* entry = readdir(dir))
+        {
+            std::string child = path + "/" + entry->d_name;
+            if (entry->d_name[0] != '.' && stat(child.c_str(), &info) == 0 && S_ISREG(info.st_mode))
+            {
+                entries.push_back(child);
+            }
+        }
+        closedir(dir);
+        std::sort(entries.begin(), entries.end());
+
+        // manifests first, so the files they place are not also taken as images at origin
+        std::set<std::string> listed;
+        for (const std::string& entry : entries)
+        {
+            if (is_rom_set(entry.c_str()))
+            {
+                add_rom_set(entry, &images, &listed);
+            }
+        }
+        for (const std::string& entry : entries)
+        {
+            if (!is_rom_set(entry.c_str()) && !listed.count(entry))
+            {
+                image.path = entry;
+                images.push_back(image);
+            }
+        }
+    }
+    return images;
+}
+
+static std::string base_name(const std::string& path)
+{
+    size_t slash = path.find_last_of('/');
+    return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+// lays a rom set out the way the machine sees it, from $0000 to the end of its last file
+static bool load_set_image(const std::string& manifest, std::vector<uint8_t>* rom, std::string* error)
+{
+    std::vector<rom_image> files;
+    if (!read_rom_set(manifest.c_str(), &files, error))
+    {
+        return false;
+    }
+    uint32_t end = 0;
+    for (const rom_image& file : files)
+    {
+        end = std::max(end, file.base + file.size);
+    }
+    rom->assign(std::min<uint32_t>(end, 0x10000), 0);
+    return load_rom_set(manifest.c_str(), rom->data(), rom->size(), error);
+}
+
+static void analyze_image(const batch_image& image, const std::string& listing_path, const batch_options& options, batch_result* result)
+{
+    auto start = std::chrono::steady_clock::now();
+    result->path = image.path;
+    if (!image.error.empty())
+    {
+        result->error = image.error;
+        return;
+    }
+
+    mapped_file file = {};
+    std::vector<uint8_t> rom;
+    if (image.rom_set && !load_set_image(image.path, &rom, &result->error))
+    {
+        return;
+    }
+    if (!image.rom_set && !map_file(image.path.c_str(), &file))
+    {
+        result->error = "cannot map file";
+        return;
+    }
+    const uint8_t* data = image.rom_set ? rom.data() : file.data;
+    size_t size = image.rom_set ? rom.size() : file.size;
+    result->size = size;
+
+    flow_graph graph;
+    if (options.follow_flow)
+    {
+        graph.analyze(data, size, image.origin, options.entry_points);
+    }
+
+    int fd = -1;
+    if (!listing_path.empty())
+    {
+        fd = open(listing_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+        {
+            result->error = "cannot create listing";
+            if (!image.rom_set)
+            {
+                unmap_file(&file);
+            }
+            return;
+        }
+        result->listing_path = listing_path;
+    }
+
+    if (!graph.entry_points.empty())
+    {
+        result->mode = "flow";
+        result->code_bytes = graph.code_bytes();
+        result->blocks = graph.blocks.size();
+        for (size_t offset = 0; offset < size; ++offset)
+        {
+            if (graph.byte_kinds[offset] == byte_opcode)
+            {
+                result->opcode_counts[data[offset]]++;
+                result->instructions++;
+            }
+        }
+        if (fd >= 0)
+        {
+            output_buffer out(fd);
+            write_listing(graph, data, out);
+            result->ok = out.flush();
+        }
+    }
+    else
+    {
+        // split images such as invaders.g at $0800 have no vector inside them, sweep them instead
+        result->mode = "linear";
+        result->code_bytes = size;
+        size_t pc = 0;
+        while (pc < size)
+        {
+            result->opcode_counts[data[pc]]++;
+            result->instructions++;
+            pc += opcode_lengths[data[pc]];
+        }
+        if (fd >= 0)
+        {
+            output_buffer out(fd);
+            write_linear_listing(data, size, image.origin, out);
+            result->ok = out.flush();
+        }
+    }
+    result->data_bytes = size - result->code_bytes;
+
+    if (fd >= 0)
+    {
+        close(fd);
+        if (!result->ok)
+        {
+            result->error = "listing write failed";
+        }
+    }
+    else
+    {
+        result->ok = true;
+    }
+    if (!image.rom_set)
+    {
+        unmap_file(&file);
+    }
+
+    result->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+std::vector<batch_result> run_batch(const std::vector<batch_image>& images, const batch_options& options)
+{
+    std::vector<batch_result> results(images.size());
+
+    // listings are named after the image, repeated names get the image index as a prefix
+    std::vector<std::string> listing_paths(images.size());
+    if (!options.output_dir.empty())
+    {
+        std::map<std::string, int> seen;
+        for (size_t i = 0; i < images.size(); ++i)
+        {
+            std::string name = base_name(images[i].path);
+            if (seen[name]++ > 0)
+            {
+                name = std::to_string(i) + "_" + name;
+            }
+            listing_paths[i] = options.output_dir + "/" + name + ".lst";
+        }
+    }
+
+    unsigned jobs = options.jobs ? options.jobs : std::max(1u, std::thread::hardware_concurrency());
+    jobs = std::min<size_t>(jobs, std::max<size_t>(1, images.size()));
+
+    // images vary a lot in size, so workers pull the next one instead of taking fixed slices
+    std::atomic<size_t> next(0);
+    auto worker = [&]()
+    {
+        for (size_t i = next++; i < images.size(); i = next++)
+        {
+            analyze_image(images[i], listing_paths[i], options, &results[i]);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned i = 1; i < jobs; ++i)
+    {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+    return results;
+}
+
+static void write_json_string(const std::string& text, FILE* out)
+{
+    fputc('"', out);
+    for (char ch : text)
+    {
+        if (ch == '"' || ch == '\\')
+        {
+            fputc('\\', out);
+            fputc(ch, out);
+        }
+        else if ((unsigned char)ch < 0x20)
+        {
+            fprintf(out, "\\u%04x", ch);
+        }
+        else
+        {
+            fputc(ch, out);
+        }
+    }
+    fputc('"', out);
+}
+
+// instruction mix is reported per mnemonic, so all MOV forms count together
+static std::map<std::string, uint64_t> mnemonic_counts(const uint32_t* opcode_counts)
+{
+    std::map<std::string, uint64_t> counts;
+    for (int opcode = 0; opcode < 256; ++opcode)
+    {
+        if (opcode_counts[opcode] == 0)
+        {
+            continue;
+        }
+        size_t length;
+        const char* text = opcode_text(opcode, &length);
+        const char* space = (const char*)memchr(text, ' ', length);
+        counts[std::string(text, space ? space - text : length)] += opcode_counts[opcode];
+    }
+    return counts;
+}
+
+void write_summary(const std::vector<batch_result>& results, double total_seconds, FILE* out)
+{
+    fprintf(out, "{\n  \"seconds\": %.6f,\n  \"images\": [", total_seconds);
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const batch_result& result = results[i];
+        fprintf(out, "%s\n    {\"path\": ", i ? "," : "");
+        write_json_string(result.path, out);
+        fprintf(out, ", \"ok\": %s", result.ok ? "true" : "false");
+        if (!result.ok)
+        {
+            fprintf(out, ", \"error\": ");
+            write_json_string(result.error, out);
+            fprintf(out, "}");
+            continue;
+        }
+        if (!result.listing_path.empty())
+        {
+            fprintf(out, ", \"listing\": ");
+            write_json_string(result.listing_path, out);
+        }
+        double coverage = result.size ? (double)result.code_bytes / result.size : 0;
+        fprintf(out, ", \"mode\": \"%s\", \"size\": %zu, \"code_bytes\": %zu, \"data_bytes\": %zu, \"code_coverage\": %.4f",
+                result.mode, result.size, result.code_bytes, result.data_bytes, coverage);
+        fprintf(out, ", \"instructions\": %zu, \"blocks\": %zu, \"seconds\": %.6f, \"mix\": {",
+                result.instructions, result.blocks, result.seconds);
+        bool first = true;
+        for (const auto& entry : mnemonic_counts(result.opcode_counts))
+        {
+            fprintf(out, "%s\"%s\": %llu", first ? "" : ", ", entry.first.c_str(), (unsigned long long)entry.second);
+            first = false;
+        }
+        fprintf(out, "}}");
+    }
+    fprintf(out, "\n  ]\n}\n");
+}
@@ -0,0 +1,59 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+struct batch_options
+{
+    // directory for the per image listings, no listings are written when empty
+    std::string output_dir;
+    unsigned jobs = 0; // 0 uses every core
+    // load address of images that are not rom sets
+    uint16_t origin = 0;
+    std::vector<uint16_t> entry_points;
+    bool follow_flow = true;
+};
+
+// an image and where it loads. a rom set is one image, the address space from $0000 to the end of
+// its last file with every file it lists at its base, so flow crosses from one file into the next
+struct batch_image
+{
+    std::string path;
+    uint16_t origin = 0;
+    bool rom_set = false;
+    // set when the manifest could not be read
+    std::string error;
+};
+
+struct batch_result
+{
+    std::string path;
+    std::string listing_path;
+    bool ok = false;
+    std::string error;
+    // "flow", or "linear" when no entry point fell inside the image
+    const char* mode = "";
+    size_t size = 0;
+    size_t code_bytes = 0;
+    size_t data_bytes = 0;
+    size_t instructions = 0;
+    size_t blocks = 0;
+    uint32_t opcode_counts[256] = {};
+    double seconds = 0;
+};
+
+// expands directories into the regular files they contain, sorted so runs are repeatable. a .set manifest
+// is a single image, and the files a manifest next to them lists are only analyzed as part of it.
+// everything else loads at origin
+std::vector<batch_image> collect_images(const std::vector<std::string>& paths, uint16_t origin);
+
+// disassembles and analyzes every image on a pool of threads, results are in the order of images
+std::vector<batch_result> run_batch(const std::vector<batch_image>& images, const batch_options& options);
+
+// machine readable json summary: instruction mix, coverage and timing per image
+void write_summary(const std::vector<batch_result>& results, double total_seconds, FILE* out);
+
+#endif
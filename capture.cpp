@@ -0,0 +1,388 @@
+#include "capture.hpp"
+#include "rom_set.hpp"
+#include <chrono>
+#include <string.h>
+
+/*
+a frame store starts with "i8080fr1" and the vram size as a little endian u32. every frame is then its
+number (u64), a key flag (u8), the payload size (u32) and the payload, the frame's vram xored with the
+one before it and packbits coded. most of the screen does not change between frames, so the xor is
+long runs of zeros. every key_interval frames the previous frame is taken as all zeros, so a damaged
+file can be read from the next key frame on.
+
+packbits: a control byte c below 128 is followed by c + 1 literal bytes, c above 128 by one byte
+repeated 257 - c times.
+*/
+
+static const char store_magic[8] = {'i', '8', '0', '8', '0', 'f', 'r', '1'};
+static const uint64_t key_interval = 300;
+// packbits never grows its input by more than a control byte per 128
+static const size_t packed_max = vram_size + vram_size / 128 + 1;
+
+// png rows are a filter byte and 224 1 bit pixels
+static const size_t png_row = 1 + screen_width / 8;
+static const size_t png_raw = png_row * screen_height;
+
+static void put_u32_le(uint8_t* p, uint32_t value)
+{
+    p[0] = value;
+    p[1] = value >> 8;
+    p[2] = value >> 16;
+    p[3] = value >> 24;
+}
+
+static uint32_t get_u32_le(const uint8_t* p)
+{
+    return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static void put_u32_be(uint8_t* p, uint32_t value)
+{
+    p[0] = value >> 24;
+    p[1] = value >> 16;
+    p[2] = value >> 8;
+    p[3] = value;
+}
+
+static size_t pack_bits(const uint8_t* in, size_t size, uint8_t* out)
+{
+    size_t i = 0;
+    size_t o = 0;
+    while (i < size)
+    {
+        size_t run = 1;
+        while (i + run < size && run < 128 && in[i + run] == in[i])
+        {
+            ++run;
+        }
+        if (run >= 3)
+        {
+            out[o++] = 257 - run;
+            out[o++] = in[i];
+            i += run;
+            continue;
+        }
+        // literals up to the next run of three
+        size_t first = i;
+        while (i < size && i - first < 128 && !(i + 2 < size && in[i] == in[i + 1] && in[i] == in[i + 2]))
+        {
+            ++i;
+        }
+        out[o++] = i - first - 1;
+        memcpy(out + o, in + first, i - first);
+        o += i - first;
+    }
+    return o;
+}
+
+// false if the payload does not fill exactly size bytes
+static bool unpack_bits(const uint8_t* in, size_t in_size, uint8_t* out, size_t size)
+{
+    size_t i = 0;
+    size_t o = 0;
+    while (i < in_size)
+    {
+        uint8_t control = in[i++];
+        if (control < 128)
+        {
+            size_t n = control + 1;
+            if (i + n > in_size || o + n > size)
+            {
+                return false;
+            }
+            memcpy(out + o, in + i, n);
+            i += n;
+            o += n;
+        }
+        else if (control > 128)
+        {
+            size_t n = 257 - control;
+            if (i >= in_size || o + n > size)
+            {
+                return false;
+            }
+            memset(out + o, in[i++], n);
+            o += n;
+        }
+    }
+    return o == size;
+}
+
+static uint32_t adler32(const uint8_t* data, size_t size)
+{
+    uint32_t a = 1;
+    uint32_t b = 0;
+    for (size_t i = 0; i < size; ++i)
+    {
+        a = (a + data[i]) % 65521;
+        b = (b + a) % 65521;
+    }
+    return b << 16 | a;
+}
+
+static bool write_chunk(FILE* out, const char* type, const uint8_t* data, uint32_t size)
+{
+    uint8_t head[8];
+    put_u32_be(head, size);
+    memcpy(head + 4, type, 4);
+    uint8_t tail[4];
+    put_u32_be(tail, crc32(data, size, crc32(head + 4, 4)));
+    return fwrite(head, sizeof(head), 1, out) == 1 && (!size || fwrite(data, size, 1, out) == 1) &&
+           fwrite(tail, sizeof(tail), 1, out) == 1;
+}
+
+capture_format capture_format_of(const char* name)
+{
+    const char* dot = strrchr(name, '.');
+    if (dot && strcmp(dot, ".y4m") == 0)
+    {
+        return capture_y4m;
+    }
+    if (dot && strcmp(dot, ".png") == 0)
+    {
+        return capture_png;
+    }
+    return capture_frames;
+}
+
+bool frame_capture::start(const char* file_name)
+{
+    format = capture_format_of(file_name);
+    name = file_name;
+    error = false;
+    if (format == capture_png)
+    {
+        // one file per frame, named when the frame is written
+        name.resize(name.size() - 4);
+        buffer.reset(new uint8_t[png_raw + 64]);
+    }
+    else
+    {
+        out = fopen(file_name, "wb");
+        if (!out)
+        {
+            return false;
+        }
+        if (format == capture_y4m)
+        {
+            buffer.reset(new uint8_t[screen_width * screen_height]);
+            error = fprintf(out, "YUV4MPEG2 W%d H%d F60:1 Ip A1:1 Cmono\n", screen_width, screen_height) < 0;
+        }
+        else
+        {
+            buffer.reset(new uint8_t[packed_max]);
+            uint8_t size[4];
+            put_u32_le(size, vram_size);
+            error = fwrite(store_magic, sizeof(store_magic), 1, out) != 1 || fwrite(size, sizeof(size), 1, out) != 1;
+        }
+    }
+
+    queue.reset(new spsc_ring<captured_frame, 64>);
+    frames = 0;
+    bytes = 0;
+    encode_seconds = 0;
+    stalls = 0;
+    running.store(true, std::memory_order_release);
+    encoder = std::thread(&frame_capture::encode, this);
+    return true;
+}
+
+void frame_capture::add(const uint8_t* vram, uint64_t number)
+{
+    captured_frame* slot;
+    while (!(slot = queue->claim()))
+    {
+        ++stalls;
+        std::this_thread::yield();
+    }
+    memcpy(slot->vram, vram, vram_size);
+    slot->number = number;
+    queue->publish();
+}
+
+void frame_capture::encode()
+{
+    for (;;)
+    {
+        // read before looking at the queue, so a stop seen here comes after the last add
+        bool stopping = !running.load(std::memory_order_acquire);
+        if (const captured_frame* frame = queue->front())
+        {
+            auto start = std::chrono::steady_clock::now();
+            if (!error && !write_frame(*frame))
+            {
+                error = true;
+            }
+            queue->release();
+            encode_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            ++frames;
+            continue;
+        }
+        if (stopping)
+        {
+            return;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+bool frame_capture::write_frame(const captured_frame& frame)
+{
+    if (format == capture_png)
+    {
+        return write_png(frame);
+    }
+    if (format == capture_y4m)
+    {
+        convert_frame(frame.vram, pixels, 0xff, 0);
+        for (int i = 0; i < screen_width * screen_height; ++i)
+        {
+            buffer[i] = pixels[i];
+        }
+        bytes += 6 + screen_width * screen_height;
+        return fwrite("FRAME\n", 6, 1, out) == 1 && fwrite(buffer.get(), screen_width * screen_height, 1, out) == 1;
+    }
+
+    bool key = frames % key_interval == 0;
+    if (key)
+    {
+        memset(previous, 0, sizeof(previous));
+    }
+    uint8_t delta[vram_size];
+    for (int i = 0; i < vram_size; ++i)
+    {
+        delta[i] = frame.vram[i] ^ previous[i];
+    }
+    memcpy(previous, frame.vram, vram_size);
+    size_t size = pack_bits(delta, vram_size, buffer.get());
+
+    uint8_t head[13];
+    put_u32_le(head, frame.number);
+    put_u32_le(head + 4, frame.number >> 32);
+    head[8] = key;
+    put_u32_le(head + 9, size);
+    bytes += sizeof(head) + size;
+    return fwrite(head, sizeof(head), 1, out) == 1 && fwrite(buffer.get(), size, 1, out) == 1;
+}
+
+// 1 bit grayscale, the image data one stored deflate block, small enough not to need zlib
+bool frame_capture::write_png(const captured_frame& frame)
+{
+    char file_name[4096];
+    snprintf(file_name, sizeof(file_name), "%s-%06llu.png", name.c_str(), (unsigned long long)frame.number);
+    FILE* png = fopen(file_name, "wb");
+    if (!png)
+    {
+        return false;
+    }
+
+    convert_frame(frame.vram, pixels, 1, 0);
+    // zlib header, then a final stored block of png_raw bytes
+    uint8_t* idat = buffer.get();
+    static const uint8_t zlib_head[7] = {0x78, 0x01, 0x01, png_raw & 0xff, png_raw >> 8, (uint8_t)~png_raw, (uint8_t)(~png_raw >> 8)};
+    memcpy(idat, zlib_head, sizeof(zlib_head));
+    uint8_t* raw = idat + sizeof(zlib_head);
+    for (int y = 0; y < screen_height; ++y)
+    {
+        uint8_t* row = raw + y * png_row;
+        const uint16_t* from = pixels + y * screen_width;
+        row[0] = 0;
+        for (int x = 0; x < screen_width / 8; ++x)
+        {
+            uint8_t bits = 0;
+            for (int b = 0; b < 8; ++b)
+            {
+                bits = bits << 1 | from[x * 8 + b];
+            }
+            row[1 + x] = bits;
+        }
+    }
+    put_u32_be(raw + png_raw, adler32(raw, png_raw));
+    size_t idat_size = sizeof(zlib_head) + png_raw + 4;
+
+    static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    uint8_t header[13] = {0};
+    put_u32_be(header, screen_width);
+    put_u32_be(header + 4, screen_height);
+    header[8] = 1;
+    bool written = fwrite(signature, sizeof(signature), 1, png) == 1 && write_chunk(png, "IHDR", header, sizeof(header)) &&
+                   write_chunk(png, "IDAT", idat, idat_size) && write_chunk(png, "IEND", nullptr, 0);
+    bytes += sizeof(signature) + 3 * 12 + sizeof(header) + idat_size;
+    return fclose(png) == 0 && written;
+}
+
+bool frame_capture::stop()
+{
+    if (!encoder.joinable())
+    {
+        return !error;
+    }
+    running.store(false, std::memory_order_release);
+    encoder.join();
+    if (out && fclose(out) != 0)
+    {
+        error = true;
+    }
+    out = nullptr;
+    return !error;
+}
+
+void frame_capture::report(FILE* out) const
+{
+    const char* kind = format == capture_png ? "png" : format == capture_y4m ? "y4m" : "frame store";
+    double raw = (double)frames * vram_size;
+    fprintf(out, "%llu frames captured as %s, %.1f KB, %.0f bytes per frame (%.1f%% of vram)\n",
+            (unsigned long long)frames, kind, bytes / 1024.0, frames ? (double)bytes / frames : 0.0,
+            raw ? 100.0 * bytes / raw : 0.0);
+    fprintf(out, "encoder %.1f us per frame (%.0f frames/s), add waited for it %llu times\n",
+            frames ? encode_seconds * 1e6 / frames : 0.0, encode_seconds ? frames / encode_seconds : 0.0,
+            (unsigned long long)stalls);
+}
+
+frame_store_reader::~frame_store_reader()
+{
+    if (in)
+    {
+        fclose(in);
+    }
+}
+
+bool frame_store_reader::open(const char* name)
+{
+    in = fopen(name, "rb");
+    if (!in)
+    {
+        return false;
+    }
+    uint8_t head[sizeof(store_magic) + 4];
+    memset(previous, 0, sizeof(previous));
+    return fread(head, sizeof(head), 1, in) == 1 && memcmp(head, store_magic, sizeof(store_magic)) == 0 &&
+           get_u32_le(head + sizeof(store_magic)) == vram_size;
+}
+
+bool frame_store_reader::next(uint8_t* vram, uint64_t* number)
+{
+    uint8_t head[13];
+    if (!in || fread(head, sizeof(head), 1, in) != 1)
+    {
+        return false;
+    }
+    uint32_t size = get_u32_le(head + 9);
+    uint8_t packed[packed_max];
+    uint8_t delta[vram_size];
+    if (size > packed_max || fread(packed, size, 1, in) != 1 || !unpack_bits(packed, size, delta, vram_size))
+    {
+        return false;
+    }
+    if (head[8])
+    {
+        memset(previous, 0, sizeof(previous));
+    }
+    for (int i = 0; i < vram_size; ++i)
+    {
+        previous[i] ^= delta[i];
+    }
+    memcpy(vram, previous, vram_size);
+    *number = get_u32_le(head) | (uint64_t)get_u32_le(head + 4) << 32;
+    return true;
+}
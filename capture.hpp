@@ -0,0 +1,90 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include "framebuffer.hpp"
+#include "spsc_ring.hpp"
+#include <atomic>
+#include <memory>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <thread>
+
+enum capture_format
+{
+    // name.frames, every frame 1bpp and run length coded, see frame_store_reader
+    capture_frames,
+    // name.y4m, an 8 bit grayscale yuv4mpeg2 stream of the upright screen, for ffmpeg and friends
+    capture_y4m,
+    // name.png, one 1 bit png per frame as name-000001.png and on
+    capture_png,
+};
+
+// picks the format from the extension, anything unknown is a frame store
+capture_format capture_format_of(const char* name);
+
+struct captured_frame
+{
+    uint8_t vram[vram_size];
+    uint64_t number;
+};
+
+// copies vram into a queue at the end of every screen and leaves the encoding to a thread of its own,
+// so the emulation thread pays one vram sized copy per frame. a full queue makes add wait for the
+// encoder instead of dropping the frame, an archive must not have holes
+class frame_capture
+{
+public:
+    ~frame_capture() { stop(); }
+
+    // opens name and starts the encoder, returns false if name cannot be written
+    bool start(const char* name);
+    // emulation thread
+    void add(const uint8_t* vram, uint64_t number);
+    // encodes what is still queued and closes the file, returns false if anything failed to write
+    bool stop();
+
+    // frames, compressed size and encoder time, and how often add had to wait
+    void report(FILE* out) const;
+
+private:
+    void encode();
+    bool write_frame(const captured_frame& frame);
+    bool write_png(const captured_frame& frame);
+
+    std::unique_ptr<spsc_ring<captured_frame, 64>> queue;
+    std::thread encoder;
+    std::atomic<bool> running{false};
+
+    capture_format format = capture_frames;
+    std::string name;
+    FILE* out = nullptr;
+    bool error = false;
+
+    // encoder thread only
+    uint8_t previous[vram_size];
+    uint16_t pixels[screen_width * screen_height];
+    std::unique_ptr<uint8_t[]> buffer;
+    uint64_t frames = 0;
+    uint64_t bytes = 0;
+    double encode_seconds = 0;
+    // emulation thread only
+    uint64_t stalls = 0;
+};
+
+// reads a frame store back, frame by frame
+class frame_store_reader
+{
+public:
+    ~frame_store_reader();
+
+    bool open(const char* name);
+    // false at the end or on a damaged frame
+    bool next(uint8_t* vram, uint64_t* number);
+
+private:
+    FILE* in = nullptr;
+    uint8_t previous[vram_size] = {};
+};
+
+#endif
@@ -0,0 +1,170 @@
+#include "capture.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+
+// g++ -O2 -pthread capture_check.cpp capture.cpp framebuffer.cpp rom_set.cpp mapped_file.cpp -o capture_check
+// ./capture_check
+static void usage()
+{
+    fprintf(stderr,
+        "usage: capture_check\n"
+        "  writes frames chosen to hit the edges of the packbits coder and the key frames through\n"
+        "  frame_capture, reads them back with frame_store_reader and exits 2 if any frame comes back\n"
+        "  different, a frame is missing or a cut short store reads past its damage\n");
+}
+
+// frames numbered from past 2^32, so both halves of the number go through the file
+static const uint64_t first_number = 0x100000000ull - 3;
+
+static std::vector<captured_frame> check_frames()
+{
+    std::vector<captured_frame> frames;
+    captured_frame frame;
+    memset(frame.vram, 0, vram_size);
+    srand(8080);
+
+    // runs of every length around the 128 byte limits of both kinds of packet, then literals of every
+    // length between runs, each against the frame before it
+    for (int length = 1; length <= 260; ++length)
+    {
+        for (int i = 0; i < vram_size; ++i)
+        {
+            frame.vram[i] = i % (length + 1) == length ? 0x5a : 0xff;
+        }
+        frames.push_back(frame);
+        for (int i = 0; i < vram_size; ++i)
+        {
+            frame.vram[i] = (i / length) % 2 ? 0 : rand();
+        }
+        frames.push_back(frame);
+    }
+
+    // nothing repeats, the payload is literals throughout and the largest a frame can be
+    for (int i = 0; i < vram_size; ++i)
+    {
+        frame.vram[i] = rand();
+    }
+    frames.push_back(frame);
+    frames.push_back(frame);
+
+    // a few bytes changing a frame, the way the game moves, across several key frames
+    for (int step = 0; step < 700; ++step)
+    {
+        for (int change = 0; change < 6; ++change)
+        {
+            frame.vram[rand() % vram_size] ^= 1 << rand() % 8;
+        }
+        frames.push_back(frame);
+    }
+
+    for (size_t i = 0; i < frames.size(); ++i)
+    {
+        frames[i].number = first_number + i;
+    }
+    return frames;
+}
+
+// the frames the store holds, stopping at its end or its first damaged frame
+static std::vector<captured_frame> read_store(const char* name, bool* opened)
+{
+    std::vector<captured_frame> frames;
+    frame_store_reader reader;
+    *opened = reader.open(name);
+    captured_frame frame;
+    while (*opened && reader.next(frame.vram, &frame.number))
+    {
+        frames.push_back(frame);
+    }
+    return frames;
+}
+
+// the number of frames of read that differ from written, read may be a prefix of written
+static size_t compare(const std::vector<captured_frame>& written, const std::vector<captured_frame>& read)
+{
+    size_t differ = 0;
+    for (size_t i = 0; i < read.size() && i < written.size(); ++i)
+    {
+        if (read[i].number != written[i].number || memcmp(read[i].vram, written[i].vram, vram_size) != 0)
+        {
+            if (differ++ == 0)
+            {
+                fprintf(stderr, "frame %zu reads back as number %llu, written as %llu%s\n", i,
+                        (unsigned long long)read[i].number, (unsigned long long)written[i].number,
+                        read[i].number == written[i].number ? " with other pixels" : "");
+            }
+        }
+    }
+    return differ;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc != 1)
+    {
+        usage();
+        return 1;
+    }
+    (void)argv;
+
+    char name[] = "/tmp/capture_check.XXXXXX";
+    int fd = mkstemp(name);
+    if (fd < 0)
+    {
+        fprintf(stderr, "capture_check: cannot make a frame store\n");
+        return 1;
+    }
+    close(fd);
+
+    std::vector<captured_frame> written = check_frames();
+    frame_capture capture;
+    bool ok = capture.start(name);
+    if (ok)
+    {
+        for (const captured_frame& frame : written)
+        {
+            capture.add(frame.vram, frame.number);
+        }
+        ok = capture.stop();
+    }
+    if (!ok)
+    {
+        fprintf(stderr, "capture_check: cannot write %s\n", name);
+        unlink(name);
+        return 1;
+    }
+
+    int failed = 0;
+    bool opened;
+    std::vector<captured_frame> read = read_store(name, &opened);
+    size_t differ = compare(written, read);
+    fprintf(stderr, "%zu frames written, %zu read back, %zu differ\n", written.size(), read.size(), differ);
+    failed += !opened || read.size() != written.size() || differ != 0;
+
+    // one byte short of the last frame, the reader has to stop before it rather than return half of it
+    FILE* store = fopen(name, "rb");
+    long size = 0;
+    if (store && fseek(store, 0, SEEK_END) == 0)
+    {
+        size = ftell(store);
+    }
+    if (store)
+    {
+        fclose(store);
+    }
+    if (size < 1 || truncate(name, size - 1) != 0)
+    {
+        fprintf(stderr, "capture_check: cannot cut %s short\n", name);
+        unlink(name);
+        return 1;
+    }
+    read = read_store(name, &opened);
+    differ = compare(written, read);
+    fprintf(stderr, "cut short: %zu frames read back, %zu differ\n", read.size(), differ);
+    failed += !opened || read.size() != written.size() - 1 || differ != 0;
+
+    unlink(name);
+    return failed ? 2 : 0;
+}
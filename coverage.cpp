@@ -0,0 +1,121 @@
+#include "coverage.hpp"
+#include "disassembler.hpp"
+#include <algorithm>
+#include <string.h>
+
+void code_coverage::on_instruction(uint16_t pc, uint8_t opcode)
+{
+    if (pc >= coverage_rom_size)
+    {
+        return;
+    }
+    opcodes[pc >> 6] |= 1ull << (pc & 63);
+    for (uint16_t address = pc + 1; address < pc + opcode_lengths[opcode] && address < coverage_rom_size; ++address)
+    {
+        operands[address >> 6] |= 1ull << (address & 63);
+    }
+}
+
+static size_t count_bits(const uint64_t* bits, size_t words)
+{
+    size_t total = 0;
+    for (size_t i = 0; i < words; ++i)
+    {
+        total += __builtin_popcountll(bits[i]);
+    }
+    return total;
+}
+
+// one line per run of set bits, "kind start-end" with an inclusive end
+static void write_ranges(const uint64_t* bits, const char* kind, FILE* out)
+{
+    uint32_t address = 0;
+    while (address < coverage_rom_size)
+    {
+        if (!(bits[address >> 6] >> (address & 63) & 1))
+        {
+            ++address;
+            continue;
+        }
+        uint32_t start = address;
+        while (address < coverage_rom_size && (bits[address >> 6] >> (address & 63) & 1))
+        {
+            ++address;
+        }
+        fprintf(out, "%s %04x-%04x\n", kind, start, address - 1);
+    }
+}
+
+bool code_coverage::save(const char* file_name, const char* rom_name) const
+{
+    FILE* out = fopen(file_name, "w");
+    if (!out)
+    {
+        return false;
+    }
+    size_t words = coverage_rom_size / 64;
+    fprintf(out, "# coverage of %s, %zu opcode and %zu operand bytes of %u rom bytes\n",
+            rom_name, count_bits(opcodes, words), count_bits(operands, words), coverage_rom_size);
+    write_ranges(opcodes, "opcode", out);
+    write_ranges(operands, "operand", out);
+    for (int page = 0; page < coverage_ram_pages; ++page)
+    {
+        fprintf(out, "page %02x reads %u writes %u\n", (coverage_ram_start >> 8) + page, reads[page], writes[page]);
+    }
+    bool ok = !ferror(out);
+    return fclose(out) == 0 && ok;
+}
+
+void code_coverage::report(FILE* out) const
+{
+    // a byte can be both, when instructions overlap
+    size_t executed_bytes = 0;
+    for (size_t i = 0; i < coverage_rom_size / 64; ++i)
+    {
+        executed_bytes += __builtin_popcountll(opcodes[i] | operands[i]);
+    }
+    fprintf(out, "%zu of %u rom bytes ran as code (%.1f%%)\n",
+            executed_bytes, coverage_rom_size, 100.0 * executed_bytes / coverage_rom_size);
+
+    int pages[coverage_ram_pages];
+    for (int page = 0; page < coverage_ram_pages; ++page)
+    {
+        pages[page] = page;
+    }
+    std::sort(pages, pages + coverage_ram_pages, [this](int l, int r) {
+        return (uint64_t)reads[l] + writes[l] > (uint64_t)reads[r] + writes[r];
+    });
+    fprintf(out, "hottest ram pages:\n");
+    for (int i = 0; i < 8 && reads[pages[i]] + (uint64_t)writes[pages[i]] > 0; ++i)
+    {
+        int page = pages[i];
+        fprintf(out, "  $%02x00  %12u reads  %12u writes\n", (coverage_ram_start >> 8) + page, reads[page], writes[page]);
+    }
+}
+
+bool load_coverage(const char* file_name, coverage_marks* marks)
+{
+    FILE* in = fopen(file_name, "r");
+    if (!in)
+    {
+        return false;
+    }
+    memset(marks->marks, 0, sizeof(marks->marks));
+    char line[256];
+    while (fgets(line, sizeof(line), in))
+    {
+        char kind[16];
+        unsigned start, end;
+        if (sscanf(line, "%15s %x-%x", kind, &start, &end) != 3 || start > end || end > 0xffff)
+        {
+            continue;
+        }
+        uint8_t mark = strcmp(kind, "opcode") == 0 ? mark_opcode : strcmp(kind, "operand") == 0 ? mark_operand : 0;
+        for (unsigned address = start; address <= end; ++address)
+        {
+            marks->marks[address] |= mark;
+        }
+    }
+    fclose(in);
+    return true;
+}
@@ -0,0 +1,84 @@
+#ifndef COVERAGE_H
+#define COVERAGE_H
+
+#include "observer.hpp"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+const uint16_t coverage_rom_size = 0x2000;
+const uint16_t coverage_ram_start = 0x2000;
+// work ram and video ram, $2000-$3fff
+const int coverage_ram_pages = 32;
+
+// which rom bytes ran as opcodes or operands, and how often each ram page was read and written.
+// attach it as the observer of a core, basic_i8080<code_coverage>. the rom is two 1K bitmaps and the
+// page counters saturate instead of wrapping, so the hooks are a shift, an or and an add
+class code_coverage : public null_observer
+{
+public:
+    bool needs_every_instruction() const { return true; }
+
+    void on_instruction(uint16_t pc, uint8_t opcode);
+    void on_read(uint16_t address, uint8_t) { count(reads, address); }
+    void on_write(uint16_t address, uint8_t) { count(writes, address); }
+
+    bool executed(uint16_t address) const { return address < coverage_rom_size && (opcodes[address >> 6] >> (address & 63) & 1); }
+    bool operand(uint16_t address) const { return address < coverage_rom_size && (operands[address >> 6] >> (address & 63) & 1); }
+
+    // .cov text file read back by the disassembler, see load_coverage
+    bool save(const char* file_name, const char* rom_name) const;
+    // share of the rom executed and the hottest pages
+    void report(FILE* out) const;
+
+    uint32_t reads[coverage_ram_pages] = {};
+    uint32_t writes[coverage_ram_pages] = {};
+
+private:
+    static void count(uint32_t* counters, uint16_t address)
+    {
+        uint16_t page = (uint16_t)(address - coverage_ram_start) >> 8;
+        if (page < coverage_ram_pages)
+        {
+            counters[page] += counters[page] != UINT32_MAX;
+        }
+    }
+
+    uint64_t opcodes[coverage_rom_size / 64] = {};
+    uint64_t operands[coverage_rom_size / 64] = {};
+};
+
+// what a .cov file says about each address, for annotating listings
+enum coverage_mark : uint8_t
+{
+    mark_opcode = 1,
+    mark_operand = 2,
+};
+
+struct coverage_marks
+{
+    uint8_t marks[0x10000];
+};
+
+// reads the opcode and operand ranges of a .cov file, page counts are ignored
+bool load_coverage(const char* file_name, coverage_marks* marks);
+
+// two column prefix of a listing line starting at address and covering length bytes:
+// "+ " ran, "- " never ran, "! " listed as data but ran as code, "  " data
+inline const char* coverage_prefix(const coverage_marks& marks, uint16_t address, size_t length, bool code)
+{
+    if (code)
+    {
+        return marks.marks[address] & mark_opcode ? "+ " : "- ";
+    }
+    for (size_t i = 0; i < length && address + i <= 0xffff; ++i)
+    {
+        if (marks.marks[address + i])
+        {
+            return "! ";
+        }
+    }
+    return "  ";
+}
+
+#endif
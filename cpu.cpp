@@ -1,15 +1,33 @@
 #include "cpu.hpp"
+#include "mapped_file.hpp"
+#include "rom_set.hpp"
 #include <algorithm>
+#include <string.h>
 
 
-i8080::i8080()
+template<typename Observer>
+basic_i8080<Observer>::basic_i8080()
 {
     interrupts_enabled = 0; 
     halt = 0; 
     clock_count = 0; 
+    instruction_count = 0;
+    dirty_pages = 0;
+    next_interrupt = half_frame_cycles;
+    next_interrupt_id = 1;
+    skip_idle_loops = true;
+    idle_cycles_skipped = 0;
+    probe_head = 0;
+    probe_tail = 0;
+    probe_clean = false;
+    fuse_instructions = true;
+    fused_dispatches = 0;
+    native_code = nullptr;
 
     std::fill(in_port, in_port + 4, 0);
-    std::fill(in_port, in_port + 7, 0);
+    std::fill(out_port, out_port + 7, 0);
+    reg_shift = 0;
+    shift_offset = 0;
 
     in_port[0] |= 1 << 1;
 	in_port[0] |= 1 << 2;
@@ -35,40 +53,240 @@ i8080::i8080()
 
 
 
-uint8_t i8080::read_byte(uint16_t address)
+template<typename Observer>
+uint8_t basic_i8080<Observer>::read_byte(uint16_t address)
 {
-    return memory[address]; 
+    uint8_t value = memory[address];
+    observer.on_read(address, value);
+    return value; 
 }
 
-uint16_t i8080::read_word(uint16_t address)
+template<typename Observer>
+uint16_t basic_i8080<Observer>::read_word(uint16_t address)
 {
     return read_byte(address) | (read_byte(address + 1) << 8); 
 }
 
-void i8080::write_byte(uint16_t address, uint8_t val)
+template<typename Observer>
+void basic_i8080<Observer>::write_byte(uint16_t address, uint8_t val)
 {
+    observer.on_write(address, val);
     if (address >= 0x2000 && address <= 0x4000)
     {
         memory[address] = val; 
+        dirty_pages |= 1ull << ((address - 0x2000) >> 8);
     }
 }
 
-void i8080::write_word(uint16_t address, uint16_t val)
+template<typename Observer>
+void basic_i8080<Observer>::write_word(uint16_t address, uint16_t val)
 {
     write_byte(address, val & 0xff); 
     write_byte(address + 1, val >> 8); 
 }
 
-void i8080::generate_interrupt(uint8_t id)
+template<typename Observer>
+uint8_t basic_i8080<Observer>::read_port(uint8_t port)
 {
+    uint8_t value = 0;
+    if (port == 3)
+    {
+        // the shift register result, a window of 8 bits chosen by the offset written to port 2
+        value = (reg_shift >> (8 - shift_offset)) & 0xff;
+    }
+    else if (port < 4)
+    {
+        value = in_port[port];
+    }
+    observer.on_in(port, value);
+    return value;
+}
+
+template<typename Observer>
+void basic_i8080<Observer>::write_port(uint8_t port, uint8_t value)
+{
+    observer.on_out(port, value);
+    if (port == 2)
+    {
+        shift_offset = value & 0x7;
+    }
+    else if (port == 4)
+    {
+        // new data goes in the high byte, the old high byte moves down
+        reg_shift = (value << 8) | (reg_shift >> 8);
+    }
+    if (port < 7)
+    {
+        out_port[port] = value;
+    }
+}
+
+template<typename Observer>
+bool basic_i8080<Observer>::load_rom(const char* file_name)
+{
+    mapped_file file;
+    if (!map_file(file_name, &file))
+    {
+        return false;
+    }
+    bool fits = file.size <= rom_size;
+    if (fits)
+    {
+        memcpy(memory, file.data, file.size);
+    }
+    unmap_file(&file);
+    return fits;
+}
+
+template<typename Observer>
+bool basic_i8080<Observer>::load_rom_set(const char* manifest_name, std::string* error)
+{
+    return ::load_rom_set(manifest_name, memory, rom_size, error);
+}
+
+template<typename Observer>
+bool basic_i8080<Observer>::load_rom_or_set(const char* file_name, std::string* error)
+{
+    if (is_rom_set(file_name))
+    {
+        return load_rom_set(file_name, error);
+    }
+    if (!load_rom(file_name))
+    {
+        *error = "cannot load " + std::string(file_name);
+        return false;
+    }
+    return true;
+}
+
+template<typename Observer>
+void basic_i8080<Observer>::restore(const basic_i8080& snapshot)
+{
+    uint64_t pages = dirty_pages;
+    while (pages)
+    {
+        uint32_t address = 0x2000 + (__builtin_ctzll(pages) << 8);
+        // the last page is the single byte at $4000 that write_byte lets through
+        memcpy(memory + address, snapshot.memory + address, std::min<uint32_t>(0x100, 0x10000 - address));
+        pages &= pages - 1;
+    }
+    dirty_pages = 0;
+
+    pc = snapshot.pc;
+    sp = snapshot.sp;
+    opcode = memory + (snapshot.opcode - snapshot.memory);
+    a = snapshot.a;
+    b = snapshot.b;
+    c = snapshot.c;
+    d = snapshot.d;
+    e = snapshot.e;
+    h = snapshot.h;
+    l = snapshot.l;
+    z = snapshot.z;
+    s = snapshot.s;
+    p = snapshot.p;
+    cy = snapshot.cy;
+    ac = snapshot.ac;
+    reg_shift = snapshot.reg_shift;
+    shift_offset = snapshot.shift_offset;
+    std::copy(snapshot.in_port, snapshot.in_port + 4, in_port);
+    std::copy(snapshot.out_port, snapshot.out_port + 7, out_port);
+    halt = snapshot.halt;
+    interrupts_enabled = snapshot.interrupts_enabled;
+    clock_count = snapshot.clock_count;
+    instruction_count = snapshot.instruction_count;
+    next_interrupt = snapshot.next_interrupt;
+    next_interrupt_id = snapshot.next_interrupt_id;
+    // a loop probed in the other timeline says nothing about this one
+    probe_clean = false;
+}
+
+template<typename Observer>
+void basic_i8080<Observer>::save_state(machine_state* state) const
+{
+    memcpy(state->memory, memory, sizeof(memory));
+    save_registers(&state->registers);
+}
+
+template<typename Observer>
+void basic_i8080<Observer>::save_registers(machine_registers* state) const
+{
+    state->pc = pc;
+    state->sp = sp;
+    state->a = a;
+    state->b = b;
+    state->c = c;
+    state->d = d;
+    state->e = e;
+    state->h = h;
+    state->l = l;
+    state->flags = (s << 7) | (z << 6) | (ac << 4) | (p << 2) | (1 << 1) | cy;
+    state->reg_shift = reg_shift;
+    state->shift_offset = shift_offset;
+    std::copy(in_port, in_port + 4, state->in_port);
+    std::copy(out_port, out_port + 7, state->out_port);
+    state->halt = halt;
+    state->interrupts_enabled = interrupts_enabled;
+    state->next_interrupt_id = next_interrupt_id;
+    state->clock_count = clock_count;
+    state->instruction_count = instruction_count;
+    state->next_interrupt = next_interrupt;
+}
+
+template<typename Observer>
+void basic_i8080<Observer>::load_state(const machine_state& state)
+{
+    memcpy(memory, state.memory, sizeof(memory));
+    // every ram page, $2000 through the byte at $4000
+    dirty_pages = (1ull << 33) - 1;
+    load_registers(state.registers);
+}
+
+template<typename Observer>
+void basic_i8080<Observer>::load_registers(const machine_registers& state)
+{
+    pc = state.pc;
+    sp = state.sp;
+    opcode = memory + pc;
+    a = state.a;
+    b = state.b;
+    c = state.c;
+    d = state.d;
+    e = state.e;
+    h = state.h;
+    l = state.l;
+    s = state.flags >> 7 & 0x1;
+    z = state.flags >> 6 & 0x1;
+    ac = state.flags >> 4 & 0x1;
+    p = state.flags >> 2 & 0x1;
+    cy = state.flags & 0x1;
+    reg_shift = state.reg_shift;
+    shift_offset = state.shift_offset;
+    std::copy(state.in_port, state.in_port + 4, in_port);
+    std::copy(state.out_port, state.out_port + 7, out_port);
+    halt = state.halt;
+    interrupts_enabled = state.interrupts_enabled;
+    next_interrupt_id = state.next_interrupt_id;
+    clock_count = state.clock_count;
+    instruction_count = state.instruction_count;
+    next_interrupt = state.next_interrupt;
+    probe_clean = false;
+}
+
+template<typename Observer>
+void basic_i8080<Observer>::generate_interrupt(uint8_t id)
+{
+    observer.on_interrupt(id);
     sp -= 1;
-    memory[sp] = (pc & 0xff00) << 8;
+    write_byte(sp, (pc & 0xff00) >> 8);
     sp -= 1;
-    memory[sp] = pc & 0xff;
+    write_byte(sp, pc & 0xff);
     pc = 8 * id; 
+    halt = 0;
 }
 
-int i8080::parity(uint16_t result)
+template<typename Observer>
+int basic_i8080<Observer>::parity(uint16_t result)
 {
     int count = 0;
     while (result != 0)
@@ -87,21 +305,23 @@ int i8080::parity(uint16_t result)
 // 0x80 = 1000 0000
 // 0xff = 1111 1111
 
-// we bitmask before storing to ensure it fits in an 8 bit register
-void i8080::handle_arith_flag(uint16_t result)
+// we bitmask before storing to ensure it fits in an 8 bit register.
+// ac depends on the operands rather than the result, the instructions set it themselves
+template<typename Observer>
+void basic_i8080<Observer>::handle_arith_flag(uint16_t result)
 {
     // zero flag - set to 1 when result == 0
     z = ((result & 0xff) == 0);
     // sign flag - set to 1 when msb is set(negative)
     s = ((result & 0x80) != 0);
-    // cy flag - set to 1 when instruction resultd in a carry
+    // cy flag - set to 1 when instruction resultd in a carry, or a borrow as a subtraction wraps past 8 bits
     cy = (result > 0xff);
     // parity flag - set to 1 if result is even
     p = parity(result & 0xff);
-    ac = (result > 0x09);
 }
 
-void i8080::handle_without_carry(uint16_t result)
+template<typename Observer>
+void basic_i8080<Observer>::handle_without_carry(uint16_t result)
 {
     // zero flag - set to 1 when result == 0
     z = ((result & 0xff) == 0);
@@ -109,10 +329,10 @@ void i8080::handle_without_carry(uint16_t result)
     s = ((result & 0x80) != 0);
     // parity flag - set to 1 if result is even
     p = parity(result & 0xff);
-    ac = (result > 0x09);
 }
 
-void i8080::handle_without_ac(uint16_t result) 
+template<typename Observer>
+void basic_i8080<Observer>::handle_without_ac(uint16_t result) 
 {
      // zero flag - set to 1 when result == 0
     z = ((result & 0xff) == 0);
@@ -122,38 +342,54 @@ void i8080::handle_without_ac(uint16_t result)
     p = parity(result & 0xff);
 }
 
-void i8080::unimplemented_instruction()
+template<typename Observer>
+void basic_i8080<Observer>::unimplemented_instruction()
 {
     --pc; 
+    if (observer.on_unimplemented(pc, memory[pc]))
+    {
+        // skipped like a nop
+        ++pc;
+        clock_count += 4;
+        return;
+    }
     exit(1); 
 }
 
-void i8080::ADD(uint8_t *reg)
+template<typename Observer>
+void basic_i8080<Observer>::ADD(uint8_t *reg)
 {
     uint16_t result = a + *reg;
+    ac = ((a & 0xf) + (*reg & 0xf)) > 0xf;
     handle_arith_flag(result);
     a = result & 0xff;
 }
 
-void i8080::ADC(uint8_t *reg)
+template<typename Observer>
+void basic_i8080<Observer>::ADC(uint8_t *reg)
 {
-    uint16_t result = a + c + *reg;
+    uint16_t result = a + *reg + cy;
+    ac = ((a & 0xf) + (*reg & 0xf) + cy) > 0xf;
     handle_arith_flag(result);
     a = result & 0xff;
 }
 
-void i8080::ANA(uint8_t *reg)
+template<typename Observer>
+void basic_i8080<Observer>::ANA(uint8_t *reg)
 {
     uint16_t result = a & *reg;
     handle_arith_flag(result);
     cy = 0; 
+    // the 8080 sets ac from bit 3 of the operands
+    ac = ((a | *reg) & 0x08) != 0;
     a = result & 0xff;
 }
 
 // the call routine works by first saving the return address, we increment pc by 2 as the address that is being called is 2 bytes
 // save return address onto stack
 // set pc to the address that is being called
-void i8080::CALL()
+template<typename Observer>
+void basic_i8080<Observer>::CALL()
 {
     uint16_t return_address = pc + 2;
     sp -= 2; 
@@ -161,26 +397,29 @@ void i8080::CALL()
     pc = (opcode[2] << 8) | opcode[1];
 }
 
-void i8080::CMA()
+template<typename Observer>
+void basic_i8080<Observer>::CMA()
 {
     a = ~a;
 }
 
-void i8080::CMC()
+template<typename Observer>
+void basic_i8080<Observer>::CMC()
 {
-    c = ~c;
+    cy = !cy;
 }
 
-void i8080::CMP(uint8_t *reg)
+template<typename Observer>
+void basic_i8080<Observer>::CMP(uint8_t *reg)
 {
+    // a subtraction that only keeps the flags
     uint16_t result = a - *reg;
-    cy = (a < *reg);
-    z = (result == 0);
-    s = ((result & 0x80) != 0);
-    p = parity(result & 0xff);
+    ac = ((a & 0xf) + (~*reg & 0xf) + 1) > 0xf;
+    handle_arith_flag(result);
 }
 
-void i8080::DAA()
+template<typename Observer>
+void basic_i8080<Observer>::DAA()
 {
     uint8_t temp = 0;
     if ((a & 0xf) > 9 || ac) {
@@ -191,11 +430,13 @@ void i8080::DAA()
         cy = 1;
     }
     uint16_t result = a + temp; 
+    ac = ((a & 0xf) + (temp & 0xf)) > 0xf;
     handle_without_carry(result);
     a = result & 0xff; 
 }
 
-void i8080::DAD(uint8_t *reg1, uint8_t *reg2)
+template<typename Observer>
+void basic_i8080<Observer>::DAD(uint8_t *reg1, uint8_t *reg2)
 {
     uint32_t pair = (*reg1 << 8) | *reg2;
     uint32_t hl = (h << 8) | l;
@@ -205,14 +446,18 @@ void i8080::DAD(uint8_t *reg1, uint8_t *reg2)
     l = result & 0xff;
 }
 
-void i8080::DCR(uint8_t *reg)
+template<typename Observer>
+void basic_i8080<Observer>::DCR(uint8_t *reg)
 {
-    uint16_t result = --*reg;
+    uint8_t result = *reg - 1;
+    // no borrow out of the low nibble unless it wrapped from 0 to f
+    ac = (result & 0xf) != 0xf;
     handle_without_carry(result); 
-    *reg = result & 0xff;
+    *reg = result;
 }
 
-void i8080::DCX(uint8_t *reg1, uint8_t *reg2)
+template<typename Observer>
+void basic_i8080<Observer>::DCX(uint8_t *reg1, uint8_t *reg2)
 {
     --*reg2;
     if (*reg2 == 0xff)
@@ -221,71 +466,83 @@ void i8080::DCX(uint8_t *reg1, uint8_t *reg2)
     }
 }
 
-void i8080::INR(uint8_t *reg)
+template<typename Observer>
+void basic_i8080<Observer>::INR(uint8_t *reg)
 {
-    uint16_t result = ++*reg;
+    uint8_t result = *reg + 1;
+    ac = (result & 0xf) == 0;
     handle_without_carry(result);
-    *reg = result & 0xff;
+    *reg = result;
 }
 
-void i8080::INX(uint8_t *reg1, uint8_t *reg2)
+template<typename Observer>
+void basic_i8080<Observer>::INX(uint8_t *reg1, uint8_t *reg2)
 {
-    ++reg2;
-    if (reg2 == 0)
+    ++*reg2;
+    if (*reg2 == 0)
     {
-        ++reg1;
+        ++*reg1;
     }
 }
 
-void i8080::JMP()
+template<typename Observer>
+void basic_i8080<Observer>::JMP()
 {
     pc = (opcode[2] << 8) | opcode[1];
 }
 
-void i8080::LDA()
+template<typename Observer>
+void basic_i8080<Observer>::LDA()
 {
     uint16_t address = (opcode[2] << 8) | opcode[1];
     a = read_byte(address); 
     pc += 2;
 }
 
-void i8080::LDAX(uint8_t *reg1, uint8_t *reg2)
+template<typename Observer>
+void basic_i8080<Observer>::LDAX(uint8_t *reg1, uint8_t *reg2)
 {
     uint16_t address = (*reg1 << 8) | *reg2;
     a = read_byte(address); 
 }
 
-void i8080::LHLD()
+template<typename Observer>
+void basic_i8080<Observer>::LHLD()
 {
     uint16_t address = (opcode[2] << 8) | opcode[1];
     l = read_byte(address); 
     h = read_byte(address + 1); 
 }
 
-void i8080::LXI(uint8_t *reg1, uint8_t *reg2)
+template<typename Observer>
+void basic_i8080<Observer>::LXI(uint8_t *reg1, uint8_t *reg2)
 {
     *reg1 = opcode[2];
     *reg2 = opcode[1];
 }
 
-void i8080::ORA(uint8_t *reg)
+template<typename Observer>
+void basic_i8080<Observer>::ORA(uint8_t *reg)
 {
     uint16_t result = a | *reg;
     cy = 0;
+    ac = 0;
     z = (result == 0);
     s = ((result & 0x80) != 0);
     p = parity(result & 0xff);
     a = result & 0xff;
 }
 
-void i8080::POP(uint8_t *reg1, uint8_t *reg2)
+template<typename Observer>
+void basic_i8080<Observer>::POP(uint8_t *reg1, uint8_t *reg2)
 {
     *reg2 = read_byte(sp); 
     *reg1 = read_byte(sp + 1); 
     sp += 2;
 }
 
-void i8080::POP_PSW()
+template<typename Observer>
+void basic_i8080<Observer>::POP_PSW()
 {
     a = read_byte(sp + 1); 
     uint8_t psw = read_byte(sp); 
@@ -297,7 +554,8 @@ void i8080::POP_PSW()
     sp += 2;
 }
 
-void i8080::PUSH(uint8_t *reg1, uint8_t *reg2)
+template<typename Observer>
+void basic_i8080<Observer>::PUSH(uint8_t *reg1, uint8_t *reg2)
 {
     sp -= 1;
     write_byte(sp, *reg1); 
@@ -305,15 +563,19 @@ void i8080::PUSH(uint8_t *reg1, uint8_t *reg2)
     write_byte(sp, *reg2);
 }
 
-void i8080::PUSH_PSW()
+template<typename Observer>
+void basic_i8080<Observer>::PUSH_PSW()
 {
     uint8_t psw = (s << 7) | (z << 6) | (ac << 4) | (p << 2) | (1 << 1) | cy;
-    sp -= 2; 
+    // a above the flags, the way pop psw reads them back
+    sp -= 1; 
     write_byte(sp, a); 
+    sp -= 1; 
     write_byte(sp, psw); 
 }
 
-void i8080::RAL()
+template<typename Observer>
+void basic_i8080<Observer>::RAL()
 {
     uint8_t high_bit = a >> 7;
     uint8_t temp = a;
@@ -321,7 +583,8 @@ void i8080::RAL()
     cy = high_bit;
 }
 
-void i8080::RAR()
+template<typename Observer>
+void basic_i8080<Observer>::RAR()
 {
     uint8_t low_bit = a & 0x1;
     uint8_t temp = cy;
@@ -329,28 +592,32 @@ void i8080::RAR()
     a = (a >> 1) | (temp << 7);
 }
 
-void i8080::RET()
+template<typename Observer>
+void basic_i8080<Observer>::RET()
 {
     // values are stored in opposite order on the stack, thus the first part of address will be lower on the stack
     pc = (read_byte(sp + 1) << 8) | read_byte(sp);
     sp += 2;
 }
 
-void i8080::RLC()
+template<typename Observer>
+void basic_i8080<Observer>::RLC()
 {
     uint8_t high_bit = a >> 7;
     cy = high_bit;
     a = (a << 1) | high_bit;
 }
 
-void i8080::RRC()
+template<typename Observer>
+void basic_i8080<Observer>::RRC()
 {
     uint8_t low_bit = a & 0x1;
     cy = low_bit;
     a = (a >> 1) | (low_bit << 7);
 }
 
-void i8080::RST(int n)
+template<typename Observer>
+void basic_i8080<Observer>::RST(int n)
 {
     write_byte(sp - 1, pc >> 8); 
     write_byte(sp - 2, pc & 0xff); 
@@ -358,36 +625,43 @@ void i8080::RST(int n)
     pc = 8 * n; 
 }
 
-void i8080::SHLD()
+template<typename Observer>
+void basic_i8080<Observer>::SHLD()
 {
     uint16_t address = (opcode[2] << 8) | opcode[1];
     write_byte(address, l); 
     write_byte(address + 1, h); 
 }
 
-void i8080::STA()
+template<typename Observer>
+void basic_i8080<Observer>::STA()
 {
     uint16_t address = (opcode[2] << 8) | opcode[1];
     write_byte(address, a); 
     pc += 2; 
 }
 
-void i8080::SBB(uint8_t *reg)
+template<typename Observer>
+void basic_i8080<Observer>::SBB(uint8_t *reg)
 {
-    *reg += cy;
-    uint16_t result = a - *reg;
+    // the operand is only read, the borrow is subtracted along with it
+    uint16_t result = a - *reg - cy;
+    ac = ((a & 0xf) + (~*reg & 0xf) + !cy) > 0xf;
     handle_arith_flag(result);
     a = result & 0xff;
 }
 
-void i8080::SUB(uint8_t *reg)
+template<typename Observer>
+void basic_i8080<Observer>::SUB(uint8_t *reg)
 {
     uint16_t result = a - *reg;
-    handle_without_carry(result);
-    cy = (!result > 0xff);
+    ac = ((a & 0xf) + (~*reg & 0xf) + 1) > 0xf;
+    handle_arith_flag(result);
+    a = result & 0xff;
 }
 
-void i8080::XCHG()
+template<typename Observer>
+void basic_i8080<Observer>::XCHG()
 {
     uint8_t temp_d = d;
     uint8_t temp_e = e;
@@ -397,7 +671,8 @@ void i8080::XCHG()
     l = temp_e;
 }
 
-void i8080::XRA(uint8_t *reg)
+template<typename Observer>
+void basic_i8080<Observer>::XRA(uint8_t *reg)
 {
     uint16_t result = a ^ *reg;
     handle_without_carry(result);
@@ -406,798 +681,1614 @@ void i8080::XRA(uint8_t *reg)
     a = result;
 }
 
-void i8080::XTHL()
+template<typename Observer>
+void basic_i8080<Observer>::XTHL()
+{
+    // swaps hl with the word on top of the stack, sp itself stays put
+    uint8_t temp_l = read_byte(sp);
+    uint8_t temp_h = read_byte(sp + 1);
+    write_byte(sp, l); 
+    write_byte(sp + 1, h); 
+    l = temp_l;
+    h = temp_h; 
+}
+
+// opcodes that can run inside a skippable idle loop: no memory writes, no stack, no out, no interrupt
+// enable changes
+static const uint8_t idle_safe[256] = {
+    1, 1, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 0, 1, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    0, 0, 1, 1, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1, 0,
+    0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1, 1, 0, 0, 1, 0,
+    0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1, 1, 0, 0, 1, 0,
+    0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1, 0,
+};
+
+template<typename Observer>
+uint64_t basic_i8080<Observer>::register_signature()
+{
+    uint8_t flags = (s << 7) | (z << 6) | (ac << 4) | (p << 2) | cy;
+    return (uint64_t)a | ((uint64_t)b << 8) | ((uint64_t)c << 16) | ((uint64_t)d << 24) |
+           ((uint64_t)e << 32) | ((uint64_t)h << 40) | ((uint64_t)l << 48) | ((uint64_t)flags << 56);
+}
+
+// called after a backward jump from tail to pc. if the previous backward jump took the same edge,
+// every instruction since then was idle safe and the registers came back unchanged, the loop is at a
+// fixed point: memory cannot change until the next interrupt, so every further iteration is identical.
+// whole iterations are then skipped in one step, only those that end by cycle so the exit point is exact.
+// the back jump that closed the loop may itself have carried clock_count past cycle
+template<typename Observer>
+void basic_i8080<Observer>::probe_idle_loop(uint16_t tail, uint64_t cycle)
+{
+    uint64_t signature = register_signature();
+    if (probe_clean && probe_head == pc && probe_tail == tail && probe_sp == sp && probe_signature == signature &&
+        clock_count + (clock_count - probe_clock) <= cycle)
+    {
+        uint64_t period = clock_count - probe_clock;
+        uint64_t iterations = (cycle - clock_count) / period;
+        clock_count += iterations * period;
+        instruction_count += iterations * (instruction_count - probe_instructions);
+        idle_cycles_skipped += iterations * period;
+    }
+
+    probe_head = pc;
+    probe_tail = tail;
+    probe_sp = sp;
+    probe_signature = signature;
+    probe_clock = clock_count;
+    probe_instructions = instruction_count;
+    probe_clean = true;
+}
+
+// first opcodes of the sequences emulate_fused handles, checked before paying for its switch. each
+// entry is the length of that first instruction, the second opcode follows it
+static const uint8_t fused_head[256] = {
+    0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0,
+    0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0,
+    0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 3, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 1, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+};
+
+// the block copy at $1a32 and the sprite and shift loops around it are where a frame spends most
+// of its time: ldax d; mov m, a; inx h followed by inx d; dcr b; jnz. with idle skipping off, --profile
+// puts the polls first, lda; dcr a; jnz and lda; ana a; jnz, then mov a, m; ana a; jnz and
+// inx h; dcr b; jnz. each sequence here does the work of its single step cases in the same order, so
+// registers, flags and clock_count come out exactly as if it had been stepped. returns false when
+// there is no handler for the code at pc
+template<typename Observer>
+bool basic_i8080<Observer>::emulate_fused()
+{
+    // the longest sequence is five bytes, one that would wrap past $ffff is left to emulate
+    if (pc > 0x10000 - 5)
+    {
+        return false;
+    }
+    uint8_t* code = &memory[pc];
+    switch ((code[0] << 8) | code[fused_head[code[0]]])
+    {
+    // ldax d; mov m, a, and inx h when it follows
+    case 0x1a77:
+    {
+        LDAX(&d, &e);
+        uint16_t address = (h << 8) | l; write_byte(address, a);
+        if (code[2] == 0x23)
+        {
+            INX(&h, &l); pc += 3; clock_count += 19; instruction_count += 3;
+        }
+        else
+        {
+            pc += 2; clock_count += 14; instruction_count += 2;
+        }
+        // memory changed, this cannot be an idle loop
+        probe_clean = false;
+        return true;
+    }
+    // ldax d; inx d
+    case 0x1a13:
+        LDAX(&d, &e); INX(&d, &e); pc += 2; clock_count += 12; instruction_count += 2; return true;
+    // mov m, a; inx h
+    case 0x7723:
+    {
+        uint16_t address = (h << 8) | l; write_byte(address, a);
+        INX(&h, &l); pc += 2; clock_count += 12; instruction_count += 2;
+        probe_clean = false;
+        return true;
+    }
+    // mov a, m; inx h
+    case 0x7e23:
+    {
+        uint16_t address = (h << 8) | l; a = read_byte(address);
+        INX(&h, &l); pc += 2; clock_count += 12; instruction_count += 2; return true;
+    }
+    // inx d; dcr b, and jnz when it follows
+    case 0x1305:
+        INX(&d, &e); DCR(&b);
+        if (code[2] == 0xc2)
+        {
+            opcode = code + 2; pc += 3;
+            if (z == 0x0) JMP(); else pc += 2;
+            clock_count += 20; instruction_count += 3;
+        }
+        else
+        {
+            pc += 2; clock_count += 10; instruction_count += 2;
+        }
+        return true;
+    // inx h; dcr b, and jnz when it follows
+    case 0x2305:
+        INX(&h, &l); DCR(&b);
+        if (code[2] == 0xc2)
+        {
+            opcode = code + 2; pc += 3;
+            if (z == 0x0) JMP(); else pc += 2;
+            clock_count += 20; instruction_count += 3;
+        }
+        else
+        {
+            pc += 2; clock_count += 10; instruction_count += 2;
+        }
+        return true;
+    // mov a, m; ana a, and jnz when it follows
+    case 0x7ea7:
+    {
+        uint16_t address = (h << 8) | l; a = read_byte(address); ANA(&a);
+        if (code[2] == 0xc2)
+        {
+            opcode = code + 2; pc += 3;
+            if (z == 0x0) JMP(); else pc += 2;
+            clock_count += 21; instruction_count += 3;
+        }
+        else
+        {
+            pc += 2; clock_count += 11; instruction_count += 2;
+        }
+        return true;
+    }
+    // lda a16; dcr a, and jnz when it follows
+    case 0x3a3d:
+    {
+        uint16_t address = (code[2] << 8) | code[1]; a = read_byte(address); DCR(&a);
+        if (code[4] == 0xc2)
+        {
+            opcode = code + 4; pc += 5;
+            if (z == 0x0) JMP(); else pc += 2;
+            clock_count += 28; instruction_count += 3;
+        }
+        else
+        {
+            pc += 4; clock_count += 18; instruction_count += 2;
+        }
+        return true;
+    }
+    // lda a16; ana a, and jnz or jz when it follows
+    case 0x3aa7:
+    {
+        uint16_t address = (code[2] << 8) | code[1]; a = read_byte(address); ANA(&a);
+        if (code[4] == 0xc2 || code[4] == 0xca)
+        {
+            opcode = code + 4; pc += 5;
+            if ((z == 0x0) == (code[4] == 0xc2)) JMP(); else pc += 2;
+            clock_count += 27; instruction_count += 3;
+        }
+        else
+        {
+            pc += 4; clock_count += 17; instruction_count += 2;
+        }
+        return true;
+    }
+    // dcr b; jnz
+    case 0x05c2:
+        DCR(&b); opcode = code + 1; pc += 2;
+        if (z == 0x0) JMP(); else pc += 2;
+        clock_count += 15; instruction_count += 2; return true;
+    // dcr c; jnz
+    case 0x0dc2:
+        DCR(&c); opcode = code + 1; pc += 2;
+        if (z == 0x0) JMP(); else pc += 2;
+        clock_count += 15; instruction_count += 2; return true;
+    default:
+        return false;
+    }
+}
+
+template<typename Observer>
+void basic_i8080<Observer>::run_until(uint64_t cycle)
+{
+    if (native_code)
+    {
+        native_code(*this, cycle);
+        return;
+    }
+    if (!skip_idle_loops && !fuse_instructions)
+    {
+        while (clock_count < cycle && !halt)
+        {
+            emulate();
+        }
+        // only an interrupt wakes a halted cpu, and those are raised between calls
+        if (halt && clock_count < cycle)
+        {
+            clock_count = cycle;
+        }
+        return;
+    }
+
+    while (clock_count < cycle)
+    {
+        if (halt)
+        {
+            idle_cycles_skipped += skip_idle_loops ? cycle - clock_count : 0;
+            clock_count = cycle;
+            break;
+        }
+        // observers that must see every instruction get plain steps, with the null observer this folds away
+        if (observer.needs_every_instruction())
+        {
+            probe_clean = false;
+            emulate();
+            continue;
+        }
+        uint16_t from = pc;
+        // only a fused sequence's head is checked, its handler clears probe_clean if the rest is not idle safe
+        probe_clean &= idle_safe[memory[pc]];
+
+        // a fused sequence must end before the interrupt, or the interrupt would land late
+        if (fuse_instructions && fused_head[memory[pc]] && clock_count + max_fused_cycles < cycle && emulate_fused())
+        {
+            fused_dispatches++;
+        }
+        else
+        {
+            emulate();
+        }
+
+        // a fused poll that jumps back to its own head lands on from
+        if (skip_idle_loops && pc <= from)
+        {
+            probe_idle_loop(from, cycle);
+        }
+    }
+    // an interrupt is about to change memory, a loop seen before it proves nothing after it
+    probe_clean = false;
+}
+
+template<typename Observer>
+uint8_t basic_i8080<Observer>::run_half_frame()
 {
-    uint8_t temp_l = l;
-    uint8_t temp_h = h;
-    l = read_byte(sp); 
-    write_byte(sp, temp_l); 
-    sp += 1;
-    write_byte(sp, temp_h); 
-    h = read_byte(sp); 
+    run_until(next_interrupt);
+
+    uint8_t id = next_interrupt_id;
+    // the cpu acknowledges an interrupt by disabling further ones until the handler runs ei
+    if (interrupts_enabled)
+    {
+        interrupts_enabled = 0;
+        generate_interrupt(id);
+    }
+    next_interrupt += half_frame_cycles;
+    next_interrupt_id = id == 1 ? 2 : 1;
+    return id;
 }
 
-int i8080::emulate()
+template<typename Observer>
+int basic_i8080<Observer>::emulate()
 {
     instruction_count++; 
+    uint64_t start_clock = clock_count;
     // opcode is a pointer to the location in memory where the instruction is stored
     opcode = &memory[pc];
-   // clock_count = instruction_cycles[opcode]; 
+    observer.on_instruction(pc, *opcode);
 
     pc += 1; 
     switch (*opcode)
     {
     // nop
     case 0x00:
+    {
         clock_count += 4; break;
+    }
     // lxi b, word
     case 0x01:
+    {
         LXI(&b, &c); pc += 2; clock_count += 10; break;
+    }
     // stax, b
     case 0x02:
+    {
         uint16_t bc = (b << 8) | c; write_byte(bc, a); clock_count += 7; break;
+    }
     // inx, b
     case 0x03:
+    {
         INX(&b, &c); clock_count += 5; break;
+    }
     // inr, b
     case 0x04:
+    {
         INR(&b); clock_count += 5; break;
+    }
     // dcr, b
     case 0x05:
+    {
         DCR(&b); clock_count += 5; break;
+    }
     // mvi, b, d8
     case 0x06:
+    {
         b = opcode[1]; pc++ ; clock_count += 7; break;
+    }
     // rlc
     case 0x07:
+    {
         RLC(); clock_count += 4; break;
+    }
     // nop
     case 0x08:
+    {
         clock_count += 4; break;
+    }
     // dad b
     case 0x09:
+    {
         DAD(&b, &c); clock_count += 10; break;
+    }
     // ldax b
     case 0xa:
+    {
         LDAX(&b, &c); clock_count += 7; break;
+    }
     // dcx b
     case 0xb:
+    {
         DCX(&b, &c); clock_count += 5; break;
+    }
     // inr c
     case 0xc:
+    {
         INR(&c); clock_count += 5; break;
+    }
     // dcr, c
     case 0xd:
+    {
         DCR(&c); clock_count += 5; break;
+    }
     // mvi, c, d8
     case 0xe:
-        c = opcode[1]; pc++; clock_count += 7; break; 
+    {
+        c = opcode[1]; pc++; clock_count += 7; break;
+    }
     // rrc
     case 0xf:
+    {
         RRC(); clock_count += 4; break;
+    }
     // nop
     case 0x10:
+    {
         clock_count += 4; break;
+    }
     // lxi d, d16
     case 0x11:
+    {
         LXI(&d, &e); pc += 2; clock_count += 10; break;
+    }
     // stax d
     case 0x12:
+    {
         uint16_t address = (d << 8) | e; write_byte(address, a); clock_count += 7; break;
+    }
     // inx d
     case 0x13:
+    {
         INX(&d, &e); clock_count += 5; break;
+    }
     // inr, d
     case 0x14:
+    {
         INR(&d); clock_count += 5; break;
+    }
     // dcr, d
     case 0x15:
+    {
         DCR(&d); clock_count += 5; break;
+    }
     // mvi d, d8
     case 0x16:
+    {
         d = opcode[1]; pc ++ ; clock_count += 7; break;
+    }
     // ral
     case 0x17:
+    {
         RAL(); clock_count += 4; break;
+    }
     // nop
     case 0x18:
+    {
         clock_count += 4; break;
+    }
     // dad d
     case 0x19:
+    {
         DAD(&d, &e); clock_count += 10; break;
+    }
     // ldax, d
     case 0x1a:
+    {
         LDAX(&d, &e); clock_count += 7; break;
+    }
     // dcx, d
     case 0x1b:
+    {
         DCX(&d, &e); clock_count += 5; break;
+    }
     // inr e
     case 0x1c:
+    {
         INR(&e); clock_count += 5; break;
+    }
     // dcr, e
     case 0x1d:
+    {
         DCR(&e); clock_count += 5; break;
+    }
     // mvi, e, d8
     case 0x1e:
+    {
         e = opcode[1]; pc++; clock_count += 7; break;
+    }
     // rar
     case 0x1f:
+    {
         RAR(); clock_count += 4; break;
+    }
     // nop
     case 0x20:
+    {
         clock_count += 4; break;
+    }
     // lxi h, d16
     case 0x21:
+    {
         LXI(&h, &l); pc += 2; clock_count += 10; break;
+    }
     // shld a16
     case 0x22:
+    {
         SHLD(); pc += 2; clock_count += 16; break;
+    }
     // inx, h
     case 0x23:
+    {
         INX(&h, &l); clock_count += 5; break;
+    }
     // inr h
     case 0x24:
+    {
         INR(&h); clock_count += 5; break;
+    }
     // dcr, h
     case 0x25:
+    {
         DCR(&h); clock_count += 5; break;
+    }
     // mvi h, d8
     case 0x26:
+    {
         h = opcode[1]; pc ++; clock_count += 7; break;
+    }
     // daa
     case 0x27:
+    {
         DAA(); clock_count += 4; break;
+    }
     // nop
     case 0x28:
+    {
         clock_count += 4; break;
+    }
     // dad h
     case 0x29:
+    {
         DAD(&h, &l); clock_count += 10; break;
+    }
     // lhld a16
     case 0x2a:
+    {
         LHLD(); pc +=2 ; clock_count += 16; break;
+    }
     // dcx h
     case 0x2b:
+    {
         DCX(&h, &l); clock_count += 5; break;
+    }
     // inr l
     case 0x2c:
+    {
         INR(&l); clock_count += 5; break;
+    }
     // dcr l
     case 0x2d:
-        DCR(&l); clock_count += 5;
+    {
+        DCR(&l); clock_count += 5; break;
+    }
     // mvi l, d8
     case 0x2e:
+    {
         l = opcode[1]; pc ++; clock_count += 7; break;
+    }
     // cma
     case 0x2f:
-        clock_count += 4; CMA();
+    {
+        CMA(); clock_count += 4; break;
+    }
     // nop
     case 0x30:
+    {
         clock_count += 4; break;
+    }
     // lxi sp, d16
     case 0x31:
+    {
         uint8_t second = opcode[1]; uint8_t third = opcode[2]; sp = (third << 8) | second; pc += 2; clock_count += 10; break;
+    }
     // sta a16
     case 0x32:
+    {
         STA(); clock_count += 13; break;
+    }
     // inx sp
     case 0x33:
-        ++sp; clock_count += 5;
+    {
+        ++sp; clock_count += 5; break;
+    }
     // inr m
     case 0x34:
-        uint16_t address = (h << 8) | l; memory[address]++; handle_without_carry(memory[address]); clock_count += 10; break;
+    {
+        uint16_t address = (h << 8) | l; uint8_t value = read_byte(address); INR(&value); write_byte(address, value); clock_count += 10; break;
+    }
     // dcr m
     case 0x35:
-        uint16_t address = (h << 8) | l; memory[address]--; handle_without_carry(memory[address]); clock_count += 10; break;
+    {
+        uint16_t address = (h << 8) | l; uint8_t value = read_byte(address); DCR(&value); write_byte(address, value); clock_count += 10; break;
+    }
     // mvi m, d8
     case 0x36:
+    {
         uint16_t address = (h << 8) | l; write_byte(address, opcode[1]); pc++; clock_count += 10; break;
+    }
     // stc
     case 0x37:
-        cy = 0x1; clock_count += 4;
+    {
+        cy = 0x1; clock_count += 4; break;
+    }
     // nop
     case 0x38:
+    {
         clock_count += 4; break;
+    }
     // dad sp
     case 0x39:
-        uint16_t pair = (h << 8) | l; uint32_t result = pair + sp; cy = ((result & 0xffff0000) > 0); h = (result >> 8) & 0xff; l = result * 0xff; clock_count += 10; break;
+    {
+        uint16_t pair = (h << 8) | l; uint32_t result = pair + sp; cy = ((result & 0xffff0000) > 0); h = (result >> 8) & 0xff; l = result & 0xff; clock_count += 10; break;
+    }
     // lda a16
     case 0x3a:
-        LDA(); clock_count += 16; break;
+    {
+        LDA(); clock_count += 13; break;
+    }
     // dcx sp
     case 0x3b:
+    {
         --sp; clock_count += 5; break;
+    }
     // inr a
     case 0x3c:
+    {
         INR(&a); clock_count += 5; break;
+    }
     // dcr a
     case 0x3d:
+    {
         DCR(&a); clock_count += 5; break;
+    }
     // mvi a, d8
     case 0x3e:
+    {
         a = opcode[1]; pc += 1; clock_count += 7; break;
+    }
     // cmc
     case 0x3f:
-        cy = ~cy; clock_count += 4; break;
+    {
+        CMC(); clock_count += 4; break;
+    }
     // mov b, b
     case 0x40:
+    {
         clock_count += 5; break;
+    }
     // mov b, c
     case 0x41:
-        b = c; clock_count += 5; break; 
+    {
+        b = c; clock_count += 5; break;
+    }
     // mov b d
     case 0x42:
-        b = d; clock_count += 5; break; 
+    {
+        b = d; clock_count += 5; break;
+    }
     // mov b e
     case 0x43:
-        b = e; clock_count += 5; break; 
+    {
+        b = e; clock_count += 5; break;
+    }
     // mov b h
     case 0x44:
-        b = h; clock_count += 5; break; 
+    {
+        b = h; clock_count += 5; break;
+    }
     // mov b l
     case 0x45:
-        b = l; clock_count += 5; break; 
+    {
+        b = l; clock_count += 5; break;
+    }
     // mov b m
     case 0x46:
-        uint16_t address = (h << 8) | l; b = read_byte(address); clock_count += 4; break; 
+    {
+        uint16_t address = (h << 8) | l; b = read_byte(address); clock_count += 7; break;
+    }
     // mov b a
     case 0x47:
-        b = a; clock_count += 5; break; 
-    // mov c, b
+    {
+        b = a; clock_count += 5; break;
+    }
+    // mov c, b
     case 0x48:
-        c = b; clock_count += 5; break; 
+    {
+        c = b; clock_count += 5; break;
+    }
     // mov c, c,
     case 0x49:
+    {
         clock_count += 5; break;
+    }
     // mov c, d
     case 0x4a:
-        c = d; clock_count += 5; break; 
+    {
+        c = d; clock_count += 5; break;
+    }
     // mov c,e
     case 0x4b:
-        c = e; clock_count += 5; break; 
+    {
+        c = e; clock_count += 5; break;
+    }
     // mov c, h
     case 0x4c:
-        c = h; clock_count += 5; break; 
+    {
+        c = h; clock_count += 5; break;
+    }
     // mov c, l
     case 0x4d:
-        c = l; clock_count += 5; break; 
+    {
+        c = l; clock_count += 5; break;
+    }
     // mov c, m
     case 0x4e:
+    {
         uint16_t address = (h << 8) | l; c = read_byte(address); clock_count += 7; break;
+    }
     // mov c, a
     case 0x4f:
+    {
         c = a; clock_count += 5; break;
+    }
     // mov d, b
     case 0x50:
+    {
         d = b; clock_count += 5; break;
+    }
     // mov d, c
     case 0x51:
+    {
         d = c; clock_count += 5; break;
+    }
     // mov d, d
     case 0x52:
+    {
         clock_count += 5; break;
+    }
     // mov d, e
     case 0x53:
+    {
         d = e; clock_count += 5; break;
+    }
     // mov d, h
     case 0x54:
+    {
         d = h; clock_count += 5; break;
+    }
     // mov d l
     case 0x55:
+    {
         d = l; clock_count += 5; break;
+    }
     // mov d, m
     case 0x56:
+    {
         uint16_t address = (h << 8) | l; d = read_byte(address); clock_count += 7; break;
+    }
     // mov d, a
     case 0x57:
+    {
         d = a; clock_count += 5; break;
+    }
     // mov e, b
     case 0x58:
+    {
         e = b; clock_count += 5; break;
+    }
     // mov e, c
     case 0x59:
+    {
         e = c; clock_count += 5; break;
+    }
     // mov e, d
     case 0x5a:
+    {
         e = d; clock_count += 5; break;
+    }
     // mov e, e
     case 0x5b:
+    {
         clock_count += 5; break;
+    }
     // mov e, h
     case 0x5c:
+    {
         e = h; clock_count += 5; break;
+    }
     // mov e l
     case 0x5d:
+    {
         e = l; clock_count += 5; break;
+    }
     // mov e, m
     case 0x5e:
+    {
         uint16_t address = (h << 8) | l; e = read_byte(address); clock_count += 7; break;
+    }
     // mov e, a
     case 0x5f:
+    {
         e = a; clock_count += 5; break;
+    }
     // mov h, b
     case 0x60:
+    {
         h = b; clock_count += 5; break;
+    }
     // mov h, c
     case 0x61:
+    {
         h = c; clock_count += 5; break;
+    }
     // mov h, d
     case 0x62:
+    {
         h = d; clock_count += 5; break;
+    }
     // mov h e
     case 0x63:
+    {
         h = e; clock_count += 5; break;
+    }
     // mov h, h
     case 0x64:
+    {
         clock_count += 5; break;
+    }
     // mov h, l
     case 0x65:
+    {
         h = l; clock_count += 5; break;
+    }
     // mov h, m
     case 0x66:
+    {
         uint16_t address = (h << 8) | l; h = read_byte(address); clock_count += 7; break;
+    }
     // mov h a
     case 0x67:
+    {
         h = a; clock_count += 5; break;
+    }
     // mov l b
     case 0x68:
+    {
         l = b;  clock_count += 5; break;
+    }
     // mov l, c
     case 0x69:
+    {
         l = c; clock_count += 5; break;
+    }
     // mov l, d
     case 0x6a:
+    {
         l = d; clock_count += 5; break;
+    }
     // mov l e
     case 0x6b:
+    {
         l = e; clock_count += 5; break;
+    }
     // mov l , h
     case 0x6c:
+    {
         l = h; clock_count += 5; break;
+    }
     // mov l, l
     case 0x6d:
+    {
         clock_count += 5; break;
+    }
     // mov l, m
     case 0x6e:
+    {
         uint16_t address = (h << 8) | l; l = read_byte(address); clock_count += 7; break;
+    }
     // mov l a
     case 0x6f:
+    {
         l = a; clock_count += 5; break;
+    }
     // mov m, b
     case 0x70:
+    {
         uint16_t address = (h << 8) | l; write_byte(address, b); clock_count += 7; break;
+    }
     // mov m, c
     case 0x71:
+    {
         uint16_t address = (h << 8) | l; write_byte(address, c); clock_count += 7; break;
+    }
     // mov m, d
     case 0x72:
+    {
         uint16_t address = (h << 8) | l; write_byte(address, d); clock_count += 7; break;
+    }
     // mov m, e
     case 0x73:
+    {
         uint16_t address = (h << 8) | l; write_byte(address, e); clock_count += 7; break;
+    }
     // mov m, h
     case 0x74:
+    {
         uint16_t address = (h << 8) | l; write_byte(address, h); clock_count += 7; break;
+    }
     // mov m, l
     case 0x75:
+    {
         uint16_t address = (h << 8) | l; write_byte(address, l); clock_count += 7; break;
+    }
     // hlt
     case 0x76:
-        clock_count += 7; exit(0); 
+    {
+        halt = 1; clock_count += 7; break;
+    }
     // move m, a
     case 0x77:
+    {
         uint16_t address = (h << 8) | l; write_byte(address, a); clock_count += 7; break;
+    }
     // mov a, b
     case 0x78:
+    {
         a = b; clock_count += 5; break;
+    }
     // mov a, c
     case 0x79:
+    {
         a = c; clock_count += 5; break;
+    }
     // mov a, d
     case 0x7a:
+    {
         a = d; clock_count += 5; break;
+    }
     // mov a, e
     case 0x7b:
+    {
         a = e; clock_count += 5; break;
+    }
     // move a, h
     case 0x7c:
+    {
         a = h; clock_count += 5; break;
+    }
     // mov a, l
     case 0x7d:
+    {
         a = l; clock_count += 5; break;
+    }
     // mov a, m
     case 0x7e:
+    {
         uint16_t address = (h << 8) | l; a = read_byte(address); clock_count += 7; break;
+    }
     // mov a, e
     case 0x7f:
+    {
         clock_count += 5; break;
+    }
     // add b
     case 0x80:
+    {
         ADD(&b); clock_count += 4; break;
+    }
     // add c
     case 0x81:
+    {
         ADD(&c); clock_count += 4; break;
+    }
     // add d
     case 0x82:
+    {
         ADD(&d); clock_count += 4; break;
+    }
     // add e
     case 0x83:
+    {
         ADD(&e); clock_count += 4; break;
+    }
     // add h
     case 0x84:
+    {
         ADD(&h); clock_count += 4; break;
+    }
     // add l
     case 0x85:
+    {
         ADD(&l); clock_count += 4; break;
+    }
     // add m
     case 0x86:
-        uint16_t address = (h << 8) | l; uint16_t result = a + memory[address]; handle_arith_flag(result); a = result & 0xff; clock_count += 7; break;
+    {
+        uint16_t address = (h << 8) | l; uint8_t value = read_byte(address); ADD(&value); clock_count += 7; break;
+    }
     // add a
     case 0x87:
+    {
         ADD(&a); clock_count += 4; break;
+    }
     // adc b
     case 0x88:
+    {
         ADC(&b); clock_count += 4; break;
+    }
     // adc c
     case 0x89:
+    {
         ADC(&c); clock_count += 4; break;
+    }
     // adc d
     case 0x8a:
+    {
         ADC(&d); clock_count += 4; break;
+    }
     // adc e
     case 0x8b:
+    {
         ADC(&e); clock_count += 4; break;
+    }
     // adc h
     case 0x8c:
+    {
         ADC(&h); clock_count += 4; break;
+    }
     // adc l
     case 0x8d:
+    {
         ADC(&l); clock_count += 4; break;
+    }
     // adc m
     case 0x8e:
-        uint16_t address = (h << 8) | l; uint16_t result = a + memory[address] + c; handle_arith_flag(result); a = result & 0xff; clock_count += 7; break;
+    {
+        uint16_t address = (h << 8) | l; uint8_t value = read_byte(address); ADC(&value); clock_count += 7; break;
+    }
     // adc a
     case 0x8f:
+    {
         ADC(&a); clock_count += 4; break;
+    }
     // sub b
     case 0x90:
+    {
         SUB(&b); clock_count += 4; break;
+    }
     // sub c
     case 0x91:
+    {
         SUB(&c); clock_count += 4; break;
+    }
     // sub d
     case 0x92:
+    {
         SUB(&d); clock_count += 4; break;
+    }
     // sub e
     case 0x93:
+    {
         SUB(&e); clock_count += 4; break;
+    }
     // sub h
     case 0x94:
+    {
         SUB(&h); clock_count += 4; break;
+    }
     // sub l
     case 0x95:
+    {
         SUB(&l); clock_count += 4; break;
+    }
     // sub m
     case 0x96:
-        uint16_t address = (h << 8) | l; uint16_t result = a - memory[address]; handle_without_carry(result); cy = (!result > 0xff); clock_count += 7; break;
+    {
+        uint16_t address = (h << 8) | l; uint8_t value = read_byte(address); SUB(&value); clock_count += 7; break;
+    }
     // sub a
     case 0x97:
+    {
         SUB(&a); clock_count += 4; break;
+    }
     // sbb b
     case 0x98:
+    {
         SBB(&b); clock_count += 4; break;
+    }
     // sbb c
     case 0x99:
+    {
         SBB(&c); clock_count += 4; break;
+    }
     // sbb d
     case 0x9a:
+    {
         SBB(&d); clock_count += 4; break;
+    }
     // sbb e
     case 0x9b:
+    {
         SBB(&e); clock_count += 4; break;
+    }
     // sbb h
     case 0x9c:
+    {
         SBB(&h); clock_count += 4; break;
+    }
     // sbb l
     case 0x9d:
+    {
         SBB(&l); clock_count += 4; break;
+    }
     // sbb m
     case 0x9e:
-        uint16_t address = (h << 8) | l; memory[address] += cy; uint16_t result = a - memory[address]; handle_arith_flag(result); a = result & 0xff; clock_count += 7; break;
+    {
+        uint16_t address = (h << 8) | l; uint8_t value = read_byte(address); SBB(&value); clock_count += 7; break;
+    }
     // sbb a
     case 0x9f:
+    {
         SBB(&a); clock_count += 4; break;
+    }
     // ana b
     case 0xa0:
+    {
         ANA(&b); clock_count += 4; break;
+    }
     // ana c
     case 0xa1:
+    {
         ANA(&c); clock_count += 4; break;
+    }
     // ana d
     case 0xa2:
+    {
         ANA(&d); clock_count += 4; break;
+    }
     // ana e
     case 0xa3:
+    {
         ANA(&e); clock_count += 4; break;
+    }
     // ana h
     case 0xa4:
+    {
         ANA(&h); clock_count += 4; break;
+    }
     // ana l
     case 0xa5:
+    {
         ANA(&l); clock_count += 4; break;
+    }
     // ana m
     case 0xa6:
-        uint16_t address = (h << 8) | l; uint16_t result = a & memory[address]; handle_arith_flag(result); a = result & 0xff; pc++; clock_count += 7; break;
+    {
+        uint16_t address = (h << 8) | l; uint8_t value = read_byte(address); ANA(&value); clock_count += 7; break;
+    }
     // ana a
     case 0xa7:
+    {
         ANA(&a); clock_count += 4; break;
+    }
     // xra b
     case 0xa8:
+    {
         XRA(&b); clock_count += 4; break;
+    }
     // xra c
     case 0xa9:
+    {
         XRA(&c); clock_count += 4; break;
+    }
     // xra d
     case 0xaa:
+    {
         XRA(&d); clock_count += 4; break;
+    }
     // xra e
     case 0xab:
+    {
         XRA(&e); clock_count += 4; break;
+    }
     // xra h
     case 0xac:
-        XRA(&c); clock_count += 4; break;
+    {
+        XRA(&h); clock_count += 4; break;
+    }
     // xra l
     case 0xad:
-        XRA(&d); clock_count += 4; break;
+    {
+        XRA(&l); clock_count += 4; break;
+    }
     // xra m
     case 0xae:
-        uint16_t address = (h << 8) | l; uint16_t result = a ^ memory[address]; handle_without_carry(result); cy = 0; ac = 0; a = result; clock_count += 7; break;
+    {
+        uint16_t address = (h << 8) | l; uint8_t value = read_byte(address); XRA(&value); clock_count += 7; break;
+    }
     // xra a
     case 0xaf:
+    {
         XRA(&a); clock_count += 4; break;
+    }
     // ora b
     case 0xb0:
+    {
         ORA(&b); clock_count += 4; break;
+    }
     // ora c
     case 0xb1:
+    {
         ORA(&c); clock_count += 4; break;
+    }
     // ora d
     case 0xb2:
+    {
         ORA(&d); clock_count += 4; break;
+    }
     // ora e
     case 0xb3:
+    {
         ORA(&e); clock_count += 4; break;
+    }
     // ora h
     case 0xb4:
+    {
         ORA(&h); clock_count += 4; break;
+    }
     // ora l
     case 0xb5:
+    {
         ORA(&l); clock_count += 4; break;
+    }
     // ora M
     case 0xb6:
-        uint16_t address = (h << 8) | l; uint16_t result = a | memory[address]; cy = 0; z = (result == 0); s = ((result & 0x80) != 0); p = parity(result & 0xff); a = result & 0xff; pc++; clock_count += 7; break;
+    {
+        uint16_t address = (h << 8) | l; uint8_t value = read_byte(address); ORA(&value); clock_count += 7; break;
+    }
     // ora a
     case 0xb7:
+    {
         ORA(&a); clock_count += 4; break;
+    }
     // cmp b
     case 0xb8:
+    {
         CMP(&b); clock_count += 4; break;
+    }
     // cmp c
     case 0xb9:
+    {
         CMP(&c); clock_count += 4; break;
+    }
     // cmp d
     case 0xba:
+    {
         CMP(&d); clock_count += 4; break;
+    }
     // cmp e
     case 0xbb:
+    {
         CMP(&e); clock_count += 4; break;
+    }
     // cmp h
     case 0xbc:
+    {
         CMP(&h); clock_count += 4; break;
+    }
     // cmp l
     case 0xbd:
+    {
         CMP(&l); clock_count += 4; break;
+    }
     // cmp m
     case 0xbe:
-        uint16_t address = (h << 8) | l; uint16_t result = a - memory[address]; cy = (a < memory[address]); z = (result == 0); s = ((result & 0x80) != 0); p = parity(result & 0xff); clock_count += 7; break;
+    {
+        uint16_t address = (h << 8) | l; uint8_t value = read_byte(address); CMP(&value); clock_count += 7; break;
+    }
     // cmp a
     case 0xbf:
+    {
         CMP(&a); clock_count += 4; break;
+    }
     // rnz
     case 0xc0:
-        if (z != 0x0) RET(); clock_count += 5; break; 
+    {
+        if (z == 0x0) { RET(); clock_count += 11; } else { clock_count += 5; } break;
+    }
     // pop b
     case 0xc1:
-        POP(&b, &c); clock_count += 10; break; 
+    {
+        POP(&b, &c); clock_count += 10; break;
+    }
     // jnz a16
     case 0xc2:
-        if (z != 0x0) JMP(); clock_count += 10; break; 
+    {
+        if (z == 0x0) JMP(); else pc += 2; clock_count += 10; break;
+    }
     // jmp a16
     case 0xc3:
-        JMP(); clock_count += 10; break; 
+    {
+        JMP(); clock_count += 10; break;
+    }
     // cnz a16
     case 0xc4:
-        if (z != 0x0) CALL(); clock_count += 11; break; 
+    {
+        if (z == 0x0) { CALL(); clock_count += 17; } else { pc += 2; clock_count += 11; } break;
+    }
     // push b
     case 0xc5:
-        PUSH(&b, &c); clock_count += 11; break; 
+    {
+        PUSH(&b, &c); clock_count += 11; break;
+    }
     // adi d8
     case 0xc6:
-        uint8_t byte = opcode[1]; uint16_t result = a + byte; handle_arith_flag(result); a = result & 0xff; pc += 2; clock_count += 7; break; 
+    {
+        uint8_t value = opcode[1]; ADD(&value); pc++; clock_count += 7; break;
+    }
     // rst 0
     case 0xc7:
-        RST(0); clock_count += 11; break; 
+    {
+        RST(0); clock_count += 11; break;
+    }
     // rz
     case 0xc8:
-        if (z == 0x0) RET(); clock_count += 5; break; 
+    {
+        if (z != 0x0) { RET(); clock_count += 11; } else { clock_count += 5; } break;
+    }
     // ret
     case 0xc9:
-        RET(); clock_count += 10; break; 
+    {
+        RET(); clock_count += 10; break;
+    }
     // jz a16
     case 0xca:
-        if (z == 0x0) JMP(); clock_count += 10; break; 
-    // jmp a16 illegal opcode
+    {
+        if (z != 0x0) JMP(); else pc += 2; clock_count += 10; break;
+    }
+    // jmp a16, undocumented alias
     case 0xcb:
-        clock_count += 10; break;
+    {
+        JMP(); clock_count += 10; break;
+    }
     // cz a16
     case 0xcc:
-        if (z == 0x0) CALL(); clock_count += 11; break; 
+    {
+        if (z != 0x0) { CALL(); clock_count += 17; } else { pc += 2; clock_count += 11; } break;
+    }
     // call a16
     case 0xcd:
-        CALL(); clock_count += 11; break; 
+    {
+        CALL(); clock_count += 17; break;
+    }
     // aci d8
     case 0xce:
-        uint8_t byte = opcode[1]; uint16_t result = a + byte + cy; handle_arith_flag(result); a = result & 0xff; pc += 2; clock_count += 7; break; 
+    {
+        uint8_t value = opcode[1]; ADC(&value); pc++; clock_count += 7; break;
+    }
     // rst 1
     case 0xcf:
-        RST(1); clock_count += 11; break; 
+    {
+        RST(1); clock_count += 11; break;
+    }
     // rnc
     case 0xd0:
-        if (cy != 0x0) RET(); clock_count += 5; break;
+    {
+        if (cy == 0x0) { RET(); clock_count += 11; } else { clock_count += 5; } break;
+    }
     // pop d
     case 0xd1:
+    {
         POP(&d, &e); clock_count += 10; break;
+    }
     // jnc a16
     case 0xd2:
-        if (cy != 0x0) JMP(); clock_count += 10; break;
+    {
+        if (cy == 0x0) JMP(); else pc += 2; clock_count += 10; break;
+    }
     // out d8
     case 0xd3:
-        clock_count += 10; break;
+    {
+        write_port(opcode[1], a); pc++; clock_count += 10; break;
+    }
     // cnc a16
     case 0xd4:
-        if (cy != 0x0) CALL(); clock_count += 11; break;
+    {
+        if (cy == 0x0) { CALL(); clock_count += 17; } else { pc += 2; clock_count += 11; } break;
+    }
     // push d
     case 0xd5:
-        PUSH(&d, &e); clock_count += 11; break; 
+    {
+        PUSH(&d, &e); clock_count += 11; break;
+    }
     // sui d8
     case 0xd6:
-        uint8_t byte = opcode[1]; uint16_t result = a - byte; handle_arith_flag(result); a = result & 0xff; pc += 2; clock_count += 7; break; 
+    {
+        uint8_t value = opcode[1]; SUB(&value); pc++; clock_count += 7; break;
+    }
     // rst 2
     case 0xd7:
-        RST(2); clock_count += 11; break; 
+    {
+        RST(2); clock_count += 11; break;
+    }
     // rc
     case 0xd8:
-        if (cy != 0x0) RET(); clock_count += 5; break; 
-    // ret 1 illegal opcode
+    {
+        if (cy != 0x0) { RET(); clock_count += 11; } else { clock_count += 5; } break;
+    }
+    // ret, undocumented alias
     case 0xd9:
-        clock_count += 10; break;
+    {
+        RET(); clock_count += 10; break;
+    }
     // jc a16
     case 0xda:
-        if (cy != 0x0) JMP(); clock_count += 10; break; 
+    {
+        if (cy != 0x0) JMP(); else pc += 2; clock_count += 10; break;
+    }
     // in d8
     case 0xdb:
-        clock_count += 10; break;
+    {
+        a = read_port(opcode[1]); pc++; clock_count += 10; break;
+    }
     // cc a16
     case 0xdc:
-        if (cy != 0x0) CALL(); clock_count += 11; break;
-    // call a16 illegal opcode
+    {
+        if (cy != 0x0) { CALL(); clock_count += 17; } else { pc += 2; clock_count += 11; } break;
+    }
+    // call a16, undocumented alias
     case 0xdd:
-        clock_count += 11; break;
+    {
+        CALL(); clock_count += 17; break;
+    }
     // sbi d8
     case 0xde:
-        uint8_t byte = opcode[1]; uint16_t result = a - byte - cy; handle_arith_flag(result); a = result & 0xff; pc += 2; clock_count += 7; break; 
+    {
+        uint8_t value = opcode[1]; SBB(&value); pc++; clock_count += 7; break;
+    }
     // rst 3
     case 0xdf:
-        RST(3); clock_count += 11; break; 
+    {
+        RST(3); clock_count += 11; break;
+    }
     // rpo
     case 0xe0:
-        if (p == 0) RET(); clock_count += 5; break; 
+    {
+        if (p == 0x0) { RET(); clock_count += 11; } else { clock_count += 5; } break;
+    }
     // pop h
     case 0xe1:
-        POP(&h, &l); clock_count += 10; break; 
+    {
+        POP(&h, &l); clock_count += 10; break;
+    }
     // JPO a16
     case 0xe2:
-        if (p == 0) JMP(); clock_count += 10; break; 
+    {
+        if (p == 0x0) JMP(); else pc += 2; clock_count += 10; break;
+    }
     // xthl illegal opcode
     case 0xe3:
+    {
         XTHL(); clock_count += 18; break;
+    }
     // cpo a16
     case 0xe4:
-        if (p == 0) CALL(); else pc += 2; clock_count += 11; break; 
+    {
+        if (p == 0x0) { CALL(); clock_count += 17; } else { pc += 2; clock_count += 11; } break;
+    }
     // push h
     case 0xe5:
-        PUSH(&h, &l); clock_count += 11; break; 
+    {
+        PUSH(&h, &l); clock_count += 11; break;
+    }
     // ani d8
     case 0xe6:
-        uint8_t byte = opcode[1]; uint16_t result = a & byte; handle_arith_flag(result); a = result & 0xff; clock_count += 7; break; 
+    {
+        uint8_t value = opcode[1]; ANA(&value); pc++; clock_count += 7; break;
+    }
     // rst 4
     case 0xe7:
-        RST(4); clock_count += 11; break; 
+    {
+        RST(4); clock_count += 11; break;
+    }
     // rpe
     case 0xe8:
-        if (p == 0x1) RET(); clock_count += 5; break;
+    {
+        if (p != 0x0) { RET(); clock_count += 11; } else { clock_count += 5; } break;
+    }
     // pchl
     case 0xe9:
-        uint16_t address = (h << 8) | l; pc = address; clock_count += 5; break; 
+    {
+        uint16_t address = (h << 8) | l; pc = address; clock_count += 5; break;
+    }
     // jpe a16
     case 0xea:
-        if (p == 0x1) JMP(); clock_count += 10; break; 
+    {
+        if (p != 0x0) JMP(); else pc += 2; clock_count += 10; break;
+    }
     // xchg
     case 0xeb:
-        XCHG(); clock_count += 5; break; 
+    {
+        XCHG(); clock_count += 5; break;
+    }
     // cpe a16
     case 0xec:
-        if (p == 0x1) CALL(); clock_count += 11; break; 
-    // call a16 illegal opcode
+    {
+        if (p != 0x0) { CALL(); clock_count += 17; } else { pc += 2; clock_count += 11; } break;
+    }
+    // call a16, undocumented alias
     case 0xed:
-        clock_count += 11; break;
+    {
+        CALL(); clock_count += 17; break;
+    }
     // xri d8
     case 0xee:
-        uint8_t byte = opcode[1]; uint16_t result = a ^ byte; handle_without_carry(result); cy = 0; ac = 0; a = result; pc++;  clock_count += 7; break; 
+    {
+        uint8_t value = opcode[1]; XRA(&value); pc++; clock_count += 7; break;
+    }
     // rst 5
     case 0xef:
-        RST(5); clock_count += 11; break; 
+    {
+        RST(5); clock_count += 11; break;
+    }
     // rp
     case 0xf0:
-        if (s == 0) RET(); clock_count += 5; break; 
+    {
+        if (s == 0x0) { RET(); clock_count += 11; } else { clock_count += 5; } break;
+    }
     // pop psw
     case 0xf1:
-        POP_PSW(); clock_count += 10; break; 
+    {
+        POP_PSW(); clock_count += 10; break;
+    }
     // jp a16
     case 0xf2:
-        if (s == 0) JMP(); clock_count += 10; break; 
+    {
+        if (s == 0x0) JMP(); else pc += 2; clock_count += 10; break;
+    }
     // di
     case 0xf3:
+    {
         clock_count += 4; interrupts_enabled = 0; break;
+    }
     // cp a16
     case 0xf4:
-        if (s == 0) CALL(); clock_count += 11; break;
+    {
+        if (s == 0x0) { CALL(); clock_count += 17; } else { pc += 2; clock_count += 11; } break;
+    }
     // push psw
     case 0xf5:
+    {
         PUSH_PSW(); clock_count += 11; break;
+    }
     // ori d8
     case 0xf6:
-        uint8_t byte = opcode[1]; uint16_t result = a | byte; handle_without_carry(result); a = result & 0xff; clock_count += 7; break; 
+    {
+        uint8_t value = opcode[1]; ORA(&value); pc++; clock_count += 7; break;
+    }
     // rst 6
     case 0xf7:
-        RST(6); clock_count += 11; break; 
+    {
+        RST(6); clock_count += 11; break;
+    }
     // rm
     case 0xf8:
-        if (s == 1) RET(); clock_count += 5; break; 
+    {
+        if (s != 0x0) { RET(); clock_count += 11; } else { clock_count += 5; } break;
+    }
     // sphl
     case 0xf9:
-        uint16_t address = (h << 8) | l; sp = address; clock_count += 5; break; 
+    {
+        uint16_t address = (h << 8) | l; sp = address; clock_count += 5; break;
+    }
     // jm a16
     case 0xfa:
-        if (s == 1) JMP(); clock_count += 10; break; 
+    {
+        if (s != 0x0) JMP(); else pc += 2; clock_count += 10; break;
+    }
     // ei
     case 0xfb:
+    {
         clock_count += 4; interrupts_enabled = 1; break;
+    }
     // cm a16
     case 0xfc:
-        if (s == 1) CALL(); clock_count += 11; break; 
-    // call a16 illegal opcode
+    {
+        if (s != 0x0) { CALL(); clock_count += 17; } else { pc += 2; clock_count += 11; } break;
+    }
+    // call a16, undocumented alias
     case 0xfd:
-        clock_count += 11; break;
+    {
+        CALL(); clock_count += 17; break;
+    }
     // cpi d8
     case 0xfe:
-        uint8_t byte = opcode[1]; uint16_t result = a - byte; cy = (a < byte); z = (result == 0); s = ((result & 0x80) != 0); p = parity(result & 0xff); clock_count += 7;
+    {
+        uint8_t value = opcode[1]; CMP(&value); pc++; clock_count += 7; break;
+    }
     // rst 7 
-    case 0xff: 
-        RST(7); clock_count += 11; break; 
-    default: 
-        unimplemented_instruction(); break; 
+    case 0xff:
+    {
+        RST(7); clock_count += 11; break;
     }
-    
-};
+    default:
+    {
+        unimplemented_instruction(); break;
+    }
+    }
+    return (int)(clock_count - start_clock);
+}
 
+template class basic_i8080<null_observer>;
@@ -1,6 +1,11 @@
+#ifndef CPU_H
+#define CPU_H
+
+#include "observer.hpp"
 #include <cstdlib>
 #include <ctime>
 #include <stdint.h>
+#include <string>
 
 /*
 Memory map:
@@ -36,10 +41,47 @@ opcode flag:s
     arithmetic instructions, it is adding 6 to adjust BCD arithmetic.
 */
 
-class i8080
+template<typename Observer = null_observer>
+class basic_i8080;
+
+// everything but memory, small enough to keep one per search node, see basic_i8080::save_registers
+struct machine_registers
+{
+    uint16_t pc;
+    uint16_t sp;
+    uint8_t a, b, c, d, e, h, l;
+    // laid out the way push psw stores them
+    uint8_t flags;
+    uint16_t reg_shift;
+    uint8_t shift_offset;
+    uint8_t in_port[4];
+    uint8_t out_port[7];
+    uint8_t halt;
+    uint8_t interrupts_enabled;
+    uint8_t next_interrupt_id;
+    uint64_t clock_count;
+    uint64_t instruction_count;
+    uint64_t next_interrupt;
+};
+
+// everything the running program can see or change, as basic_i8080::save_state copies it out.
+// run settings, statistics and the observer are not part of it
+struct machine_state
+{
+    uint8_t memory[0x10000];
+    machine_registers registers;
+};
+
+// defined by the output of the recompiler, which only targets the unobserved core
+void recompiled_run_until(basic_i8080<null_observer>& cpu, uint64_t cycle);
+
+// the core is parameterized on an observer policy, see observer.hpp. its hooks are called inline, so
+// with the default null_observer they compile to nothing and the hot path is the same as without them
+template<typename Observer>
+class basic_i8080
 {
 private:
-  uint8_t memory[0xFFFF];
+  uint8_t memory[0x10000];
   uint16_t pc = 0; 
   uint16_t sp = 0; 
   unsigned char* opcode; 
@@ -65,9 +107,31 @@ private:
   uint16_t reg_shift; 
   uint8_t shift_offset; 
 
+  // idle loop detection, see run_until
+  uint16_t probe_head;
+  uint16_t probe_tail;
+  uint16_t probe_sp;
+  uint64_t probe_signature;
+  uint64_t probe_clock;
+  uint64_t probe_instructions;
+  bool probe_clean;
+
+  uint64_t register_signature();
+  void probe_idle_loop(uint16_t tail, uint64_t cycle);
+
+  // longest fused sequence in cycles, a fused handler only runs when all of it fits before the next interrupt
+  static const int max_fused_cycles = 28;
+  bool emulate_fused();
+
+  // generated by the recompiler, works on the registers directly
+  friend void ::recompiled_run_until(basic_i8080<null_observer>& cpu, uint64_t cycle);
+  // observers such as the debugger read and change the registers directly
+  friend Observer;
+  // and the fuzzer's observer derives its stack check from fault_observer
+  friend struct fault_observer;
+
 public:
-  i8080();
-  ~i8080();
+  basic_i8080();
 
   
   void generate_interrupt(uint8_t id); 
@@ -80,10 +144,40 @@ public:
   uint8_t interrupts_enabled; 
   uint64_t clock_count; 
   uint64_t instruction_count; 
+  // ram pages written since this was last cleared, bit n is the page at $2000 + n * 256
+  uint64_t dirty_pages;
 
   const uint16_t vram_address = 0x2400; 
   
-  uint8_t vram = *memory + vram_address; 
+  uint8_t* vram() { return memory + vram_address; }
+  // the 8K of ram at $2000, vram included
+  uint8_t* ram() { return memory + 0x2000; }
+  static const uint16_t rom_size = 0x2000;
+  const uint8_t* rom() const { return memory; }
+
+  // video timing, the board raises rst 1 at mid screen and rst 2 at the end of the screen, 60 times a second
+  static const uint32_t half_frame_cycles = 2000000 / 120;
+  uint64_t next_interrupt;
+  uint8_t next_interrupt_id;
+
+  // fast forward through hlt and side effect free polling loops instead of interpreting them
+  bool skip_idle_loops;
+  uint64_t idle_cycles_skipped;
+
+  // run hot instruction sequences through one fused handler instead of one dispatch each
+  bool fuse_instructions;
+  uint64_t fused_dispatches;
+
+  // native code for the loaded rom from the recompiler, run_until hands everything to it when set
+  void (*native_code)(basic_i8080& cpu, uint64_t cycle);
+
+  // sees every memory access, port access and instruction, tools read their results from here
+  Observer observer;
+
+  // runs instructions until clock_count reaches cycle
+  void run_until(uint64_t cycle);
+  // runs up to the next screen interrupt and raises it, returns its id (1 mid screen, 2 end of screen)
+  uint8_t run_half_frame();
 
   // memory management 
   uint8_t read_byte(uint16_t address); 
@@ -91,14 +185,36 @@ public:
   void write_byte(uint16_t address, uint8_t val); 
   void write_word(uint16_t address, uint16_t value); 
 
-  void load_rom(const char* file_name);
+  // in and out, including the shift register on ports 2, 3 and 4
+  uint8_t read_port(uint8_t port);
+  void write_port(uint8_t port, uint8_t value);
+
+  // loads a rom image at $0000, returns false if the file cannot be read or does not fit in rom
+  bool load_rom(const char* file_name);
+  // loads the images a manifest lists, see rom_set.hpp. error says what is wrong with a bad set
+  bool load_rom_set(const char* manifest_name, std::string* error);
+  // load_rom_set for a .set manifest, load_rom for any other file. error says why either failed
+  bool load_rom_or_set(const char* file_name, std::string* error);
+
+  // puts the machine back in the state of snapshot, leaving the observer and the run settings alone.
+  // ram is only copied where dirty_pages says it was written, so this cpu must have matched snapshot
+  // when dirty_pages was last cleared, as it does right after a copy or an earlier restore
+  void restore(const basic_i8080& snapshot);
+
+  // the whole machine in and out of a flat block, for snapshot files. loading marks every ram page dirty
+  void save_state(machine_state* state) const;
+  // everything but memory, cheap enough for every frame. loading leaves memory and dirty_pages alone
+  void save_registers(machine_registers* registers) const;
+  void load_registers(const machine_registers& registers);
+  void load_state(const machine_state& state);
 
   
+  // runs the instruction at pc, returns the cycles it took
   int emulate();
   
   void handle_arith_flag(uint16_t result);
   void handle_without_carry(uint16_t result); 
-  void i8080::handle_without_ac(uint16_t result);
+  void handle_without_ac(uint16_t result);
 
   void unimplemented_instruction(); 
 
@@ -145,3 +261,7 @@ public:
 
 
 };
+
+typedef basic_i8080<> i8080;
+
+#endif
@@ -0,0 +1,691 @@
+#include "cpu.hpp"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// g++ -O2 cpu_check.cpp cpu.cpp mapped_file.cpp rom_set.cpp -o cpu_check
+// ./cpu_check
+// checks the core one instruction at a time through nothing but its public interface. each case is a small
+// program in ram that loads the registers and flags, runs the instruction under test and pushes the result.
+// covered: the cycles and length of every opcode but hlt on both branch outcomes, the flags of every alu
+// operation over all operands and carries in its register, memory and immediate forms, inr, dcr, daa, the
+// rotates, dad, inx, dcx and the moves and exchanges. exits 2 if anything differs from the reference below
+
+// where the program under test lives, and the stack and scratch bytes it uses
+static const uint16_t program_start = 0x2000;
+static const uint16_t stack_top = 0x2380;
+static const uint16_t operand_address = 0x2390;
+static const uint16_t marker_address = 0x23c0;
+// the length of check_steps' setup, the instruction under test follows it
+static const uint16_t setup_size = 18;
+
+// the 8080's cycles, for conditional calls and returns when they are not taken
+static const uint8_t cycles[256] = {
+    4, 10, 7, 5, 5, 5, 7, 4, 4, 10, 7, 5, 5, 5, 7, 4,
+    4, 10, 7, 5, 5, 5, 7, 4, 4, 10, 7, 5, 5, 5, 7, 4,
+    4, 10, 16, 5, 5, 5, 7, 4, 4, 10, 16, 5, 5, 5, 7, 4,
+    4, 10, 13, 5, 10, 10, 10, 4, 4, 10, 13, 5, 5, 5, 7, 4,
+    5, 5, 5, 5, 5, 5, 7, 5, 5, 5, 5, 5, 5, 5, 7, 5,
+    5, 5, 5, 5, 5, 5, 7, 5, 5, 5, 5, 5, 5, 5, 7, 5,
+    5, 5, 5, 5, 5, 5, 7, 5, 5, 5, 5, 5, 5, 5, 7, 5,
+    7, 7, 7, 7, 7, 7, 7, 7, 5, 5, 5, 5, 5, 5, 7, 5,
+    4, 4, 4, 4, 4, 4, 7, 4, 4, 4, 4, 4, 4, 4, 7, 4,
+    4, 4, 4, 4, 4, 4, 7, 4, 4, 4, 4, 4, 4, 4, 7, 4,
+    4, 4, 4, 4, 4, 4, 7, 4, 4, 4, 4, 4, 4, 4, 7, 4,
+    4, 4, 4, 4, 4, 4, 7, 4, 4, 4, 4, 4, 4, 4, 7, 4,
+    5, 10, 10, 10, 11, 11, 7, 11, 5, 10, 10, 10, 11, 17, 7, 11,
+    5, 10, 10, 10, 11, 11, 7, 11, 5, 10, 10, 10, 11, 17, 7, 11,
+    5, 10, 10, 18, 11, 11, 7, 11, 5, 5, 10, 5, 11, 17, 7, 11,
+    5, 10, 10, 4, 11, 11, 7, 11, 5, 5, 10, 4, 11, 17, 7, 11,
+};
+
+static const uint8_t lengths[256] = {
+    1, 3, 1, 1, 1, 1, 2, 1, 1, 1, 1, 1, 1, 1, 2, 1,
+    1, 3, 1, 1, 1, 1, 2, 1, 1, 1, 1, 1, 1, 1, 2, 1,
+    1, 3, 3, 1, 1, 1, 2, 1, 1, 1, 3, 1, 1, 1, 2, 1,
+    1, 3, 3, 1, 1, 1, 2, 1, 1, 1, 3, 1, 1, 1, 2, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 3, 3, 3, 1, 2, 1, 1, 1, 3, 3, 3, 3, 2, 1,
+    1, 1, 3, 2, 3, 1, 2, 1, 1, 1, 3, 2, 3, 3, 2, 1,
+    1, 1, 3, 1, 3, 1, 2, 1, 1, 1, 3, 1, 3, 3, 2, 1,
+    1, 1, 3, 1, 3, 1, 2, 1, 1, 1, 3, 1, 3, 3, 2, 1,
+};
+
+// a program under test, assembled byte by byte. steps counts the instructions it runs before it jumps back to
+// program_start, which is where the next one is written
+struct program
+{
+    uint8_t code[64];
+    int size;
+    int steps;
+};
+
+static void emit(program* p, uint8_t op)
+{
+    p->code[p->size++] = op;
+    p->steps++;
+}
+
+static void emit(program* p, uint8_t op, uint8_t byte)
+{
+    emit(p, op);
+    p->code[p->size++] = byte;
+}
+
+static void emit(program* p, uint8_t op, uint16_t word)
+{
+    emit(p, op);
+    p->code[p->size++] = word & 0xff;
+    p->code[p->size++] = word >> 8;
+}
+
+static uint16_t here(const program* p)
+{
+    return program_start + p->size;
+}
+
+// sets sp and loads a and the flags through pop psw, which leaves b and c set to them as well
+static void begin(program* p, uint8_t a, uint8_t flags)
+{
+    p->size = 0;
+    p->steps = 0;
+    emit(p, 0x31, stack_top);
+    emit(p, 0x01, (uint16_t)((a << 8) | flags));
+    emit(p, 0xc5);
+    emit(p, 0xf1);
+}
+
+// pushes psw, b, d and h, so the registers can be read back from the stack below stack_top
+static void end(program* p)
+{
+    emit(p, 0x31, stack_top);
+    emit(p, 0xf5);
+    emit(p, 0xc5);
+    emit(p, 0xd5);
+    emit(p, 0xe5);
+    emit(p, 0xc3, program_start);
+}
+
+// the registers as end pushed them
+struct registers
+{
+    uint8_t a, flags, b, c, d, e, h, l;
+};
+
+// runs p and returns the cycles its step'th instruction took
+static int run(i8080* cpu, const program* p, int step)
+{
+    for (int i = 0; i < p->size; ++i)
+    {
+        cpu->write_byte(program_start + i, p->code[i]);
+    }
+    int taken = 0;
+    for (int i = 0; i < p->steps; ++i)
+    {
+        int cycles = cpu->emulate();
+        if (i == step)
+        {
+            taken = cycles;
+        }
+    }
+    return taken;
+}
+
+static registers pushed(i8080* cpu)
+{
+    registers r;
+    r.flags = cpu->read_byte(stack_top - 2);
+    r.a = cpu->read_byte(stack_top - 1);
+    r.c = cpu->read_byte(stack_top - 4);
+    r.b = cpu->read_byte(stack_top - 3);
+    r.e = cpu->read_byte(stack_top - 6);
+    r.d = cpu->read_byte(stack_top - 5);
+    r.l = cpu->read_byte(stack_top - 8);
+    r.h = cpu->read_byte(stack_top - 7);
+    return r;
+}
+
+static int failures;
+
+static void fail(const char* format, ...) __attribute__((format(printf, 1, 2)));
+
+static void fail(const char* format, ...)
+{
+    if (failures++ < 20)
+    {
+        va_list args;
+        va_start(args, format);
+        vfprintf(stderr, format, args);
+        va_end(args);
+    }
+}
+
+// the flags byte as push psw stores it: s z 0 ac 0 p 1 cy
+static uint8_t szp(uint8_t result)
+{
+    return (result & 0x80) | (result == 0 ? 0x40 : 0) | (__builtin_popcount(result) & 1 ? 0 : 0x04) | 0x02;
+}
+
+// add, adc, sub, sbb, ana, xra, ora and cmp, written from the manual: subtraction adds the complement of the operand
+// and the carry comes out inverted as the borrow
+static void reference_alu(int op, uint8_t a, uint8_t value, int carry, uint8_t* result, uint8_t* flags)
+{
+    int sum = 0, cy = 0, ac = 0;
+    switch (op)
+    {
+    case 0:
+    case 1:
+    {
+        int in = op == 1 ? carry : 0;
+        sum = a + value + in;
+        cy = sum > 0xff;
+        ac = (a & 0xf) + (value & 0xf) + in > 0xf;
+        break;
+    }
+    case 2:
+    case 3:
+    case 7:
+    {
+        int in = op == 3 ? !carry : 1;
+        uint8_t complement = ~value;
+        sum = a + complement + in;
+        cy = sum <= 0xff;
+        ac = (a & 0xf) + (complement & 0xf) + in > 0xf;
+        break;
+    }
+    case 4:
+        sum = a & value;
+        ac = ((a | value) & 0x08) != 0;
+        break;
+    case 5:
+        sum = a ^ value;
+        break;
+    case 6:
+        sum = a | value;
+        break;
+    }
+    *result = op == 7 ? a : (uint8_t)sum;
+    *flags = szp(sum & 0xff) | (ac ? 0x10 : 0) | cy;
+}
+
+static const char* alu_names[8] = {"add", "adc", "sub", "sbb", "ana", "xra", "ora", "cmp"};
+
+// the flags each case starts with: the carry under test, and the others from the operands so stale flags show
+static uint8_t flags_in(uint8_t a, uint8_t value, int carry)
+{
+    return ((a ^ value) & 0xd4) | 0x02 | carry;
+}
+
+static void check_alu(i8080* cpu)
+{
+    program p;
+    for (int op = 0; op < 8; ++op)
+    {
+        // the register form on b, the memory form and the immediate form
+        for (int form = 0; form < 3; ++form)
+        {
+            for (int a = 0; a < 256; ++a)
+            {
+                for (int value = 0; value < 256; ++value)
+                {
+                    for (int carry = 0; carry < 2; ++carry)
+                    {
+                        begin(&p, a, flags_in(a, value, carry));
+                        emit(&p, 0x06, (uint8_t)value);
+                        emit(&p, 0x21, operand_address);
+                        emit(&p, 0x36, (uint8_t)value);
+                        if (form == 0)
+                        {
+                            emit(&p, 0x80 | op << 3);
+                        }
+                        else if (form == 1)
+                        {
+                            emit(&p, 0x86 | op << 3);
+                        }
+                        else
+                        {
+                            emit(&p, 0xc6 | op << 3, (uint8_t)value);
+                        }
+                        end(&p);
+                        run(cpu, &p, -1);
+                        registers r = pushed(cpu);
+                        uint8_t result, flags;
+                        reference_alu(op, a, value, carry, &result, &flags);
+                        if (r.a != result || r.flags != flags)
+                        {
+                            fail("%s %s, a %02x, operand %02x, cy %d: a %02x flags %02x, expected a %02x flags %02x\n",
+                                alu_names[op], form == 0 ? "b" : form == 1 ? "m" : "d8", a, value, carry, r.a, r.flags,
+                                result, flags);
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+static void check_inr_dcr(i8080* cpu)
+{
+    program p;
+    for (int dcr = 0; dcr < 2; ++dcr)
+    {
+        for (int memory = 0; memory < 2; ++memory)
+        {
+            for (int value = 0; value < 256; ++value)
+            {
+                for (int carry = 0; carry < 2; ++carry)
+                {
+                    uint8_t in = flags_in(0, value, carry);
+                    begin(&p, 0, in);
+                    emit(&p, 0x21, operand_address);
+                    emit(&p, 0x36, (uint8_t)value);
+                    emit(&p, 0x06, (uint8_t)value);
+                    emit(&p, (memory ? 0x34 : 0x04) | dcr);
+                    end(&p);
+                    run(cpu, &p, -1);
+                    registers r = pushed(cpu);
+                    uint8_t got = memory ? cpu->read_byte(operand_address) : r.b;
+                    uint8_t expected = dcr ? value - 1 : value + 1;
+                    // ac is the carry out of the low nibble, dcr adds ff
+                    int ac = dcr ? (expected & 0xf) != 0xf : (expected & 0xf) == 0;
+                    uint8_t flags = szp(expected) | (ac ? 0x10 : 0) | carry;
+                    if (got != expected || r.flags != flags)
+                    {
+                        fail("%s %s, %02x, cy %d: %02x flags %02x, expected %02x flags %02x\n", dcr ? "dcr" : "inr",
+                            memory ? "m" : "b", value, carry, got, r.flags, expected, flags);
+                    }
+                }
+            }
+        }
+    }
+}
+
+static void check_daa(i8080* cpu)
+{
+    program p;
+    for (int a = 0; a < 256; ++a)
+    {
+        for (int in = 0; in < 4; ++in)
+        {
+            int carry = in & 1;
+            int aux = in >> 1;
+            begin(&p, a, 0x02 | carry | (aux ? 0x10 : 0));
+            emit(&p, 0x27);
+            end(&p);
+            run(cpu, &p, -1);
+            registers r = pushed(cpu);
+            uint8_t correction = 0;
+            int cy = carry;
+            if ((a & 0xf) > 9 || aux)
+            {
+                correction |= 0x06;
+            }
+            if (a > 0x99 || carry)
+            {
+                correction |= 0x60;
+                cy = 1;
+            }
+            uint8_t expected = a + correction;
+            int ac = (a & 0xf) + (correction & 0xf) > 0xf;
+            uint8_t flags = szp(expected) | (ac ? 0x10 : 0) | cy;
+            if (r.a != expected || r.flags != flags)
+            {
+                fail("daa, a %02x, cy %d, ac %d: a %02x flags %02x, expected a %02x flags %02x\n", a, carry, aux, r.a,
+                    r.flags, expected, flags);
+            }
+        }
+    }
+}
+
+static void check_rotates(i8080* cpu)
+{
+    static const char* names[4] = {"rlc", "rrc", "ral", "rar"};
+    program p;
+    for (int op = 0; op < 4; ++op)
+    {
+        for (int a = 0; a < 256; ++a)
+        {
+            for (int carry = 0; carry < 2; ++carry)
+            {
+                uint8_t in = flags_in(a, 0, carry);
+                begin(&p, a, in);
+                emit(&p, 0x07 | op << 3);
+                end(&p);
+                run(cpu, &p, -1);
+                registers r = pushed(cpu);
+                uint8_t expected;
+                int cy;
+                switch (op)
+                {
+                case 0:
+                    cy = a >> 7;
+                    expected = a << 1 | cy;
+                    break;
+                case 1:
+                    cy = a & 1;
+                    expected = a >> 1 | cy << 7;
+                    break;
+                case 2:
+                    cy = a >> 7;
+                    expected = a << 1 | carry;
+                    break;
+                default:
+                    cy = a & 1;
+                    expected = a >> 1 | carry << 7;
+                    break;
+                }
+                // only the carry changes
+                uint8_t flags = (in & ~0x01) | cy;
+                if (r.a != expected || r.flags != flags)
+                {
+                    fail("%s, a %02x, cy %d: a %02x flags %02x, expected a %02x flags %02x\n", names[op], a, carry, r.a,
+                        r.flags, expected, flags);
+                }
+            }
+        }
+    }
+}
+
+// dad, inx and dcx on every register pair over values around the byte and word boundaries
+static void check_pairs(i8080* cpu)
+{
+    static const uint16_t values[] = {0x0000, 0x0001, 0x00ff, 0x0100, 0x7fff, 0x8000, 0xfffe, 0xffff, 0x1234, 0xedcc};
+    static const char* names[4] = {"b", "d", "h", "sp"};
+    program p;
+    for (uint16_t hl : values)
+    {
+        for (uint16_t pair : values)
+        {
+            for (int rp = 0; rp < 4; ++rp)
+            {
+                for (int op = 0; op < 3; ++op)
+                {
+                    // dad, inx, dcx
+                    static const uint8_t opcodes[3] = {0x09, 0x03, 0x0b};
+                    for (int carry = 0; carry < 2; ++carry)
+                    {
+                        uint8_t in = flags_in(hl & 0xff, pair >> 8, carry);
+                        begin(&p, 0, in);
+                        emit(&p, 0x21, hl);
+                        emit(&p, 0x01 | rp << 4, pair);
+                        emit(&p, opcodes[op] | rp << 4);
+                        if (rp == 3 && op != 0)
+                        {
+                            // sp is read back into de, through a dad that clears the carry. end resets sp
+                            emit(&p, 0xeb);
+                            emit(&p, 0x21, (uint16_t)0);
+                            emit(&p, 0x39);
+                            emit(&p, 0xeb);
+                        }
+                        end(&p);
+                        run(cpu, &p, -1);
+                        registers r = pushed(cpu);
+                        uint16_t got_hl = r.h << 8 | r.l;
+                        uint16_t got_pair = rp == 0 ? r.b << 8 | r.c : rp == 2 ? got_hl : r.d << 8 | r.e;
+                        uint16_t expected_hl = hl;
+                        uint16_t expected_pair = pair;
+                        uint8_t flags = in;
+                        if (op == 0)
+                        {
+                            uint32_t sum = (rp == 2 ? pair : hl) + (uint32_t)pair;
+                            expected_hl = sum & 0xffff;
+                            flags = (in & ~0x01) | (sum > 0xffff);
+                            if (rp == 2)
+                            {
+                                expected_pair = expected_hl;
+                            }
+                        }
+                        else
+                        {
+                            expected_pair = op == 1 ? pair + 1 : pair - 1;
+                            if (rp == 2)
+                            {
+                                expected_hl = expected_pair;
+                            }
+                        }
+                        if (rp == 3)
+                        {
+                            if (op == 0)
+                            {
+                                got_pair = pair;
+                            }
+                            else
+                            {
+                                flags &= ~0x01;
+                            }
+                        }
+                        if (got_hl != expected_hl || got_pair != expected_pair || r.flags != flags)
+                        {
+                            fail("%s %s, hl %04x, pair %04x, cy %d: hl %04x pair %04x flags %02x, expected hl %04x pair %04x "
+                                "flags %02x\n", op == 0 ? "dad" : op == 1 ? "inx" : "dcx", names[rp], hl, pair, carry, got_hl,
+                                got_pair, r.flags, expected_hl, expected_pair, flags);
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+// every mov, then xchg, xthl, sphl and the pushes and pops
+static void check_moves(i8080* cpu)
+{
+    static const char* names[8] = {"b", "c", "d", "e", "h", "l", "m", "a"};
+    program p;
+    for (int to = 0; to < 8; ++to)
+    {
+        for (int from = 0; from < 8; ++from)
+        {
+            if (to == 6 && from == 6)
+            {
+                // hlt
+                continue;
+            }
+            begin(&p, 0xa7, 0x02);
+            emit(&p, 0x01, (uint16_t)0xb1c1);
+            emit(&p, 0x11, (uint16_t)0xd1e1);
+            emit(&p, 0x21, operand_address);
+            emit(&p, 0x36, (uint8_t)0x61);
+            emit(&p, 0x40 | to << 3 | from);
+            end(&p);
+            run(cpu, &p, -1);
+            registers r = pushed(cpu);
+            uint8_t before[8] = {0xb1, 0xc1, 0xd1, 0xe1, operand_address >> 8, operand_address & 0xff, 0x61, 0xa7};
+            uint8_t after[8] = {r.b, r.c, r.d, r.e, r.h, r.l, cpu->read_byte(operand_address), r.a};
+            for (int i = 0; i < 8; ++i)
+            {
+                uint8_t expected = i == to ? before[from] : before[i];
+                if (after[i] != expected)
+                {
+                    fail("mov %s, %s: %s is %02x, expected %02x\n", names[to], names[from], names[i], after[i], expected);
+                }
+            }
+        }
+    }
+
+    // xchg leaves de 5566 and hl 3344. push b, d and h, pop b takes 3344 back off and xthl swaps hl with the 5566
+    // below it. hl goes to memory, then what xthl left on the stack, then sp after sphl
+    begin(&p, 0, 0x02);
+    emit(&p, 0x01, (uint16_t)0x1122);
+    emit(&p, 0x11, (uint16_t)0x3344);
+    emit(&p, 0x21, (uint16_t)0x5566);
+    emit(&p, 0xeb);
+    emit(&p, 0xc5);
+    emit(&p, 0xd5);
+    emit(&p, 0xe5);
+    emit(&p, 0xc1);
+    emit(&p, 0xe3);
+    emit(&p, 0x22, operand_address);
+    emit(&p, 0xe1);
+    emit(&p, 0x22, (uint16_t)(operand_address + 2));
+    emit(&p, 0x21, (uint16_t)0x2370);
+    emit(&p, 0xf9);
+    emit(&p, 0x21, (uint16_t)0);
+    emit(&p, 0x39);
+    emit(&p, 0x22, (uint16_t)(operand_address + 4));
+    end(&p);
+    run(cpu, &p, -1);
+    registers r = pushed(cpu);
+    uint16_t hl = cpu->read_byte(operand_address) | cpu->read_byte(operand_address + 1) << 8;
+    uint16_t top = cpu->read_byte(operand_address + 2) | cpu->read_byte(operand_address + 3) << 8;
+    uint16_t sp = cpu->read_byte(operand_address + 4) | cpu->read_byte(operand_address + 5) << 8;
+    if ((r.b << 8 | r.c) != 0x3344 || (r.d << 8 | r.e) != 0x5566 || hl != 0x5566 || top != 0x3344 || sp != 0x2370)
+    {
+        fail("xchg, push, pop, xthl and sphl: bc %02x%02x de %02x%02x, hl %04x, stack %04x, sp %04x, expected bc 3344 "
+            "de 5566, hl 5566, stack 3344, sp 2370\n", r.b, r.c, r.d, r.e, hl, top, sp);
+    }
+}
+
+// every opcode but hlt once with all flags clear and once with all set. the instruction under test sits after a
+// fixed setup, its operands point at the code after it so branches land on one of two paths that each store a
+// different marker, and a wrong length runs the operands as code and misses the marker
+static void check_steps(i8080* cpu)
+{
+    program p;
+    for (int op = 0; op < 256; ++op)
+    {
+        if (op == 0x76)
+        {
+            continue;
+        }
+        for (int set = 0; set < 2; ++set)
+        {
+            uint8_t flags = set ? 0xd7 : 0x02;
+            int length = lengths[op];
+            // the two paths follow the instruction
+            uint16_t under_test = program_start + setup_size;
+            uint16_t not_taken = under_test + length;
+            uint16_t taken = not_taken + 5;
+            uint16_t join = taken + 3;
+
+            p.size = 0;
+            p.steps = 0;
+            emit(&p, 0x31, stack_top);
+            // the return address for ret, and the target of pchl
+            emit(&p, 0x21, taken);
+            emit(&p, 0xe5);
+            emit(&p, 0x21, op == 0xe9 ? taken : operand_address);
+            emit(&p, 0x11, operand_address);
+            // a starts as the taken path's marker, for the rst vectors that jump past its mvi
+            emit(&p, 0x01, (uint16_t)(0xa500 | flags));
+            emit(&p, 0xc5);
+            emit(&p, 0xf1);
+            if (here(&p) != under_test)
+            {
+                fail("the setup does not end at %04x\n", under_test);
+                return;
+            }
+            // 3e is mvi a, so operands that run as code take the next byte with them
+            bool jumps = (op & 0xc7) == 0xc2 || (op & 0xc7) == 0xc4 || op == 0xc3 || op == 0xcb || (op & 0xcf) == 0xcd;
+            uint16_t operand = jumps ? taken : 0x3e3e;
+            emit(&p, (uint8_t)op);
+            p.size += length - 1;
+            p.code[under_test - program_start + 1] = operand & 0xff;
+            p.code[under_test - program_start + 2] = operand >> 8;
+            p.size = not_taken - program_start;
+            emit(&p, 0x3e, (uint8_t)0x5a);
+            emit(&p, 0xc3, join);
+            emit(&p, 0x3e, (uint8_t)0xa5);
+            emit(&p, 0x00);
+            emit(&p, 0x32, marker_address);
+            emit(&p, 0xc3, program_start);
+            // one of the two paths is skipped
+            p.steps -= 2;
+
+            // the rst vectors jump to the taken path
+            cpu->write_byte(marker_address, 0);
+            cpu->write_byte(stack_top - 4, 0);
+            cpu->write_byte(stack_top - 3, 0);
+            int taken_cycles = run(cpu, &p, 8);
+
+            // nz z nc c po pe p m: with all flags set the odd ones hold
+            int condition = (op >> 3) & 7;
+            bool conditional = (op & 0xc7) == 0xc0 || (op & 0xc7) == 0xc2 || (op & 0xc7) == 0xc4;
+            bool branches = conditional ? set == (condition & 1) : jumps || op == 0xc9 || op == 0xd9 || op == 0xe9 ||
+                (op & 0xc7) == 0xc7;
+            int expected = cycles[op];
+            if (branches && ((op & 0xc7) == 0xc0 || (op & 0xc7) == 0xc4))
+            {
+                expected += 6;
+            }
+            if (taken_cycles != expected)
+            {
+                fail("opcode %02x, flags %02x: %d cycles, expected %d\n", op, flags, taken_cycles, expected);
+            }
+            uint8_t marker = cpu->read_byte(marker_address);
+            if (marker != (branches ? 0xa5 : 0x5a))
+            {
+                fail("opcode %02x, flags %02x: %s, expected the %s path\n", op, flags,
+                    marker == 0xa5 ? "took the branch" : marker == 0x5a ? "did not take the branch" : "lost its way",
+                    branches ? "taken" : "not taken");
+            }
+            // calls push the address after them
+            bool calls = (op & 0xc7) == 0xc4 || (op & 0xcf) == 0xcd || (op & 0xc7) == 0xc7;
+            uint16_t pushed_return = cpu->read_byte(stack_top - 4) | cpu->read_byte(stack_top - 3) << 8;
+            if (calls && branches && pushed_return != not_taken)
+            {
+                fail("opcode %02x, flags %02x: pushed %04x, expected %04x\n", op, flags, pushed_return, not_taken);
+            }
+        }
+    }
+}
+
+int main()
+{
+    // the rst vectors jump to the nop on the taken path of check_steps, so an rst takes as many steps as a taken
+    // ret. the path is at the same place for every one byte opcode. the first program is entered through rst 0's
+    uint8_t rom[64];
+    uint16_t rst_target = program_start + setup_size + 1 + 5 + 2;
+    for (int i = 0; i < 64; i += 8)
+    {
+        rom[i] = 0xc3;
+        rom[i + 1] = rst_target & 0xff;
+        rom[i + 2] = rst_target >> 8;
+        memset(rom + i + 3, 0, 5);
+    }
+    char rom_name[] = "/tmp/cpu_check.XXXXXX";
+    int fd = mkstemp(rom_name);
+    if (fd < 0 || write(fd, rom, sizeof(rom)) != (ssize_t)sizeof(rom))
+    {
+        fprintf(stderr, "cpu_check: cannot write %s\n", rom_name);
+        return 1;
+    }
+    close(fd);
+    i8080* cpu = new i8080();
+    bool loaded = cpu->load_rom(rom_name);
+    unlink(rom_name);
+    if (!loaded)
+    {
+        fprintf(stderr, "cpu_check: cannot load %s\n", rom_name);
+        return 1;
+    }
+    cpu->write_byte(rst_target, 0xc3);
+    cpu->write_byte(rst_target + 1, program_start & 0xff);
+    cpu->write_byte(rst_target + 2, program_start >> 8);
+    cpu->emulate();
+    cpu->emulate();
+
+    check_steps(cpu);
+    check_alu(cpu);
+    check_inr_dcr(cpu);
+    check_daa(cpu);
+    check_rotates(cpu);
+    check_pairs(cpu);
+    check_moves(cpu);
+    if (failures)
+    {
+        fprintf(stderr, "%d checks failed\n", failures);
+        return 2;
+    }
+    fprintf(stderr, "every instruction matches\n");
+    return 0;
+}
@@ -0,0 +1,837 @@
+#include "debugger.hpp"
+#include "cpu.hpp"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <ctype.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+
+static const int max_stack = 16;
+
+static const char* operand_names[] = {
+    "a", "b", "c", "d", "e", "h", "l",
+    "bc", "de", "hl", "sp", "pc",
+    "z", "s", "p", "cy", "ac",
+    "address", "value",
+};
+
+// decimal, or hex with 0x or $. hex_default reads bare digits as hex, the way command addresses are written
+static bool parse_number(const char** text, uint32_t* value, bool hex_default)
+{
+    const char* p = *text;
+    int base = hex_default ? 16 : 10;
+    if (*p == '$')
+    {
+        base = 16;
+        ++p;
+    }
+    else if (p[0] == '0' && (p[1] == 'x' || p[1] == 'X'))
+    {
+        base = 16;
+        p += 2;
+    }
+    char* end;
+    unsigned long result = strtoul(p, &end, base);
+    if (end == p)
+    {
+        return false;
+    }
+    *value = result;
+    *text = end;
+    return true;
+}
+
+struct condition::parser
+{
+    const char* p;
+    std::vector<int32_t>& code;
+    std::string error;
+    int depth = 0;
+
+    parser(const char* text, std::vector<int32_t>& _code) : p(text), code(_code) {}
+
+    void skip()
+    {
+        while (*p == ' ' || *p == '\t')
+        {
+            ++p;
+        }
+    }
+
+    // matches token, but not when it is only the start of a longer operator: "&" does not match "&&"
+    bool accept(const char* token, const char* not_followed_by = "")
+    {
+        skip();
+        size_t n = strlen(token);
+        if (strncmp(p, token, n) != 0 || (p[n] && strchr(not_followed_by, p[n])))
+        {
+            return false;
+        }
+        p += n;
+        return true;
+    }
+
+    void push(int32_t op)
+    {
+        code.push_back(op);
+        if (++depth > max_stack && error.empty())
+        {
+            error = "expression too deep";
+        }
+    }
+
+    void binary(op o)
+    {
+        code.push_back(o);
+        --depth;
+    }
+
+    bool logical_or()
+    {
+        if (!logical_and())
+        {
+            return false;
+        }
+        while (accept("||"))
+        {
+            if (!logical_and())
+            {
+                return false;
+            }
+            binary(op_logical_or);
+        }
+        return true;
+    }
+
+    bool logical_and()
+    {
+        if (!compare())
+        {
+            return false;
+        }
+        while (accept("&&"))
+        {
+            if (!compare())
+            {
+                return false;
+            }
+            binary(op_logical_and);
+        }
+        return true;
+    }
+
+    bool compare()
+    {
+        if (!sum())
+        {
+            return false;
+        }
+        static const struct { const char* token; const char* not_followed_by; op code; } operators[] = {
+            {"==", "", op_equal}, {"!=", "", op_not_equal}, {"<=", "", op_less_equal}, {">=", "", op_greater_equal},
+            {"<", "=", op_less}, {">", "=", op_greater},
+        };
+        for (const auto& o : operators)
+        {
+            if (accept(o.token, o.not_followed_by))
+            {
+                if (!sum())
+                {
+                    return false;
+                }
+                binary(o.code);
+                break;
+            }
+        }
+        return true;
+    }
+
+    bool sum()
+    {
+        if (!term())
+        {
+            return false;
+        }
+        while (true)
+        {
+            op o;
+            if (accept("+"))
+            {
+                o = op_add;
+            }
+            else if (accept("-"))
+            {
+                o = op_sub;
+            }
+            else if (accept("&", "&"))
+            {
+                o = op_and;
+            }
+            else if (accept("|", "|"))
+            {
+                o = op_or;
+            }
+            else if (accept("^"))
+            {
+                o = op_xor;
+            }
+            else
+            {
+                return true;
+            }
+            if (!term())
+            {
+                return false;
+            }
+            binary(o);
+        }
+    }
+
+    bool term()
+    {
+        skip();
+        if (accept("!", "="))
+        {
+            if (!term())
+            {
+                return false;
+            }
+            code.push_back(op_not);
+            return true;
+        }
+        if (accept("-"))
+        {
+            if (!term())
+            {
+                return false;
+            }
+            code.push_back(op_negate);
+            return true;
+        }
+        if (accept("(") || accept("["))
+        {
+            char close = p[-1] == '(' ? ')' : ']';
+            if (!logical_or())
+            {
+                return false;
+            }
+            skip();
+            if (*p != close)
+            {
+                error = std::string("expected ") + close;
+                return false;
+            }
+            ++p;
+            if (close == ']')
+            {
+                code.push_back(op_load);
+            }
+            return true;
+        }
+
+        uint32_t value;
+        if (isdigit((unsigned char)*p) || *p == '$')
+        {
+            if (!parse_number(&p, &value, false))
+            {
+                error = "bad number";
+                return false;
+            }
+            push(op_constant);
+            code.push_back(value);
+            return true;
+        }
+
+        const char* start = p;
+        while (isalpha((unsigned char)*p))
+        {
+            ++p;
+        }
+        std::string name(start, p - start);
+        for (size_t i = 0; i < sizeof(operand_names) / sizeof(operand_names[0]); ++i)
+        {
+            if (name == operand_names[i])
+            {
+                push(op_operand);
+                code.push_back(i);
+                return true;
+            }
+        }
+        error = name.empty() ? "expected a value" : "unknown name " + name;
+        return false;
+    }
+};
+
+bool condition::compile(const char* _text, std::string* error)
+{
+    code.clear();
+    text = _text;
+    parser parse(_text, code);
+    bool ok = parse.logical_or();
+    parse.skip();
+    if (ok && *parse.p)
+    {
+        parse.error = std::string("unexpected ") + parse.p;
+        ok = false;
+    }
+    if (!ok || !parse.error.empty())
+    {
+        *error = parse.error;
+        code.clear();
+        return false;
+    }
+    return true;
+}
+
+debugger::debugger()
+{
+    cpu = nullptr;
+    std::fill(breakpoints, breakpoints + 1024, 0);
+    std::fill(page_traps, page_traps + 256, 0);
+    armed = 0;
+    breakpoint_count = 0;
+    steps_left = 0;
+    stop_requested = false;
+    speculating = false;
+    stopped = false;
+    shutting_down = false;
+    listen_fd = -1;
+    in_fd = -1;
+    out_fd = -1;
+}
+
+debugger::~debugger()
+{
+    if (listen_fd >= 0)
+    {
+        close(listen_fd);
+    }
+}
+
+bool debugger::start(basic_i8080<debugger>* _cpu, const char* endpoint)
+{
+    cpu = _cpu;
+    if (strcmp(endpoint, "-") == 0)
+    {
+        in_fd = STDIN_FILENO;
+        out_fd = STDOUT_FILENO;
+    }
+    else if (strncmp(endpoint, "unix:", 5) == 0)
+    {
+        sockaddr_un address = {};
+        address.sun_family = AF_UNIX;
+        strncpy(address.sun_path, endpoint + 5, sizeof(address.sun_path) - 1);
+        unlink(address.sun_path);
+        listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listen_fd < 0 || bind(listen_fd, (sockaddr*)&address, sizeof(address)) < 0 || listen(listen_fd, 1) < 0)
+        {
+            return false;
+        }
+    }
+    else if (strncmp(endpoint, "tcp:", 4) == 0)
+    {
+        // loopback only, the protocol has no authentication
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(atoi(endpoint + 4));
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+        int reuse = 1;
+        if (listen_fd < 0 || setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) < 0 ||
+            bind(listen_fd, (sockaddr*)&address, sizeof(address)) < 0 || listen(listen_fd, 1) < 0)
+        {
+            return false;
+        }
+    }
+    else
+    {
+        return false;
+    }
+
+    // the reader blocks in read and accept for the life of the process, nothing ever joins it
+    std::thread(&debugger::read_commands, this).detach();
+    return true;
+}
+
+void debugger::stop()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    shutting_down = true;
+    arrived.notify_all();
+}
+
+void debugger::read_commands()
+{
+    while (true)
+    {
+        if (listen_fd >= 0)
+        {
+            int client = accept(listen_fd, nullptr, nullptr);
+            if (client < 0)
+            {
+                return;
+            }
+            in_fd = client;
+            out_fd = client;
+            send("intel 8080 debugger\n");
+        }
+
+        std::string line;
+        char buffer[512];
+        ssize_t n;
+        while ((n = read(in_fd, buffer, sizeof(buffer))) > 0)
+        {
+            for (ssize_t i = 0; i < n; ++i)
+            {
+                if (buffer[i] == '\r')
+                {
+                    continue;
+                }
+                if (buffer[i] != '\n')
+                {
+                    line += buffer[i];
+                    continue;
+                }
+                std::lock_guard<std::mutex> guard(lock);
+                commands.push_back(line);
+                line.clear();
+                if (!stopped)
+                {
+                    stop_requested.store(true, std::memory_order_relaxed);
+                }
+                arrived.notify_one();
+            }
+        }
+
+        if (listen_fd < 0)
+        {
+            return;
+        }
+        // the cpu keeps whatever state the client left it in, a stopped cpu waits for the next client
+        out_fd = -1;
+        close(in_fd);
+    }
+}
+
+void debugger::send(const std::string& text)
+{
+    int fd = out_fd;
+    size_t done = 0;
+    while (fd >= 0 && done < text.size())
+    {
+        ssize_t n = write(fd, text.data() + done, text.size() - done);
+        if (n <= 0)
+        {
+            return;
+        }
+        done += n;
+    }
+}
+
+void debugger::rearm()
+{
+    armed = breakpoint_count + watchpoints.size() + (steps_left > 0) + !pending_stop.empty();
+}
+
+void debugger::update_page_traps()
+{
+    std::fill(page_traps, page_traps + 256, 0);
+    for (const watchpoint& watch : watchpoints)
+    {
+        for (int page = watch.start >> 8; page <= watch.end >> 8; ++page)
+        {
+            page_traps[page] |= watch.kinds;
+        }
+    }
+}
+
+bool debugger::test(const condition& when, uint16_t address, uint8_t value)
+{
+    if (when.empty())
+    {
+        return true;
+    }
+    basic_i8080<debugger>& c = *cpu;
+    auto read = [&](condition::operand operand) -> int32_t
+    {
+        switch (operand)
+        {
+        case condition::operand_a: return c.a;
+        case condition::operand_b: return c.b;
+        case condition::operand_c: return c.c;
+        case condition::operand_d: return c.d;
+        case condition::operand_e: return c.e;
+        case condition::operand_h: return c.h;
+        case condition::operand_l: return c.l;
+        case condition::operand_bc: return c.b << 8 | c.c;
+        case condition::operand_de: return c.d << 8 | c.e;
+        case condition::operand_hl: return c.h << 8 | c.l;
+        case condition::operand_sp: return c.sp;
+        case condition::operand_pc: return c.pc;
+        case condition::operand_z: return c.z;
+        case condition::operand_s: return c.s;
+        case condition::operand_p: return c.p;
+        case condition::operand_cy: return c.cy;
+        case condition::operand_ac: return c.ac;
+        case condition::operand_address: return address;
+        case condition::operand_value: return value;
+        }
+        return 0;
+    };
+    // straight from memory, a condition must not trip watchpoints itself
+    auto load = [&](uint16_t at) -> int32_t { return c.memory[at]; };
+    return when.evaluate(read, load) != 0;
+}
+
+void debugger::instruction_trap(uint16_t pc)
+{
+    if (speculating)
+    {
+        return;
+    }
+    if (!pending_stop.empty())
+    {
+        std::string reason;
+        reason.swap(pending_stop);
+        rearm();
+        pause(reason);
+        return;
+    }
+    if (stop_requested.load(std::memory_order_relaxed))
+    {
+        stop_requested = false;
+        pause("break");
+        return;
+    }
+    if (steps_left > 0 && --steps_left == 0)
+    {
+        rearm();
+        pause("step");
+        return;
+    }
+    if (has_breakpoint(pc))
+    {
+        auto it = breakpoint_conditions.find(pc);
+        if (it == breakpoint_conditions.end() || test(it->second, pc, 0))
+        {
+            char reason[32];
+            snprintf(reason, sizeof(reason), "breakpoint %04x", pc);
+            pause(reason);
+        }
+    }
+}
+
+void debugger::memory_trap(uint16_t address, uint8_t value, uint8_t kind)
+{
+    if (speculating || !pending_stop.empty())
+    {
+        return;
+    }
+    for (size_t i = 0; i < watchpoints.size(); ++i)
+    {
+        const watchpoint& watch = watchpoints[i];
+        if ((watch.kinds & kind) && address >= watch.start && address <= watch.end && test(watch.when, address, value))
+        {
+            char reason[64];
+            snprintf(reason, sizeof(reason), "watch %zu %s %04x = %02x", i, kind == trap_read ? "read" : "write", address, value);
+            pending_stop = reason;
+            rearm();
+            return;
+        }
+    }
+}
+
+void debugger::print_registers()
+{
+    basic_i8080<debugger>& c = *cpu;
+    char line[160];
+    snprintf(line, sizeof(line),
+             "pc=%04x sp=%04x a=%02x b=%02x c=%02x d=%02x e=%02x h=%02x l=%02x flags=%c%c%c%c%c cycles=%llu\n",
+             c.pc, c.sp, c.a, c.b, c.c, c.d, c.e, c.h, c.l,
+             c.s ? 's' : '-', c.z ? 'z' : '-', c.ac ? 'a' : '-', c.p ? 'p' : '-', c.cy ? 'c' : '-',
+             (unsigned long long)c.clock_count);
+    send(line);
+}
+
+void debugger::pause(const std::string& reason)
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopped = true;
+    }
+    send("stop " + reason + "\n");
+    print_registers();
+
+    while (true)
+    {
+        std::string line;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            arrived.wait(guard, [&]() { return !commands.empty() || shutting_down; });
+            if (shutting_down)
+            {
+                break;
+            }
+            line = commands.front();
+            commands.pop_front();
+        }
+        if (execute(line))
+        {
+            break;
+        }
+    }
+
+    std::lock_guard<std::mutex> guard(lock);
+    stopped = false;
+}
+
+bool debugger::set_register(const std::string& name, uint32_t value)
+{
+    basic_i8080<debugger>& c = *cpu;
+    uint8_t* bytes[] = {&c.a, &c.b, &c.c, &c.d, &c.e, &c.h, &c.l};
+    for (int i = 0; i < 7; ++i)
+    {
+        if (name == operand_names[i])
+        {
+            *bytes[i] = value;
+            return true;
+        }
+    }
+    uint8_t* pairs[][2] = {{&c.b, &c.c}, {&c.d, &c.e}, {&c.h, &c.l}};
+    for (int i = 0; i < 3; ++i)
+    {
+        if (name == operand_names[condition::operand_bc + i])
+        {
+            *pairs[i][0] = value >> 8;
+            *pairs[i][1] = value;
+            return true;
+        }
+    }
+    if (name == "sp") c.sp = value;
+    else if (name == "pc") c.pc = value;
+    else if (name == "z") c.z = value != 0;
+    else if (name == "s") c.s = value != 0;
+    else if (name == "p") c.p = value != 0;
+    else if (name == "cy") c.cy = value != 0;
+    else if (name == "ac") c.ac = value != 0;
+    else return false;
+    return true;
+}
+
+bool debugger::execute(const std::string& line)
+{
+    // "if" starts the condition, everything before it is split into words
+    std::string head = line;
+    std::string condition_text;
+    size_t at = line.find(" if ");
+    if (at != std::string::npos)
+    {
+        head = line.substr(0, at);
+        condition_text = line.substr(at + 4);
+    }
+    std::vector<std::string> words;
+    for (size_t i = 0; i < head.size(); )
+    {
+        size_t end = head.find_first_of(" \t", i);
+        end = end == std::string::npos ? head.size() : end;
+        if (end > i)
+        {
+            words.push_back(head.substr(i, end - i));
+        }
+        i = end + 1;
+    }
+    if (words.empty())
+    {
+        return false;
+    }
+
+    const std::string& command = words[0];
+    auto address_at = [&](size_t i, uint32_t* value) -> bool
+    {
+        const char* p = i < words.size() ? words[i].c_str() : "";
+        return parse_number(&p, value, true) && *p == '\0' && *value <= 0xffff;
+    };
+    auto fail = [&](const std::string& why) -> bool
+    {
+        send("error: " + why + "\n");
+        return false;
+    };
+
+    condition when;
+    std::string error;
+    if (!condition_text.empty() && !when.compile(condition_text.c_str(), &error))
+    {
+        return fail(error);
+    }
+
+    uint32_t address;
+    if (command == "c")
+    {
+        send("ok\n");
+        return true;
+    }
+    if (command == "s")
+    {
+        uint32_t count = 1;
+        const char* p = words.size() > 1 ? words[1].c_str() : "1";
+        if (!parse_number(&p, &count, false) || count == 0)
+        {
+            return fail("bad count");
+        }
+        steps_left = count;
+        rearm();
+        send("ok\n");
+        return true;
+    }
+    if (command == "q")
+    {
+        std::fill(breakpoints, breakpoints + 1024, 0);
+        breakpoint_conditions.clear();
+        breakpoint_count = 0;
+        watchpoints.clear();
+        steps_left = 0;
+        update_page_traps();
+        rearm();
+        send("ok\n");
+        return true;
+    }
+    if (command == "b")
+    {
+        if (!address_at(1, &address))
+        {
+            return fail("bad address");
+        }
+        if (!has_breakpoint(address))
+        {
+            breakpoints[address >> 6] |= 1ull << (address & 63);
+            breakpoint_count++;
+        }
+        breakpoint_conditions.erase(address);
+        if (!when.empty())
+        {
+            breakpoint_conditions[address] = when;
+        }
+        rearm();
+    }
+    else if (command == "d")
+    {
+        if (!address_at(1, &address) || !has_breakpoint(address))
+        {
+            return fail("no breakpoint there");
+        }
+        breakpoints[address >> 6] &= ~(1ull << (address & 63));
+        breakpoint_count--;
+        breakpoint_conditions.erase(address);
+        rearm();
+    }
+    else if (command == "w")
+    {
+        watchpoint watch;
+        const char* p = words.size() > 1 ? words[1].c_str() : "";
+        uint32_t start, end;
+        if (!parse_number(&p, &start, true))
+        {
+            return fail("bad address");
+        }
+        end = start;
+        if (*p == '-')
+        {
+            ++p;
+            if (!parse_number(&p, &end, true))
+            {
+                return fail("bad address");
+            }
+        }
+        if (*p || end > 0xffff || end < start)
+        {
+            return fail("bad range");
+        }
+        std::string kinds = words.size() > 2 ? words[2] : "w";
+        watch.start = start;
+        watch.end = end;
+        watch.kinds = (kinds.find('r') != std::string::npos ? trap_read : 0) | (kinds.find('w') != std::string::npos ? trap_write : 0);
+        if (!watch.kinds)
+        {
+            return fail("watch r, w or rw");
+        }
+        watch.when = when;
+        watchpoints.push_back(watch);
+        update_page_traps();
+        rearm();
+    }
+    else if (command == "dw")
+    {
+        const char* p = words.size() > 1 ? words[1].c_str() : "";
+        uint32_t index;
+        if (!parse_number(&p, &index, false) || index >= watchpoints.size())
+        {
+            return fail("no such watchpoint");
+        }
+        watchpoints.erase(watchpoints.begin() + index);
+        update_page_traps();
+        rearm();
+    }
+    else if (command == "l")
+    {
+        char text[64];
+        for (uint32_t pc = 0; pc < 0x10000; ++pc)
+        {
+            if (has_breakpoint(pc))
+            {
+                auto it = breakpoint_conditions.find(pc);
+                snprintf(text, sizeof(text), "b %04x", pc);
+                send(std::string(text) + (it == breakpoint_conditions.end() ? "" : " if " + it->second.source()) + "\n");
+            }
+        }
+        for (size_t i = 0; i < watchpoints.size(); ++i)
+        {
+            const watchpoint& watch = watchpoints[i];
+            snprintf(text, sizeof(text), "w%zu %04x-%04x %s%s", i, watch.start, watch.end,
+                     watch.kinds & trap_read ? "r" : "", watch.kinds & trap_write ? "w" : "");
+            send(std::string(text) + (watch.when.empty() ? "" : " if " + watch.when.source()) + "\n");
+        }
+    }
+    else if (command == "r")
+    {
+        print_registers();
+    }
+    else if (command == "m")
+    {
+        uint32_t length = 64;
+        const char* p = words.size() > 2 ? words[2].c_str() : "40";
+        if (!address_at(1, &address) || !parse_number(&p, &length, true))
+        {
+            return fail("bad address");
+        }
+        char text[80];
+        for (uint32_t row = 0; row < length; row += 16)
+        {
+            int n = snprintf(text, sizeof(text), "%04x:", (address + row) & 0xffff);
+            for (uint32_t i = row; i < std::min(length, row + 16); ++i)
+            {
+                n += snprintf(text + n, sizeof(text) - n, " %02x", cpu->memory[(address + i) & 0xffff]);
+            }
+            send(std::string(text) + "\n");
+        }
+    }
+    else if (command == "set")
+    {
+        const char* p = words.size() > 2 ? words[2].c_str() : "";
+        uint32_t value;
+        if (words.size() < 3 || !parse_number(&p, &value, true) || !set_register(words[1], value))
+        {
+            return fail("set reg value");
+        }
+    }
+    else
+    {
+        return fail("unknown command " + command);
+    }
+    send("ok\n");
+    return false;
+}
@@ -0,0 +1,216 @@
+#ifndef DEBUGGER_H
+#define DEBUGGER_H
+
+#include "observer.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+template<typename Observer>
+class basic_i8080;
+
+// condition compiled to a small stack bytecode, evaluated every time its breakpoint or watchpoint is reached.
+// the language is c like: registers a b c d e h l, pairs bc de hl sp pc, flags z s p cy ac, [expr] reads a
+// byte, address and value are the access that hit a watchpoint. numbers are decimal, 0x or $ hex.
+//   a == 0x10 && [hl] != 0
+//   value > 3 || pc == $1a32
+class condition
+{
+public:
+    // returns false and sets error when text does not parse
+    bool compile(const char* text, std::string* error);
+    bool empty() const { return code.empty(); }
+    const std::string& source() const { return text; }
+
+    enum operand : uint8_t
+    {
+        operand_a, operand_b, operand_c, operand_d, operand_e, operand_h, operand_l,
+        operand_bc, operand_de, operand_hl, operand_sp, operand_pc,
+        operand_z, operand_s, operand_p, operand_cy, operand_ac,
+        operand_address, operand_value,
+    };
+
+    // operands are looked up through read, memory through load, so the condition never touches the cpu itself
+    template<typename read_operand, typename load_byte>
+    int32_t evaluate(read_operand read, load_byte load) const;
+
+private:
+    enum op : uint8_t
+    {
+        op_constant, // followed by the value
+        op_operand,  // followed by an operand
+        op_load,
+        op_add, op_sub, op_and, op_or, op_xor,
+        op_equal, op_not_equal, op_less, op_less_equal, op_greater, op_greater_equal,
+        op_logical_and, op_logical_or, op_not, op_negate,
+    };
+
+    struct parser;
+
+    std::vector<int32_t> code;
+    std::string text;
+};
+
+template<typename read_operand, typename load_byte>
+int32_t condition::evaluate(read_operand read, load_byte load) const
+{
+    // compile keeps the expression within this depth
+    int32_t stack[16];
+    int top = -1;
+    for (size_t i = 0; i < code.size(); ++i)
+    {
+        int32_t r;
+        switch (code[i])
+        {
+        case op_constant: stack[++top] = code[++i]; continue;
+        case op_operand: stack[++top] = read((operand)code[++i]); continue;
+        case op_load: stack[top] = load((uint16_t)stack[top]); continue;
+        case op_not: stack[top] = !stack[top]; continue;
+        case op_negate: stack[top] = -stack[top]; continue;
+        default: break;
+        }
+        r = stack[top--];
+        int32_t& l = stack[top];
+        switch (code[i])
+        {
+        case op_add: l = l + r; break;
+        case op_sub: l = l - r; break;
+        case op_and: l = l & r; break;
+        case op_or: l = l | r; break;
+        case op_xor: l = l ^ r; break;
+        case op_equal: l = l == r; break;
+        case op_not_equal: l = l != r; break;
+        case op_less: l = l < r; break;
+        case op_less_equal: l = l <= r; break;
+        case op_greater: l = l > r; break;
+        case op_greater_equal: l = l >= r; break;
+        case op_logical_and: l = l && r; break;
+        case op_logical_or: l = l || r; break;
+        }
+    }
+    return top == 0 ? stack[0] : 1;
+}
+
+// breakpoint and watchpoint debugger, attached as the observer of a basic_i8080<debugger>.
+//
+// with nothing set, the only cost is two loads and a branch per instruction and one byte test per memory
+// access, and fused dispatch and idle skipping stay on. breakpoints are a 64K bit bitmap tested only
+// while something is armed. watchpoints set a trap flag on each 256 byte page they cover, so accesses
+// to other pages never look at the watchpoint list.
+//
+// it is driven by a line protocol over the console, a unix socket or a tcp port on localhost.
+// addresses in commands are hex:
+//   b addr [if cond]            breakpoint
+//   w addr[-end] r|w|rw [if cond]  watchpoint on reads, writes or both
+//   d addr | dw n               delete a breakpoint or watchpoint n
+//   l                           list them
+//   c                           continue
+//   s [n]                       step n instructions, 1 by default
+//   r                           registers
+//   m addr [length]             memory dump
+//   set reg value               change a register or flag
+//   q                           remove everything and keep running
+// input while the cpu runs stops it first, an empty line just stops it. stops are reported as
+// "stop <reason>" followed by the registers, every command is answered with "ok" or "error: <why>"
+class debugger : public null_observer
+{
+public:
+    debugger();
+    ~debugger();
+
+    // endpoint is "-" for the console, "unix:path" or "tcp:port". returns false if it cannot listen
+    bool start(basic_i8080<debugger>* cpu, const char* endpoint);
+    // releases a stopped cpu, called before the emulation thread is joined
+    void stop();
+
+    bool needs_every_instruction() const { return armed || stop_requested.load(std::memory_order_relaxed); }
+
+    void on_instruction(uint16_t pc, uint8_t)
+    {
+        if (needs_every_instruction())
+        {
+            instruction_trap(pc);
+        }
+    }
+    void on_read(uint16_t address, uint8_t value)
+    {
+        if (page_traps[address >> 8] & trap_read)
+        {
+            memory_trap(address, value, trap_read);
+        }
+    }
+    void on_write(uint16_t address, uint8_t value)
+    {
+        if (page_traps[address >> 8] & trap_write)
+        {
+            memory_trap(address, value, trap_write);
+        }
+    }
+    // frames that are undone afterwards never stop, step or hit a watchpoint
+    void on_speculation(bool on) { speculating = on; }
+
+private:
+    static const uint8_t trap_read = 1;
+    static const uint8_t trap_write = 2;
+
+    struct watchpoint
+    {
+        uint16_t start;
+        uint16_t end; // inclusive
+        uint8_t kinds;
+        condition when;
+    };
+
+    void instruction_trap(uint16_t pc);
+    void memory_trap(uint16_t address, uint8_t value, uint8_t kind);
+    // runs commands until one resumes the cpu
+    void pause(const std::string& reason);
+    // returns true when the command resumes the cpu
+    bool execute(const std::string& line);
+    void update_page_traps();
+    void rearm();
+    bool test(const condition& when, uint16_t address, uint8_t value);
+
+    void send(const std::string& text);
+    void print_registers();
+    // one register, pair or flag by name, false if there is no such name
+    bool set_register(const std::string& name, uint32_t value);
+    void read_commands();
+
+    bool has_breakpoint(uint16_t pc) const { return breakpoints[pc >> 6] >> (pc & 63) & 1; }
+
+    basic_i8080<debugger>* cpu;
+
+    uint64_t breakpoints[1024];
+    std::unordered_map<uint16_t, condition> breakpoint_conditions;
+    std::vector<watchpoint> watchpoints;
+    uint8_t page_traps[256];
+
+    // breakpoints and watchpoints, plus one while stepping or while a watchpoint stop is pending.
+    // only the cpu thread touches it, the reader thread asks for a stop through stop_requested
+    uint32_t armed;
+    uint32_t breakpoint_count;
+    uint64_t steps_left;
+    // a watchpoint hit mid instruction, reported at the next instruction boundary
+    std::string pending_stop;
+    std::atomic<bool> stop_requested;
+    bool speculating;
+
+    // commands from the reader thread, consumed by the cpu thread while it is stopped
+    std::mutex lock;
+    std::condition_variable arrived;
+    std::deque<std::string> commands;
+    bool stopped;
+    bool shutting_down;
+
+    int listen_fd;
+    int in_fd;
+    std::atomic<int> out_fd;
+};
+
+#endif
@@ -1,310 +1,498 @@
-#include <stdio.h>
-#include <fstream>
+#include "disassembler.hpp"
+#include "coverage.hpp"
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
 
-int Disassemble8080Op(unsigned char *codebuffer, int pc)
+struct op_format
 {
-	unsigned char *code = &codebuffer[pc];
-	int opbytes = 1;
-	printf("%04x ", pc);
-	switch (*code)
+	char text[16];
+	uint8_t text_length;
+	uint8_t bytes;
+};
+
+// mnemonic text for every opcode, operands are appended after the text in hex.
+// the text is padded to 16 bytes so it can be copied with a single fixed size memcpy
+static const op_format op_formats[256] = {
+	{"NOP",           3, 1}, // 0x00
+	{"LXI    B,#$",  11, 3}, // 0x01
+	{"STAX   B",      8, 1}, // 0x02
+	{"INX    B",      8, 1}, // 0x03
+	{"INR    B",      8, 1}, // 0x04
+	{"DCR    B",      8, 1}, // 0x05
+	{"MVI    B,#$",  11, 2}, // 0x06
+	{"RLC",           3, 1}, // 0x07
+	{"NOP",           3, 1}, // 0x08
+	{"DAD    B",      8, 1}, // 0x09
+	{"LDAX   B",      8, 1}, // 0x0a
+	{"DCX    B",      8, 1}, // 0x0b
+	{"INR    C",      8, 1}, // 0x0c
+	{"DCR    C",      8, 1}, // 0x0d
+	{"MVI    C,#$",  11, 2}, // 0x0e
+	{"RRC",           3, 1}, // 0x0f
+
+	{"NOP",           3, 1}, // 0x10
+	{"LXI    D,#$",  11, 3}, // 0x11
+	{"STAX   D",      8, 1}, // 0x12
+	{"INX    D",      8, 1}, // 0x13
+	{"INR    D",      8, 1}, // 0x14
+	{"DCR    D",      8, 1}, // 0x15
+	{"MVI    D,#$",  11, 2}, // 0x16
+	{"RAL",           3, 1}, // 0x17
+	{"NOP",           3, 1}, // 0x18
+	{"DAD    D",      8, 1}, // 0x19
+	{"LDAX   D",      8, 1}, // 0x1a
+	{"DCX    D",      8, 1}, // 0x1b
+	{"INR    E",      8, 1}, // 0x1c
+	{"DCR    E",      8, 1}, // 0x1d
+	{"MVI    E,#$",  11, 2}, // 0x1e
+	{"RAR",           3, 1}, // 0x1f
+
+	{"NOP",           3, 1}, // 0x20
+	{"LXI    H,#$",  11, 3}, // 0x21
+	{"SHLD   $",      8, 3}, // 0x22
+	{"INX    H",      8, 1}, // 0x23
+	{"INR    H",      8, 1}, // 0x24
+	{"DCR    H",      8, 1}, // 0x25
+	{"MVI    H,#$",  11, 2}, // 0x26
+	{"DAA",           3, 1}, // 0x27
+	{"NOP",           3, 1}, // 0x28
+	{"DAD    H",      8, 1}, // 0x29
+	{"LHLD   $",      8, 3}, // 0x2a
+	{"DCX    H",      8, 1}, // 0x2b
+	{"INR    L",      8, 1}, // 0x2c
+	{"DCR    L",      8, 1}, // 0x2d
+	{"MVI    L,#$",  11, 2}, // 0x2e
+	{"CMA",           3, 1}, // 0x2f
+
+	{"NOP",           3, 1}, // 0x30
+	{"LXI    SP,#$", 12, 3}, // 0x31
+	{"STA    $",      8, 3}, // 0x32
+	{"INX    SP",     9, 1}, // 0x33
+	{"INR    M",      8, 1}, // 0x34
+	{"DCR    M",      8, 1}, // 0x35
+	{"MVI    M,#$",  11, 2}, // 0x36
+	{"STC",           3, 1}, // 0x37
+	{"NOP",           3, 1}, // 0x38
+	{"DAD    SP",     9, 1}, // 0x39
+	{"LDA    $",      8, 3}, // 0x3a
+	{"DCX    SP",     9, 1}, // 0x3b
+	{"INR    A",      8, 1}, // 0x3c
+	{"DCR    A",      8, 1}, // 0x3d
+	{"MVI    A,#$",  11, 2}, // 0x3e
+	{"CMC",           3, 1}, // 0x3f
+
+	{"MOV    B,B",   10, 1}, // 0x40
+	{"MOV    B,C",   10, 1}, // 0x41
+	{"MOV    B,D",   10, 1}, // 0x42
+	{"MOV    B,E",   10, 1}, // 0x43
+	{"MOV    B,H",   10, 1}, // 0x44
+	{"MOV    B,L",   10, 1}, // 0x45
+	{"MOV    B,M",   10, 1}, // 0x46
+	{"MOV    B,A",   10, 1}, // 0x47
+	{"MOV    C,B",   10, 1}, // 0x48
+	{"MOV    C,C",   10, 1}, // 0x49
+	{"MOV    C,D",   10, 1}, // 0x4a
+	{"MOV    C,E",   10, 1}, // 0x4b
+	{"MOV    C,H",   10, 1}, // 0x4c
+	{"MOV    C,L",   10, 1}, // 0x4d
+	{"MOV    C,M",   10, 1}, // 0x4e
+	{"MOV    C,A",   10, 1}, // 0x4f
+
+	{"MOV    D,B",   10, 1}, // 0x50
+	{"MOV    D,C",   10, 1}, // 0x51
+	{"MOV    D,D",   10, 1}, // 0x52
+	{"MOV    D,E",   10, 1}, // 0x53
+	{"MOV    D,H",   10, 1}, // 0x54
+	{"MOV    D,L",   10, 1}, // 0x55
+	{"MOV    D,M",   10, 1}, // 0x56
+	{"MOV    D,A",   10, 1}, // 0x57
+	{"MOV    E,B",   10, 1}, // 0x58
+	{"MOV    E,C",   10, 1}, // 0x59
+	{"MOV    E,D",   10, 1}, // 0x5a
+	{"MOV    E,E",   10, 1}, // 0x5b
+	{"MOV    E,H",   10, 1}, // 0x5c
+	{"MOV    E,L",   10, 1}, // 0x5d
+	{"MOV    E,M",   10, 1}, // 0x5e
+	{"MOV    E,A",   10, 1}, // 0x5f
+
+	{"MOV    H,B",   10, 1}, // 0x60
+	{"MOV    H,C",   10, 1}, // 0x61
+	{"MOV    H,D",   10, 1}, // 0x62
+	{"MOV    H,E",   10, 1}, // 0x63
+	{"MOV    H,H",   10, 1}, // 0x64
+	{"MOV    H,L",   10, 1}, // 0x65
+	{"MOV    H,M",   10, 1}, // 0x66
+	{"MOV    H,A",   10, 1}, // 0x67
+	{"MOV    L,B",   10, 1}, // 0x68
+	{"MOV    L,C",   10, 1}, // 0x69
+	{"MOV    L,D",   10, 1}, // 0x6a
+	{"MOV    L,E",   10, 1}, // 0x6b
+	{"MOV    L,H",   10, 1}, // 0x6c
+	{"MOV    L,L",   10, 1}, // 0x6d
+	{"MOV    L,M",   10, 1}, // 0x6e
+	{"MOV    L,A",   10, 1}, // 0x6f
+
+	{"MOV    M,B",   10, 1}, // 0x70
+	{"MOV    M,C",   10, 1}, // 0x71
+	{"MOV    M,D",   10, 1}, // 0x72
+	{"MOV    M,E",   10, 1}, // 0x73
+	{"MOV    M,H",   10, 1}, // 0x74
+	{"MOV    M,L",   10, 1}, // 0x75
+	{"HLT",           3, 1}, // 0x76
+	{"MOV    M,A",   10, 1}, // 0x77
+	{"MOV    A,B",   10, 1}, // 0x78
+	{"MOV    A,C",   10, 1}, // 0x79
+	{"MOV    A,D",   10, 1}, // 0x7a
+	{"MOV    A,E",   10, 1}, // 0x7b
+	{"MOV    A,H",   10, 1}, // 0x7c
+	{"MOV    A,L",   10, 1}, // 0x7d
+	{"MOV    A,M",   10, 1}, // 0x7e
+	{"MOV    A,A",   10, 1}, // 0x7f
+
+	{"ADD    B",      8, 1}, // 0x80
+	{"ADD    C",      8, 1}, // 0x81
+	{"ADD    D",      8, 1}, // 0x82
+	{"ADD    E",      8, 1}, // 0x83
+	{"ADD    H",      8, 1}, // 0x84
+	{"ADD    L",      8, 1}, // 0x85
+	{"ADD    M",      8, 1}, // 0x86
+	{"ADD    A",      8, 1}, // 0x87
+	{"ADC    B",      8, 1}, // 0x88
+	{"ADC    C",      8, 1}, // 0x89
+	{"ADC    D",      8, 1}, // 0x8a
+	{"ADC    E",      8, 1}, // 0x8b
+	{"ADC    H",      8, 1}, // 0x8c
+	{"ADC    L",      8, 1}, // 0x8d
+	{"ADC    M",      8, 1}, // 0x8e
+	{"ADC    A",      8, 1}, // 0x8f
+
+	{"SUB    B",      8, 1}, // 0x90
+	{"SUB    C",      8, 1}, // 0x91
+	{"SUB    D",      8, 1}, // 0x92
+	{"SUB    E",      8, 1}, // 0x93
+	{"SUB    H",      8, 1}, // 0x94
+	{"SUB    L",      8, 1}, // 0x95
+	{"SUB    M",      8, 1}, // 0x96
+	{"SUB    A",      8, 1}, // 0x97
+	{"SBB    B",      8, 1}, // 0x98
+	{"SBB    C",      8, 1}, // 0x99
+	{"SBB    D",      8, 1}, // 0x9a
+	{"SBB    E",      8, 1}, // 0x9b
+	{"SBB    H",      8, 1}, // 0x9c
+	{"SBB    L",      8, 1}, // 0x9d
+	{"SBB    M",      8, 1}, // 0x9e
+	{"SBB    A",      8, 1}, // 0x9f
+
+	{"ANA    B",      8, 1}, // 0xa0
+	{"ANA    C",      8, 1}, // 0xa1
+	{"ANA    D",      8, 1}, // 0xa2
+	{"ANA    E",      8, 1}, // 0xa3
+	{"ANA    H",      8, 1}, // 0xa4
+	{"ANA    L",      8, 1}, // 0xa5
+	{"ANA    M",      8, 1}, // 0xa6
+	{"ANA    A",      8, 1}, // 0xa7
+	{"XRA    B",      8, 1}, // 0xa8
+	{"XRA    C",      8, 1}, // 0xa9
+	{"XRA    D",      8, 1}, // 0xaa
+	{"XRA    E",      8, 1}, // 0xab
+	{"XRA    H",      8, 1}, // 0xac
+	{"XRA    L",      8, 1}, // 0xad
+	{"XRA    M",      8, 1}, // 0xae
+	{"XRA    A",      8, 1}, // 0xaf
+
+	{"ORA    B",      8, 1}, // 0xb0
+	{"ORA    C",      8, 1}, // 0xb1
+	{"ORA    D",      8, 1}, // 0xb2
+	{"ORA    E",      8, 1}, // 0xb3
+	{"ORA    H",      8, 1}, // 0xb4
+	{"ORA    L",      8, 1}, // 0xb5
+	{"ORA    M",      8, 1}, // 0xb6
+	{"ORA    A",      8, 1}, // 0xb7
+	{"CMP    B",      8, 1}, // 0xb8
+	{"CMP    C",      8, 1}, // 0xb9
+	{"CMP    D",      8, 1}, // 0xba
+	{"CMP    E",      8, 1}, // 0xbb
+	{"CMP    H",      8, 1}, // 0xbc
+	{"CMP    L",      8, 1}, // 0xbd
+	{"CMP    M",      8, 1}, // 0xbe
+	{"CMP    A",      8, 1}, // 0xbf
+
+	{"RNZ",           3, 1}, // 0xc0
+	{"POP    B",      8, 1}, // 0xc1
+	{"JNZ    $",      8, 3}, // 0xc2
+	{"JMP    $",      8, 3}, // 0xc3
+	{"CNZ    $",      8, 3}, // 0xc4
+	{"PUSH   B",      8, 1}, // 0xc5
+	{"ADI    #$",     9, 2}, // 0xc6
+	{"RST    0",      8, 1}, // 0xc7
+	{"RZ",            2, 1}, // 0xc8
+	{"RET",           3, 1}, // 0xc9
+	{"JZ     $",      8, 3}, // 0xca
+	{"JMP    $",      8, 3}, // 0xcb
+	{"CZ     $",      8, 3}, // 0xcc
+	{"CALL   $",      8, 3}, // 0xcd
+	{"ACI    #$",     9, 2}, // 0xce
+	{"RST    1",      8, 1}, // 0xcf
+
+	{"RNC",           3, 1}, // 0xd0
+	{"POP    D",      8, 1}, // 0xd1
+	{"JNC    $",      8, 3}, // 0xd2
+	{"OUT    #$",     9, 2}, // 0xd3
+	{"CNC    $",      8, 3}, // 0xd4
+	{"PUSH   D",      8, 1}, // 0xd5
+	{"SUI    #$",     9, 2}, // 0xd6
+	{"RST    2",      8, 1}, // 0xd7
+	{"RC",            2, 1}, // 0xd8
+	{"RET",           3, 1}, // 0xd9
+	{"JC     $",      8, 3}, // 0xda
+	{"IN     #$",     9, 2}, // 0xdb
+	{"CC     $",      8, 3}, // 0xdc
+	{"CALL   $",      8, 3}, // 0xdd
+	{"SBI    #$",     9, 2}, // 0xde
+	{"RST    3",      8, 1}, // 0xdf
+
+	{"RPO",           3, 1}, // 0xe0
+	{"POP    H",      8, 1}, // 0xe1
+	{"JPO    $",      8, 3}, // 0xe2
+	{"XTHL",          4, 1}, // 0xe3
+	{"CPO    $",      8, 3}, // 0xe4
+	{"PUSH   H",      8, 1}, // 0xe5
+	{"ANI    #$",     9, 2}, // 0xe6
+	{"RST    4",      8, 1}, // 0xe7
+	{"RPE",           3, 1}, // 0xe8
+	{"PCHL",          4, 1}, // 0xe9
+	{"JPE    $",      8, 3}, // 0xea
+	{"XCHG",          4, 1}, // 0xeb
+	{"CPE    $",      8, 3}, // 0xec
+	{"CALL   $",      8, 3}, // 0xed
+	{"XRI    #$",     9, 2}, // 0xee
+	{"RST    5",      8, 1}, // 0xef
+
+	{"RP",            2, 1}, // 0xf0
+	{"POP    PSW",   10, 1}, // 0xf1
+	{"JP     $",      8, 3}, // 0xf2
+	{"DI",            2, 1}, // 0xf3
+	{"CP     $",      8, 3}, // 0xf4
+	{"PUSH   PSW",   10, 1}, // 0xf5
+	{"ORI    #$",     9, 2}, // 0xf6
+	{"RST    6",      8, 1}, // 0xf7
+	{"RM",            2, 1}, // 0xf8
+	{"SPHL",          4, 1}, // 0xf9
+	{"JM     $",      8, 3}, // 0xfa
+	{"EI",            2, 1}, // 0xfb
+	{"CM     $",      8, 3}, // 0xfc
+	{"CALL   $",      8, 3}, // 0xfd
+	{"CPI    #$",     9, 2}, // 0xfe
+	{"RST    7",      8, 1}, // 0xff
+};
+
+const uint8_t opcode_lengths[256] = {
+	1, 3, 1, 1, 1, 1, 2, 1, 1, 1, 1, 1, 1, 1, 2, 1,
+	1, 3, 1, 1, 1, 1, 2, 1, 1, 1, 1, 1, 1, 1, 2, 1,
+	1, 3, 3, 1, 1, 1, 2, 1, 1, 1, 3, 1, 1, 1, 2, 1,
+	1, 3, 3, 1, 1, 1, 2, 1, 1, 1, 3, 1, 1, 1, 2, 1,
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 3, 3, 3, 1, 2, 1, 1, 1, 3, 3, 3, 3, 2, 1,
+	1, 1, 3, 2, 3, 1, 2, 1, 1, 1, 3, 2, 3, 3, 2, 1,
+	1, 1, 3, 1, 3, 1, 2, 1, 1, 1, 3, 1, 3, 3, 2, 1,
+	1, 1, 3, 1, 3, 1, 2, 1, 1, 1, 3, 1, 3, 3, 2, 1,
+};
+
+static const char hex_digits[] = "0123456789abcdef";
+
+// two characters per byte, so a byte is formatted with one 16 bit copy
+static const char hex_pairs[513] =
+	"000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f"
+	"202122232425262728292a2b2c2d2e2f303132333435363738393a3b3c3d3e3f"
+	"404142434445464748494a4b4c4d4e4f505152535455565758595a5b5c5d5e5f"
+	"606162636465666768696a6b6c6d6e6f707172737475767778797a7b7c7d7e7f"
+	"808182838485868788898a8b8c8d8e8f909192939495969798999a9b9c9d9e9f"
+	"a0a1a2a3a4a5a6a7a8a9aaabacadaeafb0b1b2b3b4b5b6b7b8b9babbbcbdbebf"
+	"c0c1c2c3c4c5c6c7c8c9cacbcccdcecfd0d1d2d3d4d5d6d7d8d9dadbdcdddedf"
+	"e0e1e2e3e4e5e6e7e8e9eaebecedeeeff0f1f2f3f4f5f6f7f8f9fafbfcfdfeff";
+
+static inline char* put_byte(char* out, uint8_t val)
+{
+	memcpy(out, &hex_pairs[val * 2], 2);
+	return out + 2;
+}
+
+void write_linear_listing(const uint8_t* code, size_t size, size_t origin, output_buffer& out, const coverage_marks* marks)
+{
+	if (marks)
+	{
+		// one line at a time, each needs its prefix
+		for (size_t pc = 0; pc < size && !out.failed();)
+		{
+			out.write(coverage_prefix(*marks, origin + pc, 1, true), 2);
+			int opbytes;
+			out.commit(disassemble_op(code, size, pc, origin, out.reserve(max_line_length), &opbytes));
+			pc += opbytes;
+		}
+		return;
+	}
+
+	// listing is formatted straight into the output buffer, no intermediate copies
+	size_t pc = 0;
+	while (pc < size && !out.failed())
+	{
+		char* space = out.reserve(64 * 1024);
+		out.commit(disassemble(code, size, &pc, origin, space, out.available()));
+	}
+}
+
+const char* opcode_text(uint8_t opcode, size_t* length)
+{
+	const op_format& format = op_formats[opcode];
+	size_t n = format.text_length;
+	// operand prefixes "$" and "#$" belong to the operand, not the mnemonic
+	while (n > 0 && (format.text[n - 1] == '$' || format.text[n - 1] == '#'))
+	{
+		--n;
+	}
+	*length = n;
+	return format.text;
+}
+
+void write_hex(char* out, size_t val, int digits)
+{
+	for (int i = digits - 1; i >= 0; --i)
+	{
+		out[i] = hex_digits[val & 0xf];
+		val >>= 4;
+	}
+}
+
+// addresses are four digits like the rest of the listing, larger offsets in long traces grow as needed
+static inline char* put_address(char* out, size_t address)
+{
+	if (address <= 0xffff)
+	{
+		out = put_byte(out, address >> 8);
+		return put_byte(out, address & 0xff);
+	}
+	int digits = 4;
+	while (digits < 16 && (address >> (digits * 4)) != 0)
+	{
+		++digits;
+	}
+	write_hex(out, address, digits);
+	return out + digits;
+}
+
+size_t disassemble_op(const uint8_t* code, size_t size, size_t pc, size_t origin, char* out, int* opbytes)
+{
+	char* start = out;
+	const op_format& format = op_formats[code[pc]];
+
+	out = put_address(out, origin + pc);
+	*out++ = ' ';
+
+	if (pc + format.bytes > size)
+	{
+		memcpy(out, "DB     #$", 9);
+		out = put_byte(out + 9, code[pc]);
+		*out++ = '\n';
+		*opbytes = 1;
+		return out - start;
+	}
+
+	memcpy(out, format.text, sizeof(format.text));
+	out += format.text_length;
+	if (format.bytes == 3)
+	{
+		out = put_byte(out, code[pc + 2]);
+		out = put_byte(out, code[pc + 1]);
+	}
+	else if (format.bytes == 2)
+	{
+		out = put_byte(out, code[pc + 1]);
+	}
+	*out++ = '\n';
+
+	*opbytes = format.bytes;
+	return out - start;
+}
+
+size_t disassemble(const uint8_t* code, size_t size, size_t* pc, size_t origin, char* out, size_t out_size)
+{
+	size_t written = 0;
+	size_t offset = *pc;
+	int opbytes;
+	while (offset < size && out_size - written >= max_line_length)
+	{
+		written += disassemble_op(code, size, offset, origin, out + written, &opbytes);
+		offset += opbytes;
+	}
+	*pc = offset;
+	return written;
+}
+
+output_buffer::output_buffer(int _fd, size_t _capacity)
+{
+	fd = _fd;
+	capacity = _capacity;
+	used = 0;
+	error = false;
+	buffer = new char[capacity];
+}
+
+output_buffer::~output_buffer()
+{
+	flush();
+	delete[] buffer;
+}
+
+char* output_buffer::reserve(size_t n)
+{
+	if (capacity - used < n)
+	{
+		flush();
+	}
+	return buffer + used;
+}
+
+void output_buffer::write(const char* data, size_t n)
+{
+	while (n > 0)
 	{
-		case 0x00: printf("NOP"); break;
-		case 0x01: printf("LXI    B,#$%02x%02x", code[2], code[1]); opbytes=3; break;
-		case 0x02: printf("STAX   B"); break;
-		case 0x03: printf("INX    B"); break;
-		case 0x04: printf("INR    B"); break;
-		case 0x05: printf("DCR    B"); break;
-		case 0x06: printf("MVI    B,#$%02x", code[1]); opbytes=2; break;
-		case 0x07: printf("RLC"); break;
-		case 0x08: printf("NOP"); break;
-		case 0x09: printf("DAD    B"); break;
-		case 0x0a: printf("LDAX   B"); break;
-		case 0x0b: printf("DCX    B"); break;
-		case 0x0c: printf("INR    C"); break;
-		case 0x0d: printf("DCR    C"); break;
-		case 0x0e: printf("MVI    C,#$%02x", code[1]); opbytes = 2;	break;
-		case 0x0f: printf("RRC"); break;
-			
-		case 0x10: printf("NOP"); break;
-		case 0x11: printf("LXI    D,#$%02x%02x", code[2], code[1]); opbytes=3; break;
-		case 0x12: printf("STAX   D"); break;
-		case 0x13: printf("INX    D"); break;
-		case 0x14: printf("INR    D"); break;
-		case 0x15: printf("DCR    D"); break;
-		case 0x16: printf("MVI    D,#$%02x", code[1]); opbytes=2; break;
-		case 0x17: printf("RAL"); break;
-		case 0x18: printf("NOP"); break;
-		case 0x19: printf("DAD    D"); break;
-		case 0x1a: printf("LDAX   D"); break;
-		case 0x1b: printf("DCX    D"); break;
-		case 0x1c: printf("INR    E"); break;
-		case 0x1d: printf("DCR    E"); break;
-		case 0x1e: printf("MVI    E,#$%02x", code[1]); opbytes = 2; break;
-		case 0x1f: printf("RAR"); break;
-			
-		case 0x20: printf("NOP"); break;
-		case 0x21: printf("LXI    H,#$%02x%02x", code[2], code[1]); opbytes=3; break;
-		case 0x22: printf("SHLD   $%02x%02x", code[2], code[1]); opbytes=3; break;
-		case 0x23: printf("INX    H"); break;
-		case 0x24: printf("INR    H"); break;
-		case 0x25: printf("DCR    H"); break;
-		case 0x26: printf("MVI    H,#$%02x", code[1]); opbytes=2; break;
-		case 0x27: printf("DAA"); break;
-		case 0x28: printf("NOP"); break;
-		case 0x29: printf("DAD    H"); break;
-		case 0x2a: printf("LHLD   $%02x%02x", code[2], code[1]); opbytes=3; break;
-		case 0x2b: printf("DCX    H"); break;
-		case 0x2c: printf("INR    L"); break;
-		case 0x2d: printf("DCR    L"); break;
-		case 0x2e: printf("MVI    L,#$%02x", code[1]); opbytes = 2; break;
-		case 0x2f: printf("CMA"); break;
-			
-		case 0x30: printf("NOP"); break;
-		case 0x31: printf("LXI    SP,#$%02x%02x", code[2], code[1]); opbytes=3; break;
-		case 0x32: printf("STA    $%02x%02x", code[2], code[1]); opbytes=3; break;
-		case 0x33: printf("INX    SP"); break;
-		case 0x34: printf("INR    M"); break;
-		case 0x35: printf("DCR    M"); break;
-		case 0x36: printf("MVI    M,#$%02x", code[1]); opbytes=2; break;
-		case 0x37: printf("STC"); break;
-		case 0x38: printf("NOP"); break;
-		case 0x39: printf("DAD    SP"); break;
-		case 0x3a: printf("LDA    $%02x%02x", code[2], code[1]); opbytes=3; break;
-		case 0x3b: printf("DCX    SP"); break;
-		case 0x3c: printf("INR    A"); break;
-		case 0x3d: printf("DCR    A"); break;
-		case 0x3e: printf("MVI    A,#$%02x", code[1]); opbytes = 2; break;
-		case 0x3f: printf("CMC"); break;
-			
-		case 0x40: printf("MOV    B,B"); break;
-		case 0x41: printf("MOV    B,C"); break;
-		case 0x42: printf("MOV    B,D"); break;
-		case 0x43: printf("MOV    B,E"); break;
-		case 0x44: printf("MOV    B,H"); break;
-		case 0x45: printf("MOV    B,L"); break;
-		case 0x46: printf("MOV    B,M"); break;
-		case 0x47: printf("MOV    B,A"); break;
-		case 0x48: printf("MOV    C,B"); break;
-		case 0x49: printf("MOV    C,C"); break;
-		case 0x4a: printf("MOV    C,D"); break;
-		case 0x4b: printf("MOV    C,E"); break;
-		case 0x4c: printf("MOV    C,H"); break;
-		case 0x4d: printf("MOV    C,L"); break;
-		case 0x4e: printf("MOV    C,M"); break;
-		case 0x4f: printf("MOV    C,A"); break;
-			
-		case 0x50: printf("MOV    D,B"); break;
-		case 0x51: printf("MOV    D,C"); break;
-		case 0x52: printf("MOV    D,D"); break;
-		case 0x53: printf("MOV    D.E"); break;
-		case 0x54: printf("MOV    D,H"); break;
-		case 0x55: printf("MOV    D,L"); break;
-		case 0x56: printf("MOV    D,M"); break;
-		case 0x57: printf("MOV    D,A"); break;
-		case 0x58: printf("MOV    E,B"); break;
-		case 0x59: printf("MOV    E,C"); break;
-		case 0x5a: printf("MOV    E,D"); break;
-		case 0x5b: printf("MOV    E,E"); break;
-		case 0x5c: printf("MOV    E,H"); break;
-		case 0x5d: printf("MOV    E,L"); break;
-		case 0x5e: printf("MOV    E,M"); break;
-		case 0x5f: printf("MOV    E,A"); break;
-
-		case 0x60: printf("MOV    H,B"); break;
-		case 0x61: printf("MOV    H,C"); break;
-		case 0x62: printf("MOV    H,D"); break;
-		case 0x63: printf("MOV    H.E"); break;
-		case 0x64: printf("MOV    H,H"); break;
-		case 0x65: printf("MOV    H,L"); break;
-		case 0x66: printf("MOV    H,M"); break;
-		case 0x67: printf("MOV    H,A"); break;
-		case 0x68: printf("MOV    L,B"); break;
-		case 0x69: printf("MOV    L,C"); break;
-		case 0x6a: printf("MOV    L,D"); break;
-		case 0x6b: printf("MOV    L,E"); break;
-		case 0x6c: printf("MOV    L,H"); break;
-		case 0x6d: printf("MOV    L,L"); break;
-		case 0x6e: printf("MOV    L,M"); break;
-		case 0x6f: printf("MOV    L,A"); break;
-
-		case 0x70: printf("MOV    M,B"); break;
-		case 0x71: printf("MOV    M,C"); break;
-		case 0x72: printf("MOV    M,D"); break;
-		case 0x73: printf("MOV    M.E"); break;
-		case 0x74: printf("MOV    M,H"); break;
-		case 0x75: printf("MOV    M,L"); break;
-		case 0x76: printf("HLT");        break;
-		case 0x77: printf("MOV    M,A"); break;
-		case 0x78: printf("MOV    A,B"); break;
-		case 0x79: printf("MOV    A,C"); break;
-		case 0x7a: printf("MOV    A,D"); break;
-		case 0x7b: printf("MOV    A,E"); break;
-		case 0x7c: printf("MOV    A,H"); break;
-		case 0x7d: printf("MOV    A,L"); break;
-		case 0x7e: printf("MOV    A,M"); break;
-		case 0x7f: printf("MOV    A,A"); break;
-
-		case 0x80: printf("ADD    B"); break;
-		case 0x81: printf("ADD    C"); break;
-		case 0x82: printf("ADD    D"); break;
-		case 0x83: printf("ADD    E"); break;
-		case 0x84: printf("ADD    H"); break;
-		case 0x85: printf("ADD    L"); break;
-		case 0x86: printf("ADD    M"); break;
-		case 0x87: printf("ADD    A"); break;
-		case 0x88: printf("ADC    B"); break;
-		case 0x89: printf("ADC    C"); break;
-		case 0x8a: printf("ADC    D"); break;
-		case 0x8b: printf("ADC    E"); break;
-		case 0x8c: printf("ADC    H"); break;
-		case 0x8d: printf("ADC    L"); break;
-		case 0x8e: printf("ADC    M"); break;
-		case 0x8f: printf("ADC    A"); break;
-
-		case 0x90: printf("SUB    B"); break;
-		case 0x91: printf("SUB    C"); break;
-		case 0x92: printf("SUB    D"); break;
-		case 0x93: printf("SUB    E"); break;
-		case 0x94: printf("SUB    H"); break;
-		case 0x95: printf("SUB    L"); break;
-		case 0x96: printf("SUB    M"); break;
-		case 0x97: printf("SUB    A"); break;
-		case 0x98: printf("SBB    B"); break;
-		case 0x99: printf("SBB    C"); break;
-		case 0x9a: printf("SBB    D"); break;
-		case 0x9b: printf("SBB    E"); break;
-		case 0x9c: printf("SBB    H"); break;
-		case 0x9d: printf("SBB    L"); break;
-		case 0x9e: printf("SBB    M"); break;
-		case 0x9f: printf("SBB    A"); break;
-
-		case 0xa0: printf("ANA    B"); break;
-		case 0xa1: printf("ANA    C"); break;
-		case 0xa2: printf("ANA    D"); break;
-		case 0xa3: printf("ANA    E"); break;
-		case 0xa4: printf("ANA    H"); break;
-		case 0xa5: printf("ANA    L"); break;
-		case 0xa6: printf("ANA    M"); break;
-		case 0xa7: printf("ANA    A"); break;
-		case 0xa8: printf("XRA    B"); break;
-		case 0xa9: printf("XRA    C"); break;
-		case 0xaa: printf("XRA    D"); break;
-		case 0xab: printf("XRA    E"); break;
-		case 0xac: printf("XRA    H"); break;
-		case 0xad: printf("XRA    L"); break;
-		case 0xae: printf("XRA    M"); break;
-		case 0xaf: printf("XRA    A"); break;
-
-		case 0xb0: printf("ORA    B"); break;
-		case 0xb1: printf("ORA    C"); break;
-		case 0xb2: printf("ORA    D"); break;
-		case 0xb3: printf("ORA    E"); break;
-		case 0xb4: printf("ORA    H"); break;
-		case 0xb5: printf("ORA    L"); break;
-		case 0xb6: printf("ORA    M"); break;
-		case 0xb7: printf("ORA    A"); break;
-		case 0xb8: printf("CMP    B"); break;
-		case 0xb9: printf("CMP    C"); break;
-		case 0xba: printf("CMP    D"); break;
-		case 0xbb: printf("CMP    E"); break;
-		case 0xbc: printf("CMP    H"); break;
-		case 0xbd: printf("CMP    L"); break;
-		case 0xbe: printf("CMP    M"); break;
-		case 0xbf: printf("CMP    A"); break;
-
-		case 0xc0: printf("RNZ"); break;
-		case 0xc1: printf("POP    B"); break;
-		case 0xc2: printf("JNZ    $%02x%02x",code[2],code[1]); opbytes = 3; break;
-		case 0xc3: printf("JMP    $%02x%02x",code[2],code[1]); opbytes = 3; break;
-		case 0xc4: printf("CNZ    $%02x%02x",code[2],code[1]); opbytes = 3; break;
-		case 0xc5: printf("PUSH   B"); break;
-		case 0xc6: printf("ADI    #$%02x",code[1]); opbytes = 2; break;
-		case 0xc7: printf("RST    0"); break;
-		case 0xc8: printf("RZ"); break;
-		case 0xc9: printf("RET"); break;
-		case 0xca: printf("JZ     $%02x%02x",code[2],code[1]); opbytes = 3; break;
-		case 0xcb: printf("JMP    $%02x%02x",code[2],code[1]); opbytes = 3; break;
-		case 0xcc: printf("CZ     $%02x%02x",code[2],code[1]); opbytes = 3; break;
-		case 0xcd: printf("CALL   $%02x%02x",code[2],code[1]); opbytes = 3; break;
-		case 0xce: printf("ACI    #$%02x",code[1]); opbytes = 2; break;
-		case 0xcf: printf("RST    1"); break;
-
-		case 0xd0: printf("RNC"); break;
-		case 0xd1: printf("POP    D"); break;
-		case 0xd2: printf("JNC    $%02x%02x",code[2],code[1]); opbytes = 3; break;
-		case 0xd3: printf("OUT    #$%02x",code[1]); opbytes = 2; break;
-		case 0xd4: printf("CNC    $%02x%02x",code[2],code[1]); opbytes = 3; break;
-		case 0xd5: printf("PUSH   D"); break;
-		case 0xd6: printf("SUI    #$%02x",code[1]); opbytes = 2; break;
-		case 0xd7: printf("RST    2"); break;
-		case 0xd8: printf("RC");  break;
-		case 0xd9: printf("RET"); break;
-		case 0xda: printf("JC     $%02x%02x",code[2],code[1]); opbytes = 3; break;
-		case 0xdb: printf("IN     #$%02x",code[1]); opbytes = 2; break;
-		case 0xdc: printf("CC     $%02x%02x",code[2],code[1]); opbytes = 3; break;
-		case 0xdd: printf("CALL   $%02x%02x",code[2],code[1]); opbytes = 3; break;
-		case 0xde: printf("SBI    #$%02x",code[1]); opbytes = 2; break;
-		case 0xdf: printf("RST    3"); break;
-
-		case 0xe0: printf("RPO"); break;
-		case 0xe1: printf("POP    H"); break;
-		case 0xe2: printf("JPO    $%02x%02x",code[2],code[1]); opbytes = 3; break;
-		case 0xe3: printf("XTHL");break;
-		case 0xe4: printf("CPO    $%02x%02x",code[2],code[1]); opbytes = 3; break;
-		case 0xe5: printf("PUSH   H"); break;
-		case 0xe6: printf("ANI    #$%02x",code[1]); opbytes = 2; break;
-		case 0xe7: printf("RST    4"); break;
-		case 0xe8: printf("RPE"); break;
-		case 0xe9: printf("PCHL");break;
-		case 0xea: printf("JPE    $%02x%02x",code[2],code[1]); opbytes = 3; break;
-		case 0xeb: printf("XCHG"); break;
-		case 0xec: printf("CPE     $%02x%02x",code[2],code[1]); opbytes = 3; break;
-		case 0xed: printf("CALL   $%02x%02x",code[2],code[1]); opbytes = 3; break;
-		case 0xee: printf("XRI    #$%02x",code[1]); opbytes = 2; break;
-		case 0xef: printf("RST    5"); break;
-
-		case 0xf0: printf("RP");  break;
-		case 0xf1: printf("POP    PSW"); break;
-		case 0xf2: printf("JP     $%02x%02x",code[2],code[1]); opbytes = 3; break;
-		case 0xf3: printf("DI");  break;
-		case 0xf4: printf("CP     $%02x%02x",code[2],code[1]); opbytes = 3; break;
-		case 0xf5: printf("PUSH   PSW"); break;
-		case 0xf6: printf("ORI    #$%02x",code[1]); opbytes = 2; break;
-		case 0xf7: printf("RST    6"); break;
-		case 0xf8: printf("RM");  break;
-		case 0xf9: printf("SPHL");break;
-		case 0xfa: printf("JM     $%02x%02x",code[2],code[1]); opbytes = 3; break;
-		case 0xfb: printf("EI");  break;
-		case 0xfc: printf("CM     $%02x%02x",code[2],code[1]); opbytes = 3; break;
-		case 0xfd: printf("CALL   $%02x%02x",code[2],code[1]); opbytes = 3; break;
-		case 0xfe: printf("CPI    #$%02x",code[1]); opbytes = 2; break;
-		case 0xff: printf("RST    7"); break;
+		if (used == capacity)
+		{
+			flush();
+		}
+		size_t chunk = capacity - used < n ? capacity - used : n;
+		memcpy(buffer + used, data, chunk);
+		used += chunk;
+		data += chunk;
+		n -= chunk;
 	}
-	
-	return opbytes;
 }
 
-int main(int argc, char** argv)
+bool output_buffer::flush()
 {
-    std::ifstream file(argv[1], std::ios::binary | std::ios::ate); 
-    if (!file.is_open()){
-        return 1; 
-    }
-
-    std:: streamsize fsize = file.tellg(); 
-    file.seekg(0, std::ios::beg); 
-
-    std::vector<unsigned char> buffer (fsize); 
-    if (!file.read((char*) buffer.data(), fsize))
-    {
-        file.close(); 
-        return 1; 
-    }
-    file.close(); 
-    int pc = 0; 
-    while (pc < fsize)
-    {
-        pc += Disassemble8080Op(buffer.data(), pc); 
-    }
-    return 0; 
+	size_t offset = 0;
+	while (offset < used && !error)
+	{
+		ssize_t count = ::write(fd, buffer + offset, used - offset);
+		if (count < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			error = true;
+			break;
+		}
+		offset += count;
+	}
+	used = 0;
+	return !error;
 }
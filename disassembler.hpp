@@ -0,0 +1,59 @@
+#ifndef DISASSEMBLER_H
+#define DISASSEMBLER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// longest line disassemble_op can write, including the address and the newline
+const size_t max_line_length = 40;
+
+// length in bytes of every opcode, including its operands
+extern const uint8_t opcode_lengths[256];
+
+// writes the listing line for the instruction at code[pc] into out, labelled with address origin + pc.
+// returns the number of characters written and stores the instruction length in opbytes.
+// never reads past code + size, a truncated instruction at the end is listed as a DB byte
+size_t disassemble_op(const uint8_t* code, size_t size, size_t pc, size_t origin, char* out, int* opbytes);
+
+// disassembles from code[*pc] into out until the input runs out or the next line might not fit in out_size.
+// *pc is advanced past the last instruction written, returns the number of characters written
+size_t disassemble(const uint8_t* code, size_t size, size_t* pc, size_t origin, char* out, size_t out_size);
+
+// mnemonic text for opcode, without operands. length receives the number of characters
+const char* opcode_text(uint8_t opcode, size_t* length);
+
+// writes val as digits lowercase hex characters
+void write_hex(char* out, size_t val, int digits);
+
+// large write buffer in front of a file descriptor, used for listing output
+class output_buffer
+{
+public:
+    output_buffer(int fd, size_t capacity = 1 << 20);
+    ~output_buffer();
+
+    // returns space for at least n characters, flushing first if the buffer is too full
+    char* reserve(size_t n);
+    // marks n characters of the last reserve as written
+    void commit(size_t n) { used += n; }
+    // free space left before the next flush
+    size_t available() const { return capacity - used; }
+
+    void write(const char* data, size_t n);
+    bool flush();
+    bool failed() const { return error; }
+
+private:
+    int fd;
+    char* buffer;
+    size_t capacity;
+    size_t used;
+    bool error;
+};
+
+struct coverage_marks;
+
+// linear sweep listing of the whole image, with marks each line is prefixed like write_listing does
+void write_linear_listing(const uint8_t* code, size_t size, size_t origin, output_buffer& out, const coverage_marks* marks = nullptr);
+
+#endif
@@ -0,0 +1,174 @@
+#include "batch.hpp"
+#include "coverage.hpp"
+#include "disassembler.hpp"
+#include "flow.hpp"
+#include "mapped_file.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <chrono>
+
+static void usage()
+{
+    fprintf(stderr,
+        "usage: disassembler [-o origin] [-f] [-e entry]... [-c coverage] file\n"
+        "  -o origin  load address of the image in hex\n"
+        "  -f         follow control flow from the reset and interrupt vectors instead of a linear sweep\n"
+        "  -e entry   extra entry point in hex for -f, can be repeated\n"
+        "  -c file    mark every line with what the run recorded in a .cov file did there:\n"
+        "             + ran, - never ran, ! listed as data but ran as code\n"
+        "       disassembler --batch [-j jobs] [-d dir] [-s summary] [-o origin] [-l] [-e entry]... path...\n"
+        "  --batch    analyze every image and directory given in parallel, json summary on stdout.\n"
+        "             a .set manifest is one image with every file it lists at its base, -o places the rest\n"
+        "  -j jobs    worker threads, defaults to the number of cores\n"
+        "  -d dir     write a listing per image into dir\n"
+        "  -s file    write the summary to file instead of stdout\n"
+        "  -l         linear sweep instead of following control flow\n");
+}
+
+static int run_batch_mode(int argc, char** argv)
+{
+    batch_options options;
+    options.entry_points = flow_graph::default_entry_points();
+    const char* summary_name = nullptr;
+    std::vector<std::string> paths;
+
+    for (int i = 2; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+        {
+            options.jobs = strtoul(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc)
+        {
+            options.output_dir = argv[++i];
+        }
+        else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+        {
+            summary_name = argv[++i];
+        }
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+        {
+            options.origin = strtoul(argv[++i], nullptr, 16);
+        }
+        else if (strcmp(argv[i], "-e") == 0 && i + 1 < argc)
+        {
+            options.entry_points.push_back(strtoul(argv[++i], nullptr, 16));
+        }
+        else if (strcmp(argv[i], "-l") == 0)
+        {
+            options.follow_flow = false;
+        }
+        else
+        {
+            paths.push_back(argv[i]);
+        }
+    }
+    if (paths.empty())
+    {
+        usage();
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<batch_result> results = run_batch(collect_images(paths, options.origin), options);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    FILE* summary = summary_name ? fopen(summary_name, "w") : stdout;
+    if (!summary)
+    {
+        return 1;
+    }
+    write_summary(results, seconds, summary);
+    if (summary != stdout)
+    {
+        fclose(summary);
+    }
+
+    for (const batch_result& result : results)
+    {
+        if (!result.ok)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc > 1 && strcmp(argv[1], "--batch") == 0)
+    {
+        return run_batch_mode(argc, argv);
+    }
+
+    size_t origin = 0;
+    bool follow_flow = false;
+    std::vector<uint16_t> entry_points = flow_graph::default_entry_points();
+    const char* file_name = nullptr;
+    const char* coverage_name = nullptr;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+        {
+            origin = strtoul(argv[++i], nullptr, 16);
+        }
+        else if (strcmp(argv[i], "-f") == 0)
+        {
+            follow_flow = true;
+        }
+        else if (strcmp(argv[i], "-e") == 0 && i + 1 < argc)
+        {
+            entry_points.push_back(strtoul(argv[++i], nullptr, 16));
+        }
+        else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc)
+        {
+            coverage_name = argv[++i];
+        }
+        else if (!file_name)
+        {
+            file_name = argv[i];
+        }
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+    if (!file_name)
+    {
+        usage();
+        return 1;
+    }
+
+    static coverage_marks marks;
+    if (coverage_name && !load_coverage(coverage_name, &marks))
+    {
+        fprintf(stderr, "cannot read %s\n", coverage_name);
+        return 1;
+    }
+
+    mapped_file file;
+    if (!map_file(file_name, &file))
+    {
+        return 1;
+    }
+
+    output_buffer out(STDOUT_FILENO);
+    if (follow_flow)
+    {
+        flow_graph graph;
+        graph.analyze(file.data, file.size, origin, entry_points);
+        write_listing(graph, file.data, out, coverage_name ? &marks : nullptr);
+    }
+    else
+    {
+        write_linear_listing(file.data, file.size, origin, out, coverage_name ? &marks : nullptr);
+    }
+    bool ok = out.flush();
+
+    unmap_file(&file);
+    return ok ? 0 : 1;
+}
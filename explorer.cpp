@@ -0,0 +1,434 @@
+#include "explorer.hpp"
+#include "cpu.cpp"
+#include "state_hash.hpp"
+#include "state_set.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+// a forked machine keeps running past a fault, the search drops it at the end of its step
+typedef basic_i8080<fault_observer> explore_cpu;
+
+// space invaders keeps player 1's points as four bcd digits at $20f8 (low) and $20f9, the aliens left in
+// the rack at $2082, the racks cleared at $21fe, the credits at $20eb and whether a game runs at $20ef
+static uint32_t bcd(uint8_t value)
+{
+    return (value >> 4) * 10 + (value & 0x0f);
+}
+
+static double score_points(const uint8_t* ram, uint32_t)
+{
+    return bcd(ram[0xf9]) * 100 + bcd(ram[0xf8]);
+}
+
+static double score_progress(const uint8_t* ram, uint32_t depth)
+{
+    int shot = 55 - std::min<int>(ram[0x82], 55);
+    // nothing is shot before a coin and a start, these lead the search to the game
+    double started = ram[0xef] ? 0.5 : ram[0xeb] ? 0.25 : 0;
+    return ram[0x1fe] * 100.0 + shot + started + score_points(ram, depth) / 1000000.0;
+}
+
+static double score_breadth(const uint8_t*, uint32_t depth)
+{
+    return 0.0 - depth;
+}
+
+static double score_depth(const uint8_t*, uint32_t depth)
+{
+    return depth;
+}
+
+const named_score explore_scores[] = {
+    {"progress", score_progress, "racks cleared, then aliens shot, a game started, points (space invaders)"},
+    {"points", score_points, "player 1's points (space invaders)"},
+    {"breadth", score_breadth, "the states fewest steps from the boot first"},
+    {"depth", score_depth, "the states most steps from the boot first"},
+    {nullptr, nullptr, nullptr},
+};
+
+explore_score find_explore_score(const char* name)
+{
+    for (const named_score* named = explore_scores; named->name; ++named)
+    {
+        if (strcmp(named->name, name) == 0)
+        {
+            return named->score;
+        }
+    }
+    return nullptr;
+}
+
+// port 1 for every action: nothing, left, right, fire, left and fire, right and fire, coin and 1p start.
+// bit 3 is wired high, see input.cpp for the rest
+static const uint8_t actions[] = {0x08, 0x28, 0x48, 0x18, 0x38, 0x58, 0x09, 0x0c};
+static const int action_count = sizeof(actions) / sizeof(actions[0]);
+
+// a state waiting to be forked. only ram and the registers are kept, the rom is the same in all of them
+struct explore_node
+{
+    machine_registers registers;
+    // $2000 through the byte at $4000 that write_byte lets through
+    uint8_t ram[0x2001];
+    // for the hasher of every fork, so a fork only hashes the pages it wrote
+    uint64_t pages[state_hasher::ram_pages];
+    uint32_t depth;
+    uint32_t step;
+};
+
+// how every state was reached, the action taken from the parent's state. step 0 is the boot
+struct explore_step
+{
+    uint32_t parent;
+    uint8_t action;
+};
+
+// a worker's candidates by score. the owner takes its best and so does a thief, the lock is only held
+// to move a node in or out, never while a machine runs
+struct explore_queue
+{
+    std::mutex lock;
+    std::multimap<double, std::unique_ptr<explore_node>> nodes;
+};
+
+struct explore_state
+{
+    explicit explore_state(uint64_t max_states)
+        : seen(max_states), steps(new explore_step[max_states])
+    {
+    }
+
+    const explore_options* options;
+    const explore_cpu* root;
+    unsigned jobs;
+    std::unique_ptr<explore_queue[]> queues;
+
+    state_set seen;
+    std::unique_ptr<explore_step[]> steps;
+    std::atomic<uint64_t> step_count{0};
+    // nodes queued or being forked, the search is over when it drops to 0
+    std::atomic<uint64_t> pending{0};
+    std::atomic<bool> running{true};
+
+    std::atomic<uint64_t> forks{0};
+    std::atomic<uint64_t> duplicates{0};
+    std::atomic<uint64_t> faults{0};
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<uint64_t> steals{0};
+
+    std::mutex lock;
+    double best_score = 0;
+    uint32_t best_step = 0;
+    uint32_t best_depth = 0;
+    double fork_seconds = 0;
+    double run_seconds = 0;
+    double hash_seconds = 0;
+};
+
+static std::unique_ptr<explore_node> take(explore_queue& queue)
+{
+    std::lock_guard<std::mutex> guard(queue.lock);
+    if (queue.nodes.empty())
+    {
+        return nullptr;
+    }
+    auto best = std::prev(queue.nodes.end());
+    std::unique_ptr<explore_node> node = std::move(best->second);
+    queue.nodes.erase(best);
+    return node;
+}
+
+static void put(explore_state* state, explore_queue& queue, double score, std::unique_ptr<explore_node> node)
+{
+    std::lock_guard<std::mutex> guard(queue.lock);
+    queue.nodes.emplace(score, std::move(node));
+    if (queue.nodes.size() > state->options->frontier)
+    {
+        queue.nodes.erase(queue.nodes.begin());
+        state->dropped.fetch_add(1, std::memory_order_relaxed);
+        state->pending.fetch_sub(1, std::memory_order_relaxed);
+    }
+}
+
+// xorshift, one sequence per worker
+static uint64_t next_random(uint64_t* random)
+{
+    *random ^= *random << 13;
+    *random ^= *random >> 7;
+    *random ^= *random << 17;
+    return *random;
+}
+
+// the worker's own best, else the best of the first other worker that has any, starting at a random one
+static std::unique_ptr<explore_node> next_node(explore_state* state, unsigned id, uint64_t* random)
+{
+    std::unique_ptr<explore_node> node = take(state->queues[id]);
+    if (node || state->jobs == 1)
+    {
+        return node;
+    }
+    uint64_t start = next_random(random);
+    for (unsigned i = 0; i < state->jobs - 1; ++i)
+    {
+        unsigned victim = (id + 1 + (start + i) % (state->jobs - 1)) % state->jobs;
+        if ((node = take(state->queues[victim])))
+        {
+            state->steals.fetch_add(1, std::memory_order_relaxed);
+            return node;
+        }
+    }
+    return nullptr;
+}
+
+// a new state, recorded and queued. false when the step table is full, which ends the search
+static bool keep(explore_state* state, unsigned id, explore_cpu& cpu, const state_hasher& hasher,
+                 const explore_node& parent, int action, uint64_t* random)
+{
+    uint64_t step = state->step_count.fetch_add(1, std::memory_order_relaxed);
+    if (step >= state->options->max_states)
+    {
+        return false;
+    }
+    state->steps[step] = {parent.step, (uint8_t)action};
+
+    std::unique_ptr<explore_node> node(new explore_node);
+    cpu.save_registers(&node->registers);
+    memcpy(node->ram, cpu.ram(), sizeof(node->ram));
+    memcpy(node->pages, hasher.pages(), sizeof(node->pages));
+    node->depth = parent.depth + 1;
+    node->step = step;
+    double score = state->options->score(node->ram, node->depth);
+    {
+        std::lock_guard<std::mutex> guard(state->lock);
+        if (score > state->best_score)
+        {
+            state->best_score = score;
+            state->best_step = step;
+            state->best_depth = node->depth;
+        }
+    }
+    state->pending.fetch_add(1, std::memory_order_relaxed);
+    // equal scores are taken in a random order, last in first would keep repeating the last action
+    put(state, state->queues[id], score + (next_random(random) >> 11) * 0x1p-53 * 1e-9, std::move(node));
+    return true;
+}
+
+static double since(std::chrono::steady_clock::time_point* last)
+{
+    auto now = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(now - *last).count();
+    *last = now;
+    return seconds;
+}
+
+static void explore_worker(explore_state* state, unsigned id)
+{
+    const explore_options& options = *state->options;
+    // base holds the state being forked, every fork is a restore from it that copies only the pages the
+    // fork before wrote
+    std::unique_ptr<explore_cpu> base(new explore_cpu(*state->root));
+    std::unique_ptr<explore_cpu> cpu(new explore_cpu(*state->root));
+    state_hasher hasher;
+    uint64_t random = 0x9e3779b97f4a7c15ull * (id + 1);
+    double fork_seconds = 0, run_seconds = 0, hash_seconds = 0;
+
+    while (state->running.load(std::memory_order_relaxed))
+    {
+        std::unique_ptr<explore_node> node = next_node(state, id, &random);
+        if (!node)
+        {
+            if (state->pending.load() == 0)
+            {
+                state->running = false;
+            }
+            std::this_thread::yield();
+            continue;
+        }
+
+        auto last = std::chrono::steady_clock::now();
+        memcpy(base->ram(), node->ram, sizeof(node->ram));
+        base->load_registers(node->registers);
+        base->dirty_pages = 0;
+        cpu->dirty_pages = (1ull << 33) - 1;
+        cpu->restore(*base);
+        fork_seconds += since(&last);
+
+        bool room = true;
+        for (int action = 0; action < action_count && room; ++action)
+        {
+            cpu->in_port[1] = actions[action];
+            cpu->observer.fault.clear();
+            for (uint32_t half = 0; half < options.step_frames * 2; ++half)
+            {
+                cpu->run_half_frame();
+            }
+            run_seconds += since(&last);
+
+            if (cpu->observer.faulted(*cpu))
+            {
+                state->faults.fetch_add(1, std::memory_order_relaxed);
+            }
+            else
+            {
+                hasher.set_pages(node->pages);
+                if (!state->seen.insert(hasher.hash(cpu.get(), cpu->dirty_pages).timeless))
+                {
+                    state->duplicates.fetch_add(1, std::memory_order_relaxed);
+                }
+                else
+                {
+                    room = keep(state, id, *cpu, hasher, *node, action, &random);
+                }
+            }
+            hash_seconds += since(&last);
+
+            cpu->restore(*base);
+            fork_seconds += since(&last);
+        }
+        state->forks.fetch_add(action_count, std::memory_order_relaxed);
+        // after the children are queued, so pending only reaches 0 when nothing is left anywhere
+        state->pending.fetch_sub(1);
+        if (!room)
+        {
+            state->running = false;
+        }
+    }
+
+    std::lock_guard<std::mutex> guard(state->lock);
+    state->fork_seconds += fork_seconds;
+    state->run_seconds += run_seconds;
+    state->hash_seconds += hash_seconds;
+}
+
+// the fuzzer's input format, two bytes per frame, so fuzzer -b with the same boot frames -r replays it
+static bool write_path(const explore_state& state, const char* file_name)
+{
+    std::vector<uint8_t> path;
+    for (uint32_t step = state.best_step; step != 0; step = state.steps[step].parent)
+    {
+        path.push_back(actions[state.steps[step].action]);
+    }
+    std::reverse(path.begin(), path.end());
+
+    FILE* out = fopen(file_name, "wb");
+    if (!out)
+    {
+        return false;
+    }
+    bool ok = true;
+    for (uint8_t port1 : path)
+    {
+        uint8_t frame[2] = {port1, state.root->in_port[2]};
+        for (uint32_t i = 0; i < state.options->step_frames; ++i)
+        {
+            ok = ok && fwrite(frame, sizeof(frame), 1, out) == 1;
+        }
+    }
+    return fclose(out) == 0 && ok;
+}
+
+bool run_explorer(const char* rom_name, const explore_options& options, explore_stats* stats)
+{
+    std::unique_ptr<explore_cpu> root(new explore_cpu);
+    std::string error;
+    if (!root->load_rom_or_set(rom_name, &error))
+    {
+        fprintf(stderr, "explorer: %s\n", error.c_str());
+        return false;
+    }
+    for (uint32_t i = 0; i < options.boot_frames * 2; ++i)
+    {
+        root->run_half_frame();
+        if (root->observer.faulted(*root))
+        {
+            fprintf(stderr, "explorer: %s in frame %u of the boot, before any input\n", root->observer.fault.c_str(), i / 2);
+            return false;
+        }
+    }
+
+    std::unique_ptr<explore_state> state(new explore_state(std::max<uint64_t>(options.max_states, 1)));
+    state->options = &options;
+    state->root = root.get();
+    state->jobs = options.jobs ? options.jobs : std::max(1u, std::thread::hardware_concurrency());
+    state->queues.reset(new explore_queue[state->jobs]);
+
+    // the boot is step 0 and the first node, in the first worker's queue for the others to steal from
+    state_hasher hasher;
+    std::unique_ptr<explore_node> node(new explore_node);
+    root->save_registers(&node->registers);
+    memcpy(node->ram, root->ram(), sizeof(node->ram));
+    state->seen.insert(hasher.hash(root.get(), ~0ull).timeless);
+    memcpy(node->pages, hasher.pages(), sizeof(node->pages));
+    node->depth = 0;
+    node->step = 0;
+    state->steps[0] = {0, 0};
+    state->step_count = 1;
+    state->best_score = options.score(node->ram, 0);
+    state->pending = 1;
+    put(state.get(), state->queues[0], state->best_score, std::move(node));
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (unsigned i = 0; i < state->jobs; ++i)
+    {
+        workers.emplace_back(explore_worker, state.get(), i);
+    }
+
+    double seconds = 0;
+    double reported = 0;
+    uint64_t last_states = 1;
+    while (state->running && (options.seconds == 0 || seconds < options.seconds))
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (seconds - reported < 1)
+        {
+            continue;
+        }
+        uint64_t states = std::min<uint64_t>(state->step_count, options.max_states);
+        double best;
+        uint32_t depth;
+        {
+            std::lock_guard<std::mutex> guard(state->lock);
+            best = state->best_score;
+            depth = state->best_depth;
+        }
+        fprintf(stderr, "%6.0f s  %10llu states  %8.0f/s  %10llu forks  %8llu frontier  best %.4g at depth %u\n",
+                seconds, (unsigned long long)states, (states - last_states) / (seconds - reported),
+                (unsigned long long)state->forks.load(), (unsigned long long)state->pending.load(), best, depth);
+        last_states = states;
+        reported = seconds;
+    }
+
+    state->running = false;
+    for (std::thread& worker : workers)
+    {
+        worker.join();
+    }
+    stats->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    stats->states = std::min<uint64_t>(state->step_count, options.max_states);
+    stats->forks = state->forks;
+    stats->duplicates = state->duplicates;
+    stats->faults = state->faults;
+    stats->dropped = state->dropped;
+    stats->steals = state->steals;
+    stats->best_score = state->best_score;
+    stats->best_depth = state->best_depth;
+    stats->fork_seconds = state->fork_seconds;
+    stats->run_seconds = state->run_seconds;
+    stats->hash_seconds = state->hash_seconds;
+
+    if (!options.output.empty() && !write_path(*state, options.output.c_str()))
+    {
+        fprintf(stderr, "explorer: cannot write %s\n", options.output.c_str());
+        return false;
+    }
+    return true;
+}
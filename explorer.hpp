@@ -0,0 +1,64 @@
+#ifndef EXPLORER_H
+#define EXPLORER_H
+
+#include <stdint.h>
+#include <string>
+
+// how promising a state is, higher is explored first. ram is the 8K at $2000, depth the steps from the
+// boot. called once for every new state, from every worker at once
+typedef double (*explore_score)(const uint8_t* ram, uint32_t depth);
+
+// the scores explorer_main offers by name
+struct named_score
+{
+    const char* name;
+    explore_score score;
+    const char* about;
+};
+extern const named_score explore_scores[];
+// null if there is no score called name
+explore_score find_explore_score(const char* name);
+
+struct explore_options
+{
+    unsigned jobs = 0; // 0 uses every core
+    // frames the rom runs with no input before the search starts
+    uint32_t boot_frames = 120;
+    // frames every action is held for, one step of the search
+    uint32_t step_frames = 4;
+    // 0 runs until the frontier runs dry or the state set is full
+    double seconds = 60;
+    // distinct states the set can hold, the search stops when it is full
+    uint64_t max_states = 1 << 20;
+    // candidates each worker keeps, the lowest scored are dropped past this
+    size_t frontier = 2048;
+    explore_score score = nullptr;
+    // the inputs reaching the best state, as a fuzzer input file, nothing is written when empty
+    std::string output;
+};
+
+struct explore_stats
+{
+    // distinct states found, and forks run from a state with one action
+    uint64_t states = 0;
+    uint64_t forks = 0;
+    uint64_t duplicates = 0;
+    uint64_t faults = 0;
+    uint64_t dropped = 0;
+    uint64_t steals = 0;
+    double best_score = 0;
+    uint32_t best_depth = 0;
+    double seconds = 0;
+    // summed over the workers, per fork
+    double fork_seconds = 0;
+    double run_seconds = 0;
+    double hash_seconds = 0;
+};
+
+// boots the rom, then searches from there on every core: a worker takes its best scored state, forks it
+// once for every action, runs each fork step_frames frames, and keeps the forks whose state no worker
+// has reached before. a worker with nothing left steals from the others. progress goes to stderr once a
+// second. returns false, with the reason on stderr, if the rom cannot be loaded or faults in the boot
+bool run_explorer(const char* rom_name, const explore_options& options, explore_stats* stats);
+
+#endif
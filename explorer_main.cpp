@@ -0,0 +1,110 @@
+#include "explorer.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// g++ -O2 -pthread explorer_main.cpp explorer.cpp state_hash.cpp framebuffer.cpp mapped_file.cpp rom_set.cpp -o explorer
+// ./explorer -t 600 -o best.input invaders.set
+// ./fuzzer -r best.input invaders.set
+static void usage()
+{
+    fprintf(stderr,
+        "usage: explorer [-j jobs] [-t seconds] [-b frames] [-f frames] [-n states] [-q nodes] [-s score]\n"
+        "                [-o input] rom\n"
+        "  -j jobs    worker threads, defaults to the number of cores\n"
+        "  -t seconds stop after this long, 0 runs until the search runs dry, 60 by default\n"
+        "  -b frames  frames to run with no input before the search starts, 120 by default\n"
+        "  -f frames  frames every action is held for, 4 by default\n"
+        "  -n states  distinct states to find at most, 1048576 by default\n"
+        "  -q nodes   states each worker keeps queued, the lowest scored are dropped, 2048 by default\n"
+        "  -o input   write the inputs reaching the best state, two bytes per frame like the fuzzer's\n"
+        "  -s score   what the search goes for, progress by default:\n");
+    for (const named_score* named = explore_scores; named->name; ++named)
+    {
+        fprintf(stderr, "             %-9s %s\n", named->name, named->about);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    explore_options options;
+    options.score = find_explore_score("progress");
+    const char* rom_name = nullptr;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+        {
+            options.jobs = strtoul(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+        {
+            options.seconds = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc)
+        {
+            options.boot_frames = strtoul(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc)
+        {
+            options.step_frames = strtoul(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+        {
+            options.max_states = strtoull(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "-q") == 0 && i + 1 < argc)
+        {
+            options.frontier = strtoul(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+        {
+            if (!(options.score = find_explore_score(argv[++i])))
+            {
+                fprintf(stderr, "explorer: no score called %s\n", argv[i]);
+                usage();
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+        {
+            options.output = argv[++i];
+        }
+        else if (!rom_name)
+        {
+            rom_name = argv[i];
+        }
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+    if (!rom_name || options.step_frames == 0 || options.max_states == 0 || options.frontier == 0)
+    {
+        usage();
+        return 1;
+    }
+
+    explore_stats stats;
+    if (!run_explorer(rom_name, options, &stats))
+    {
+        return 1;
+    }
+    double forks = stats.forks ? (double)stats.forks : 1;
+    fprintf(stderr, "%llu states in %.1f s, %.0f states/s, %llu forks, %.0f forks/s\n",
+            (unsigned long long)stats.states, stats.seconds, stats.states / stats.seconds,
+            (unsigned long long)stats.forks, stats.forks / stats.seconds);
+    fprintf(stderr, "%llu duplicates, %llu faults, %llu dropped from full queues, %llu steals\n",
+            (unsigned long long)stats.duplicates, (unsigned long long)stats.faults,
+            (unsigned long long)stats.dropped, (unsigned long long)stats.steals);
+    fprintf(stderr, "per fork: %.2f us forking, %.2f us running, %.2f us hashing\n",
+            stats.fork_seconds / forks * 1e6, stats.run_seconds / forks * 1e6, stats.hash_seconds / forks * 1e6);
+    fprintf(stderr, "best score %.4g at depth %u\n", stats.best_score, stats.best_depth);
+    if (!options.output.empty())
+    {
+        fprintf(stderr, "wrote the path there to %s, replay it with fuzzer -b %u -r %s\n", options.output.c_str(),
+                options.boot_frames, options.output.c_str());
+    }
+    return 0;
+}
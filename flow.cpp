@@ -0,0 +1,402 @@
+#include "flow.hpp"
+#include "coverage.hpp"
+#include "disassembler.hpp"
+#include <algorithm>
+#include <string.h>
+
+flow_kind classify_flow(uint8_t opcode)
+{
+    switch (opcode)
+    {
+    case 0xc3: case 0xcb:
+        return flow_jump;
+    case 0xc2: case 0xca: case 0xd2: case 0xda: case 0xe2: case 0xea: case 0xf2: case 0xfa:
+        return flow_branch;
+    case 0xcd: case 0xdd: case 0xed: case 0xfd:
+        return flow_call;
+    case 0xc4: case 0xcc: case 0xd4: case 0xdc: case 0xe4: case 0xec: case 0xf4: case 0xfc:
+        return flow_conditional_call;
+    case 0xc9: case 0xd9:
+        return flow_return;
+    case 0xc0: case 0xc8: case 0xd0: case 0xd8: case 0xe0: case 0xe8: case 0xf0: case 0xf8:
+        return flow_conditional_return;
+    case 0xc7: case 0xcf: case 0xd7: case 0xdf: case 0xe7: case 0xef: case 0xf7: case 0xff:
+        return flow_restart;
+    case 0xe9:
+        return flow_indirect;
+    case 0x76:
+        return flow_halt;
+    default:
+        return flow_none;
+    }
+}
+
+std::vector<uint16_t> flow_graph::default_entry_points()
+{
+    return {0x0000, 0x0008, 0x0010};
+}
+
+const basic_block* flow_graph::block_at(uint16_t address) const
+{
+    auto it = blocks.find(address);
+    return it == blocks.end() ? nullptr : &it->second;
+}
+
+size_t flow_graph::code_bytes() const
+{
+    return byte_kinds.size() - std::count(byte_kinds.begin(), byte_kinds.end(), byte_data);
+}
+
+// control transfer target of the instruction at code[offset], valid for jumps, calls and restarts
+static uint16_t flow_target(const uint8_t* code, size_t offset, flow_kind kind)
+{
+    if (kind == flow_restart)
+    {
+        return code[offset] & 0x38;
+    }
+    return code[offset + 1] | (code[offset + 2] << 8);
+}
+
+void flow_graph::analyze(const uint8_t* code, size_t _size, uint16_t _origin, const std::vector<uint16_t>& _entry_points)
+{
+    origin = _origin;
+    size = _size;
+    blocks.clear();
+    call_targets.clear();
+    entry_points.clear();
+    xrefs.clear();
+    byte_kinds.assign(size, byte_data);
+
+    std::unordered_set<uint16_t> leaders;
+    std::vector<uint32_t> work;
+    for (uint16_t entry : _entry_points)
+    {
+        if (in_image(entry))
+        {
+            entry_points.insert(entry);
+            leaders.insert(entry);
+            work.push_back(entry);
+        }
+    }
+
+    // pass 1: follow every path from the entry points and mark which bytes are instructions
+    while (!work.empty())
+    {
+        uint32_t address = work.back();
+        work.pop_back();
+
+        while (in_image(address))
+        {
+            size_t offset = address - origin;
+            if (byte_kinds[offset] != byte_data)
+            {
+                // joined code that has already been decoded
+                leaders.insert(address);
+                break;
+            }
+
+            uint8_t opcode = code[offset];
+            int length = opcode_lengths[opcode];
+            if (offset + length > size)
+            {
+                break;
+            }
+            bool overlaps = false;
+            for (int i = 1; i < length; ++i)
+            {
+                overlaps |= byte_kinds[offset + i] != byte_data;
+            }
+            if (overlaps)
+            {
+                break;
+            }
+
+            byte_kinds[offset] = byte_opcode;
+            for (int i = 1; i < length; ++i)
+            {
+                byte_kinds[offset + i] = byte_operand;
+            }
+
+            flow_kind kind = classify_flow(opcode);
+            uint16_t operand = length == 3 ? code[offset + 1] | (code[offset + 2] << 8) : 0;
+            switch (kind)
+            {
+            case flow_jump:
+            case flow_branch:
+                xrefs[operand].push_back({(uint16_t)address, xref_jump});
+                leaders.insert(operand);
+                work.push_back(operand);
+                break;
+            case flow_call:
+            case flow_conditional_call:
+            case flow_restart:
+            {
+                uint16_t target = flow_target(code, offset, kind);
+                xrefs[target].push_back({(uint16_t)address, xref_call});
+                call_targets.insert(target);
+                leaders.insert(target);
+                work.push_back(target);
+                break;
+            }
+            default:
+                break;
+            }
+
+            switch (opcode)
+            {
+            // lda, lhld
+            case 0x3a: case 0x2a:
+                xrefs[operand].push_back({(uint16_t)address, xref_read});
+                break;
+            // sta, shld
+            case 0x32: case 0x22:
+                xrefs[operand].push_back({(uint16_t)address, xref_write});
+                break;
+            // lxi b, d, h, sp - only interesting when it points back into the image
+            case 0x01: case 0x11: case 0x21: case 0x31:
+                if (in_image(operand))
+                {
+                    xrefs[operand].push_back({(uint16_t)address, xref_pointer});
+                }
+                break;
+            }
+
+            if (ends_flow(kind))
+            {
+                break;
+            }
+            address += length;
+            if (kind != flow_none)
+            {
+                leaders.insert(address);
+            }
+        }
+    }
+
+    // pass 2: cut the decoded instructions into blocks at every leader and control transfer
+    for (uint16_t leader : leaders)
+    {
+        if (!in_image(leader) || byte_kinds[leader - origin] != byte_opcode)
+        {
+            continue;
+        }
+
+        basic_block block;
+        block.start = leader;
+        block.instruction_count = 0;
+        block.exit = flow_none;
+
+        uint32_t address = leader;
+        while (true)
+        {
+            size_t offset = address - origin;
+            uint8_t opcode = code[offset];
+            flow_kind kind = classify_flow(opcode);
+            block.instruction_count++;
+            address += opcode_lengths[opcode];
+
+            if (kind != flow_none)
+            {
+                block.exit = kind;
+                if (!ends_flow(kind) && in_image(address) && byte_kinds[address - origin] == byte_opcode)
+                {
+                    block.successors.push_back(address);
+                }
+                if (kind != flow_return && kind != flow_conditional_return && kind != flow_indirect && kind != flow_halt)
+                {
+                    block.successors.push_back(flow_target(code, offset, kind));
+                }
+                break;
+            }
+            if (!in_image(address) || byte_kinds[address - origin] != byte_opcode)
+            {
+                break;
+            }
+            if (leaders.count(address))
+            {
+                block.successors.push_back(address);
+                break;
+            }
+        }
+        block.end = address;
+        blocks[leader] = block;
+    }
+
+    for (auto& entry : blocks)
+    {
+        for (uint16_t successor : entry.second.successors)
+        {
+            auto it = blocks.find(successor);
+            if (it != blocks.end())
+            {
+                it->second.predecessors.push_back(entry.first);
+            }
+        }
+    }
+
+    for (auto& entry : xrefs)
+    {
+        std::sort(entry.second.begin(), entry.second.end(), [](const xref& l, const xref& r) { return l.from < r.from; });
+    }
+}
+
+// writes the label for address into out and returns its length, 0 if the address has no label
+static size_t label_name(const flow_graph& graph, uint16_t address, char* out)
+{
+    const char* prefix;
+    if (graph.call_targets.count(address))
+    {
+        prefix = "sub_";
+    }
+    else if (graph.entry_points.count(address))
+    {
+        prefix = "entry_";
+    }
+    else
+    {
+        auto it = graph.xrefs.find(address);
+        if (it == graph.xrefs.end() || !graph.in_image(address))
+        {
+            return 0;
+        }
+        bool data = graph.byte_kinds[address - graph.origin] != byte_opcode;
+        // lxi immediates are often counters that only happen to look like code addresses
+        bool jumped_to = std::any_of(it->second.begin(), it->second.end(), [](const xref& ref) { return ref.kind != xref_pointer; });
+        if (!data && !jumped_to)
+        {
+            return 0;
+        }
+        prefix = data ? "dat_" : "loc_";
+    }
+    size_t n = strlen(prefix);
+    memcpy(out, prefix, n);
+    write_hex(out + n, address, 4);
+    return n + 4;
+}
+
+static void write_label_line(const flow_graph& graph, uint16_t address, output_buffer& out)
+{
+    static const char* kind_names[] = {"jump", "call", "read", "write", "ptr"};
+    const size_t max_listed = 6;
+
+    char line[256];
+    size_t n = label_name(graph, address, line);
+    if (n == 0)
+    {
+        return;
+    }
+    line[n++] = ':';
+
+    auto it = graph.xrefs.find(address);
+    if (it != graph.xrefs.end())
+    {
+        while (n < 24)
+        {
+            line[n++] = ' ';
+        }
+        line[n++] = ';';
+        const std::vector<xref>& refs = it->second;
+        for (size_t i = 0; i < refs.size() && i < max_listed; ++i)
+        {
+            line[n++] = ' ';
+            write_hex(line + n, refs[i].from, 4);
+            n += 4;
+            line[n++] = ' ';
+            size_t length = strlen(kind_names[refs[i].kind]);
+            memcpy(line + n, kind_names[refs[i].kind], length);
+            n += length;
+        }
+        if (refs.size() > max_listed)
+        {
+            memcpy(line + n, " ...", 4);
+            n += 4;
+        }
+    }
+    line[n++] = '\n';
+    out.write(line, n);
+}
+
+void write_listing(const flow_graph& graph, const uint8_t* code, output_buffer& out, const coverage_marks* marks)
+{
+    size_t offset = 0;
+    bool after_exit = false;
+    while (offset < graph.size)
+    {
+        uint16_t address = graph.origin + offset;
+        uint8_t kind = graph.byte_kinds[offset];
+
+        if (graph.block_at(address) && after_exit)
+        {
+            out.write("\n", 1);
+        }
+        write_label_line(graph, address, out);
+
+        if (kind == byte_opcode)
+        {
+            uint8_t opcode = code[offset];
+            flow_kind flow = classify_flow(opcode);
+            if (marks)
+            {
+                out.write(coverage_prefix(*marks, address, 1, true), 2);
+            }
+            char* line = out.reserve(max_line_length + 16);
+            size_t n;
+            int opbytes = opcode_lengths[opcode];
+
+            char label[16];
+            size_t label_length = 0;
+            if (flow == flow_jump || flow == flow_branch || flow == flow_call || flow == flow_conditional_call)
+            {
+                label_length = label_name(graph, flow_target(code, offset, flow), label);
+            }
+
+            if (label_length > 0)
+            {
+                // branch operands are printed as the label of the target
+                size_t text_length;
+                const char* text = opcode_text(opcode, &text_length);
+                write_hex(line, address, 4);
+                line[4] = ' ';
+                memcpy(line + 5, text, text_length);
+                memcpy(line + 5 + text_length, label, label_length);
+                n = 5 + text_length + label_length;
+                line[n++] = '\n';
+            }
+            else
+            {
+                n = disassemble_op(code, graph.size, offset, graph.origin, line, &opbytes);
+            }
+            out.commit(n);
+            offset += opbytes;
+            after_exit = ends_flow(flow);
+            continue;
+        }
+
+        // data rows of up to 8 bytes, broken at anything that needs its own label
+        char line[80];
+        write_hex(line, address, 4);
+        memcpy(line + 4, " DB     ", 8);
+        size_t n = 12;
+        size_t count = 0;
+        do
+        {
+            if (count > 0)
+            {
+                line[n++] = ',';
+            }
+            line[n++] = '$';
+            write_hex(line + n, code[offset], 2);
+            n += 2;
+            ++offset;
+            ++count;
+        } while (count < 8 && offset < graph.size && graph.byte_kinds[offset] == byte_data &&
+                 !graph.xrefs.count(graph.origin + offset));
+        line[n++] = '\n';
+        if (marks)
+        {
+            out.write(coverage_prefix(*marks, address, count, false), 2);
+        }
+        out.write(line, n);
+        after_exit = true;
+    }
+}
@@ -0,0 +1,105 @@
+#ifndef FLOW_H
+#define FLOW_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+class output_buffer;
+struct coverage_marks;
+
+// how an instruction affects control flow
+enum flow_kind : uint8_t
+{
+    flow_none,
+    flow_jump,               // jmp
+    flow_branch,             // conditional jump
+    flow_call,               // call
+    flow_conditional_call,   // cnz, cz ...
+    flow_return,             // ret
+    flow_conditional_return, // rnz, rz ...
+    flow_restart,            // rst n
+    flow_indirect,           // pchl, target unknown until run time
+    flow_halt,               // hlt, resumes after the next interrupt
+};
+
+flow_kind classify_flow(uint8_t opcode);
+
+// true when execution never falls through to the next instruction
+inline bool ends_flow(flow_kind kind)
+{
+    return kind == flow_jump || kind == flow_return || kind == flow_indirect;
+}
+
+// what each byte of the image was decoded as
+enum byte_kind : uint8_t
+{
+    byte_data,
+    byte_opcode,
+    byte_operand,
+};
+
+enum xref_kind : uint8_t
+{
+    xref_jump,
+    xref_call,
+    xref_read,    // lda, lhld
+    xref_write,   // sta, shld
+    xref_pointer, // lxi immediate that lands inside the image
+};
+
+struct xref
+{
+    uint16_t from;
+    xref_kind kind;
+};
+
+// straight line run of instructions with a single entry at start.
+// a block ends at the first control transfer or where another block begins
+struct basic_block
+{
+    uint16_t start;
+    uint32_t end; // one past the last byte, can be 0x10000
+    uint16_t instruction_count;
+    flow_kind exit;
+    // blocks control can reach from the end of this one, fall through first
+    std::vector<uint16_t> successors;
+    std::vector<uint16_t> predecessors;
+};
+
+// recursive descent decode of a rom image. only bytes reachable from the entry points
+// are treated as code, everything else stays data
+class flow_graph
+{
+public:
+    // interrupt vectors used by the invaders board: reset, rst 1 (mid screen) and rst 2 (end of screen)
+    static std::vector<uint16_t> default_entry_points();
+
+    // code[0] is loaded at origin, entry points are absolute addresses
+    void analyze(const uint8_t* code, size_t size, uint16_t origin, const std::vector<uint16_t>& entry_points);
+
+    // block starting exactly at address, or nullptr
+    const basic_block* block_at(uint16_t address) const;
+
+    bool in_image(uint32_t address) const { return address >= origin && address < origin + size; }
+    size_t code_bytes() const;
+
+    uint16_t origin = 0;
+    size_t size = 0;
+
+    std::unordered_map<uint16_t, basic_block> blocks;
+    std::unordered_set<uint16_t> call_targets;
+    std::unordered_set<uint16_t> entry_points;
+    // every reference to an address, keyed by the address referenced
+    std::unordered_map<uint16_t, std::vector<xref>> xrefs;
+    // indexed by offset into the image
+    std::vector<uint8_t> byte_kinds;
+};
+
+// labelled listing of the whole image, code as instructions and everything else as DB rows.
+// with marks, every instruction and data row is prefixed with what a recorded run did there
+void write_listing(const flow_graph& graph, const uint8_t* code, output_buffer& out, const coverage_marks* marks = nullptr);
+
+#endif
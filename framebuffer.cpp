@@ -0,0 +1,191 @@
+#include "framebuffer.hpp"
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+/*
+vram layout:
+    byte column * 32 + j holds the pixels of vram column `column` from y = 8j to 8j + 7,
+    least significant bit first, with y = 0 at the bottom of the rotated screen.
+    so bit b of that byte lands on screen row 255 - (8j + b), screen column `column`.
+
+the vector converters work on blocks of 16 columns by 16 bytes. a 16x16 byte transpose turns
+the columns into rows, so bit b of the 16 bytes in a row are 16 horizontally adjacent pixels
+and every store is a contiguous run of an output row instead of a pixel scattered by the rotation.
+*/
+
+void convert_frame_scalar(const uint8_t* vram, uint16_t* pixels, uint16_t on, uint16_t off)
+{
+    uint16_t diff = on ^ off;
+    for (int column = 0; column < screen_width; ++column)
+    {
+        const uint8_t* source = vram + column * (screen_height / 8);
+        for (int j = 0; j < screen_height / 8; ++j)
+        {
+            uint8_t vram_byte = source[j];
+            uint16_t* out = pixels + (screen_height - 1 - 8 * j) * screen_width + column;
+            for (int bit = 0; bit < 8; ++bit)
+            {
+                uint16_t mask = -(uint16_t)((vram_byte >> bit) & 1);
+                *out = off ^ (diff & mask);
+                out -= screen_width;
+            }
+        }
+    }
+}
+
+// byte n of bytes[v] is 0xff when bit n of v is set
+struct expand_table
+{
+    uint64_t bytes[256];
+
+    expand_table()
+    {
+        for (int v = 0; v < 256; ++v)
+        {
+            bytes[v] = 0;
+            for (int bit = 0; bit < 8; ++bit)
+            {
+                if (v & (1 << bit))
+                {
+                    bytes[v] |= (uint64_t)0xff << (bit * 8);
+                }
+            }
+        }
+    }
+};
+
+void expand_frame_8bpp(const uint8_t* vram, uint8_t* pixels, int pitch, uint8_t on, uint8_t off)
+{
+    static const expand_table table;
+    const uint64_t off_bytes = off * 0x0101010101010101ull;
+    const uint64_t diff_bytes = (uint8_t)(on ^ off) * 0x0101010101010101ull;
+
+    for (int row = 0; row < screen_width; ++row)
+    {
+        const uint8_t* source = vram + row * (screen_height / 8);
+        uint8_t* out = pixels + row * pitch;
+        for (int j = 0; j < screen_height / 8; ++j)
+        {
+            // little endian store puts bit 0 in the leftmost pixel
+            uint64_t bytes = off_bytes ^ (table.bytes[source[j]] & diff_bytes);
+            memcpy(out + j * 8, &bytes, 8);
+        }
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+// 16x16 byte transpose, four rounds of byte interleaving
+static inline void transpose16(__m128i* rows)
+{
+    __m128i next[16];
+    for (int round = 0; round < 4; ++round)
+    {
+        for (int i = 0; i < 8; ++i)
+        {
+            next[2 * i] = _mm_unpacklo_epi8(rows[i], rows[i + 8]);
+            next[2 * i + 1] = _mm_unpackhi_epi8(rows[i], rows[i + 8]);
+        }
+        for (int i = 0; i < 16; ++i)
+        {
+            rows[i] = next[i];
+        }
+    }
+}
+
+// loads vram bytes j0..j0+15 of 16 columns and transposes them, so rows[j] holds byte j0 + j of every column
+static inline void load_block(const uint8_t* vram, int column, int j0, __m128i* rows)
+{
+    for (int k = 0; k < 16; ++k)
+    {
+        rows[k] = _mm_loadu_si128((const __m128i*)(vram + (column + k) * (screen_height / 8) + j0));
+    }
+    transpose16(rows);
+}
+
+void convert_frame_sse2(const uint8_t* vram, uint16_t* pixels, uint16_t on, uint16_t off)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i off_pixels = _mm_set1_epi16(off);
+    const __m128i diff = _mm_set1_epi16(on ^ off);
+
+    __m128i rows[16];
+    for (int column = 0; column < screen_width; column += 16)
+    {
+        for (int j0 = 0; j0 < screen_height / 8; j0 += 16)
+        {
+            load_block(vram, column, j0, rows);
+            for (int j = 0; j < 16; ++j)
+            {
+                // one 16 bit lane per column, each bit plane is then a shift away from a full lane mask
+                __m128i low = _mm_unpacklo_epi8(rows[j], zero);
+                __m128i high = _mm_unpackhi_epi8(rows[j], zero);
+                uint16_t* out = pixels + (screen_height - 1 - 8 * (j0 + j)) * screen_width + column;
+                for (int b = 0; b < 8; ++b)
+                {
+                    __m128i shift = _mm_cvtsi32_si128(15 - b);
+                    __m128i low_mask = _mm_sra_epi16(_mm_sll_epi16(low, shift), _mm_cvtsi32_si128(15));
+                    __m128i high_mask = _mm_sra_epi16(_mm_sll_epi16(high, shift), _mm_cvtsi32_si128(15));
+                    _mm_storeu_si128((__m128i*)out, _mm_xor_si128(off_pixels, _mm_and_si128(low_mask, diff)));
+                    _mm_storeu_si128((__m128i*)(out + 8), _mm_xor_si128(off_pixels, _mm_and_si128(high_mask, diff)));
+                    out -= screen_width;
+                }
+            }
+        }
+    }
+}
+
+// same blocking as sse2, but all 16 pixels of a bit plane come out of one 256 bit register
+__attribute__((target("avx2")))
+void convert_frame_avx2(const uint8_t* vram, uint16_t* pixels, uint16_t on, uint16_t off)
+{
+    const __m256i off_pixels = _mm256_set1_epi16(off);
+    const __m256i diff = _mm256_set1_epi16(on ^ off);
+
+    __m128i rows[16];
+    for (int column = 0; column < screen_width; column += 16)
+    {
+        for (int j0 = 0; j0 < screen_height / 8; j0 += 16)
+        {
+            load_block(vram, column, j0, rows);
+            for (int j = 0; j < 16; ++j)
+            {
+                __m256i lanes = _mm256_cvtepu8_epi16(rows[j]);
+                uint16_t* out = pixels + (screen_height - 1 - 8 * (j0 + j)) * screen_width + column;
+                for (int b = 0; b < 8; ++b)
+                {
+                    __m256i mask = _mm256_srai_epi16(_mm256_sll_epi16(lanes, _mm_cvtsi32_si128(15 - b)), 15);
+                    _mm256_storeu_si256((__m256i*)out, _mm256_xor_si256(off_pixels, _mm256_and_si256(mask, diff)));
+                    out -= screen_width;
+                }
+            }
+        }
+    }
+}
+
+bool cpu_has_avx2()
+{
+    return __builtin_cpu_supports("avx2");
+}
+
+#endif
+
+void convert_frame(const uint8_t* vram, uint16_t* pixels, uint16_t on, uint16_t off)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    static const bool avx2 = cpu_has_avx2();
+    if (avx2)
+    {
+        convert_frame_avx2(vram, pixels, on, off);
+    }
+    else
+    {
+        convert_frame_sse2(vram, pixels, on, off);
+    }
+#else
+    convert_frame_scalar(vram, pixels, on, off);
+#endif
+}
@@ -0,0 +1,29 @@
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include <stdint.h>
+
+// the monitor is mounted rotated in the cabinet, so the 256x224 vram is shown as 224 wide and 256 tall
+const int screen_width = 224;
+const int screen_height = 256;
+// 1 bit per pixel, 32 bytes per vram column
+const int vram_size = screen_width * screen_height / 8;
+
+// expands the packed 1bpp vram into screen_width x screen_height pixels, rotated 90 degrees
+// counter clockwise, using the fastest converter the cpu supports. on and off are the pixel
+// values for set and clear bits, pixels is row major with the top row first
+void convert_frame(const uint8_t* vram, uint16_t* pixels, uint16_t on = 0xffff, uint16_t off = 0x0000);
+
+// expands vram to one byte per pixel without rotating it, 256 wide and 224 tall with vram column n as row n.
+// used by the indexed presentation path, which leaves the rotation to the renderer
+void expand_frame_8bpp(const uint8_t* vram, uint8_t* pixels, int pitch, uint8_t on = 0xff, uint8_t off = 0x00);
+
+// individual converters, exposed for benchmarking
+void convert_frame_scalar(const uint8_t* vram, uint16_t* pixels, uint16_t on, uint16_t off);
+#if defined(__x86_64__) || defined(__i386__)
+void convert_frame_sse2(const uint8_t* vram, uint16_t* pixels, uint16_t on, uint16_t off);
+void convert_frame_avx2(const uint8_t* vram, uint16_t* pixels, uint16_t on, uint16_t off);
+bool cpu_has_avx2();
+#endif
+
+#endif
@@ -0,0 +1,77 @@
+#include "framebuffer.hpp"
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// standalone benchmark for the vram converters, every converter is checked against the scalar one first
+typedef void (*converter)(const uint8_t*, uint16_t*, uint16_t, uint16_t);
+
+static uint16_t reference[screen_width * screen_height];
+static uint16_t pixels[screen_width * screen_height];
+
+static bool bench(const char* name, converter convert, const uint8_t* vram, int frames)
+{
+    memset(pixels, 0x55, sizeof(pixels));
+    convert(vram, pixels, 0xffff, 0xf000);
+    if (memcmp(pixels, reference, sizeof(pixels)) != 0)
+    {
+        printf("%-8s output differs from scalar\n", name);
+        return false;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < frames; ++i)
+    {
+        convert(vram, pixels, 0xffff, 0xf000);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("%-8s %8.3f us/frame\n", name, seconds * 1e6 / frames);
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    int frames = argc > 1 ? atoi(argv[1]) : 20000;
+
+    uint8_t vram[vram_size];
+    srand(8080);
+    for (int i = 0; i < vram_size; ++i)
+    {
+        vram[i] = rand();
+    }
+    convert_frame_scalar(vram, reference, 0xffff, 0xf000);
+
+    bool ok = bench("scalar", convert_frame_scalar, vram, frames);
+#if defined(__x86_64__) || defined(__i386__)
+    ok &= bench("sse2", convert_frame_sse2, vram, frames);
+    if (cpu_has_avx2())
+    {
+        ok &= bench("avx2", convert_frame_avx2, vram, frames);
+    }
+#endif
+
+    // indexed path: unrotated, one byte per pixel
+    static uint8_t indexed[screen_width * screen_height];
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < frames; ++i)
+    {
+        expand_frame_8bpp(vram, indexed, screen_height);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("%-8s %8.3f us/frame\n", "8bpp", seconds * 1e6 / frames);
+    for (int row = 0; row < screen_height && ok; ++row)
+    {
+        for (int column = 0; column < screen_width; ++column)
+        {
+            bool lit = reference[row * screen_width + column] == 0xffff;
+            if (lit != (indexed[column * screen_height + (screen_height - 1 - row)] == 0xff))
+            {
+                printf("8bpp     output differs from scalar\n");
+                ok = false;
+                break;
+            }
+        }
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,364 @@
+#include "fuzzer.hpp"
+#include "cpu.cpp"
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <thread>
+
+typedef basic_i8080<fuzz_observer> fuzz_cpu;
+
+void fuzz_observer::reset()
+{
+    memset(edges, 0, sizeof(edges));
+    fault.clear();
+    last_pc = 0;
+    expected_pc = 0;
+}
+
+bool read_input(const char* file_name, fuzz_input* input)
+{
+    FILE* in = fopen(file_name, "rb");
+    if (!in)
+    {
+        return false;
+    }
+    input->clear();
+    uint8_t bytes[2];
+    while (fread(bytes, 1, 2, in) == 2)
+    {
+        input->push_back({bytes[0], bytes[1]});
+    }
+    fclose(in);
+    return !input->empty();
+}
+
+bool write_input(const char* file_name, const fuzz_input& input)
+{
+    FILE* out = fopen(file_name, "wb");
+    if (!out)
+    {
+        return false;
+    }
+    bool ok = fwrite(input.data(), sizeof(fuzz_frame), input.size(), out) == input.size();
+    return fclose(out) == 0 && ok;
+}
+
+// loads the rom and runs it with the controls released up to the snapshot. a rom that faults before
+// then would fault the same way in every execution, so that is an error too
+static std::unique_ptr<fuzz_cpu> boot(const char* rom_name, const fuzz_options& options)
+{
+    std::unique_ptr<fuzz_cpu> cpu(new fuzz_cpu);
+    std::string error;
+    if (!cpu->load_rom_or_set(rom_name, &error))
+    {
+        fprintf(stderr, "fuzzer: %s\n", error.c_str());
+        return nullptr;
+    }
+    cpu->observer.reset();
+    for (uint32_t i = 0; i < options.boot_frames * 2; ++i)
+    {
+        cpu->run_half_frame();
+        if (cpu->observer.faulted(*cpu))
+        {
+            fprintf(stderr, "fuzzer: %s in frame %u of the boot, before any input\n", cpu->observer.fault.c_str(), i / 2);
+            return nullptr;
+        }
+    }
+    cpu->dirty_pages = 0;
+    return cpu;
+}
+
+// returns the number of frames run, stopping early at a fault
+static uint64_t execute(fuzz_cpu& cpu, const fuzz_cpu& snapshot, const fuzz_input& input)
+{
+    cpu.restore(snapshot);
+    cpu.observer.reset();
+    for (size_t i = 0; i < input.size(); ++i)
+    {
+        cpu.in_port[1] = input[i].port1;
+        cpu.in_port[2] = input[i].port2;
+        for (int half = 0; half < 2; ++half)
+        {
+            cpu.run_half_frame();
+            if (cpu.observer.faulted(cpu))
+            {
+                return i + 1;
+            }
+        }
+    }
+    return input.size();
+}
+
+static uint64_t next_random(uint64_t* state)
+{
+    // xorshift64*
+    uint64_t x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return x * 0x2545f4914f6cdd1dull;
+}
+
+// a few random edits stacked on top of each other. controls tend to be held for several frames,
+// so most edits work on runs of frames rather than single bytes
+static void mutate(fuzz_input* input, const fuzz_input& other, uint32_t max_frames, uint64_t* random)
+{
+    int edits = 1 + next_random(random) % 6;
+    for (int i = 0; i < edits; ++i)
+    {
+        size_t size = input->size();
+        size_t at = next_random(random) % size;
+        size_t length = 1 + next_random(random) % std::min<size_t>(size - at, 32);
+        uint8_t* port = next_random(random) & 1 ? &(*input)[at].port2 : &(*input)[at].port1;
+        switch (next_random(random) % 6)
+        {
+        case 0:
+            *port ^= 1 << (next_random(random) % 8);
+            break;
+        case 1:
+            *port = next_random(random);
+            break;
+        case 2:
+        {
+            // hold one bit over a run of frames
+            uint8_t bit = 1 << (next_random(random) % 8);
+            bool set = next_random(random) & 1;
+            bool second = next_random(random) & 1;
+            for (size_t j = at; j < at + length; ++j)
+            {
+                uint8_t& value = second ? (*input)[j].port2 : (*input)[j].port1;
+                value = set ? value | bit : value & ~bit;
+            }
+            break;
+        }
+        case 3:
+            // repeat a run
+            if (size + length <= max_frames)
+            {
+                fuzz_input run(input->begin() + at, input->begin() + at + length);
+                input->insert(input->begin() + at, run.begin(), run.end());
+            }
+            break;
+        case 4:
+            if (length < size)
+            {
+                input->erase(input->begin() + at, input->begin() + at + length);
+            }
+            break;
+        case 5:
+        {
+            // splice the tail of another input
+            size_t from = next_random(random) % other.size();
+            input->resize(at);
+            input->insert(input->end(), other.begin() + from, other.end());
+            if (input->size() > max_frames)
+            {
+                input->resize(max_frames);
+            }
+            if (input->empty())
+            {
+                input->push_back(other[0]);
+            }
+            break;
+        }
+        }
+    }
+}
+
+struct fuzz_state
+{
+    const fuzz_cpu* snapshot;
+    const fuzz_options* options;
+
+    // every edge any input has reached, workers claim new ones with fetch_or
+    std::atomic<uint64_t> seen[1024];
+    std::atomic<size_t> edges;
+    std::atomic<uint64_t> executions;
+    std::atomic<uint64_t> frames;
+    std::atomic<bool> running;
+
+    std::mutex lock;
+    std::vector<fuzz_input> corpus;
+    std::set<std::string> faults;
+};
+
+// merges the edges of the last run into seen, returns how many no earlier run reached
+static size_t claim_edges(fuzz_state& state, const uint64_t* edges)
+{
+    size_t fresh = 0;
+    for (int i = 0; i < 1024; ++i)
+    {
+        if (edges[i] == 0 || (state.seen[i].load(std::memory_order_relaxed) & edges[i]) == edges[i])
+        {
+            continue;
+        }
+        uint64_t before = state.seen[i].fetch_or(edges[i], std::memory_order_relaxed);
+        fresh += __builtin_popcountll(edges[i] & ~before);
+    }
+    return fresh;
+}
+
+static void fuzz_worker(fuzz_state* state, unsigned id)
+{
+    const fuzz_options& options = *state->options;
+    std::unique_ptr<fuzz_cpu> cpu(new fuzz_cpu(*state->snapshot));
+    uint64_t random = options.seed * 0x9e3779b97f4a7c15ull + id + 1;
+    uint64_t executions = 0;
+    uint64_t frames = 0;
+
+    fuzz_input input;
+    fuzz_input other;
+    while (state->running.load(std::memory_order_relaxed))
+    {
+        {
+            std::lock_guard<std::mutex> guard(state->lock);
+            input = state->corpus[next_random(&random) % state->corpus.size()];
+            other = state->corpus[next_random(&random) % state->corpus.size()];
+        }
+        mutate(&input, other, options.max_frames, &random);
+
+        frames += execute(*cpu, *state->snapshot, input);
+        // published in batches, the counters are shared by every worker
+        if (++executions % 16 == 0)
+        {
+            state->executions.fetch_add(16, std::memory_order_relaxed);
+            state->frames.fetch_add(frames, std::memory_order_relaxed);
+            frames = 0;
+        }
+
+        size_t fresh = claim_edges(*state, cpu->observer.edges);
+        const std::string& fault = cpu->observer.fault;
+        if (fresh == 0 && fault.empty())
+        {
+            continue;
+        }
+        state->edges.fetch_add(fresh, std::memory_order_relaxed);
+
+        std::lock_guard<std::mutex> guard(state->lock);
+        char name[64];
+        if (fresh)
+        {
+            state->corpus.push_back(input);
+            snprintf(name, sizeof(name), "/input-%06zu", state->corpus.size() - 1);
+            if (!options.output_dir.empty())
+            {
+                write_input((options.output_dir + name).c_str(), input);
+            }
+        }
+        // one reproducer per distinct fault
+        if (!fault.empty() && state->faults.insert(fault).second)
+        {
+            snprintf(name, sizeof(name), "/crash-%03zu", state->faults.size() - 1);
+            fprintf(stderr, "fuzzer: %s, %zu frames", fault.c_str(), input.size());
+            if (!options.output_dir.empty())
+            {
+                write_input((options.output_dir + name).c_str(), input);
+                fprintf(stderr, ", written to %s%s", options.output_dir.c_str(), name);
+            }
+            fprintf(stderr, "\n");
+        }
+    }
+    state->executions.fetch_add(executions % 16, std::memory_order_relaxed);
+    state->frames.fetch_add(frames, std::memory_order_relaxed);
+}
+
+bool run_fuzzer(const char* rom_name, const std::vector<fuzz_input>& seeds, const fuzz_options& options, fuzz_stats* stats)
+{
+    std::unique_ptr<fuzz_cpu> snapshot = boot(rom_name, options);
+    if (!snapshot)
+    {
+        return false;
+    }
+    if (!options.output_dir.empty())
+    {
+        mkdir(options.output_dir.c_str(), 0755);
+    }
+
+    std::unique_ptr<fuzz_state> state(new fuzz_state);
+    state->snapshot = snapshot.get();
+    state->options = &options;
+    for (std::atomic<uint64_t>& word : state->seen)
+    {
+        word = 0;
+    }
+    state->edges = 0;
+    state->executions = 0;
+    state->frames = 0;
+    state->running = true;
+    for (const fuzz_input& seed : seeds)
+    {
+        if (!seed.empty())
+        {
+            state->corpus.push_back(seed.size() > options.max_frames ? fuzz_input(seed.begin(), seed.begin() + options.max_frames) : seed);
+        }
+    }
+    if (state->corpus.empty())
+    {
+        // a second of released controls, port 1 bit 3 is wired high on the board
+        state->corpus.push_back(fuzz_input(std::min<uint32_t>(60, options.max_frames), fuzz_frame{0x08, 0x00}));
+    }
+
+    unsigned jobs = options.jobs ? options.jobs : std::max(1u, std::thread::hardware_concurrency());
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (unsigned i = 0; i < jobs; ++i)
+    {
+        workers.emplace_back(fuzz_worker, state.get(), i);
+    }
+
+    double seconds = 0;
+    uint64_t last_executions = 0;
+    while (options.seconds == 0 || seconds < options.seconds)
+    {
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        uint64_t executions = state->executions.load(std::memory_order_relaxed);
+        size_t corpus, crashes;
+        {
+            std::lock_guard<std::mutex> guard(state->lock);
+            corpus = state->corpus.size();
+            crashes = state->faults.size();
+        }
+        fprintf(stderr, "%6.0f s  %10llu execs  %8llu/s  %6zu edges  %5zu inputs  %3zu crashes\n",
+                seconds, (unsigned long long)executions, (unsigned long long)(executions - last_executions),
+                state->edges.load(std::memory_order_relaxed), corpus, crashes);
+        last_executions = executions;
+    }
+
+    state->running = false;
+    for (std::thread& worker : workers)
+    {
+        worker.join();
+    }
+    stats->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    stats->executions = state->executions;
+    stats->frames = state->frames;
+    stats->edges = state->edges;
+    stats->corpus = state->corpus.size();
+    stats->crashes = state->faults.size();
+    return true;
+}
+
+bool replay_input(const char* rom_name, const fuzz_input& input, const fuzz_options& options, std::string* fault, size_t* edges)
+{
+    std::unique_ptr<fuzz_cpu> snapshot = boot(rom_name, options);
+    if (!snapshot)
+    {
+        return false;
+    }
+    std::unique_ptr<fuzz_cpu> cpu(new fuzz_cpu(*snapshot));
+    execute(*cpu, *snapshot, input);
+    *fault = cpu->observer.fault;
+    *edges = 0;
+    for (uint64_t word : cpu->observer.edges)
+    {
+        *edges += __builtin_popcountll(word);
+    }
+    return true;
+}
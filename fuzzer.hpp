@@ -0,0 +1,84 @@
+#ifndef FUZZER_H
+#define FUZZER_H
+
+#include "disassembler.hpp"
+#include "observer.hpp"
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// player controls for one frame, the values the game reads from ports 1 and 2
+struct fuzz_frame
+{
+    uint8_t port1;
+    uint8_t port2;
+};
+
+// stored on disk as two bytes per frame, port 1 first
+typedef std::vector<fuzz_frame> fuzz_input;
+
+// control flow edges and faults of one run, attach it as the observer of basic_i8080<fuzz_observer>.
+// an edge is a jump from one instruction to another that is not its fall through, hashed into a 64K bit map
+class fuzz_observer : public fault_observer
+{
+public:
+    bool needs_every_instruction() const { return true; }
+
+    void on_instruction(uint16_t pc, uint8_t opcode)
+    {
+        if (pc != expected_pc)
+        {
+            uint16_t edge = (uint16_t)((last_pc * 0x9e3779b1u) >> 16) ^ pc;
+            edges[edge >> 6] |= 1ull << (edge & 63);
+        }
+        last_pc = pc;
+        expected_pc = pc + opcode_lengths[opcode];
+    }
+    // clears the edges and the fault for the next run
+    void reset();
+
+    uint64_t edges[1024];
+
+private:
+    uint16_t last_pc = 0;
+    uint32_t expected_pc = 0;
+};
+
+struct fuzz_options
+{
+    unsigned jobs = 0; // 0 uses every core
+    // frames the rom runs with no input before the snapshot every execution starts from
+    uint32_t boot_frames = 120;
+    // longest input in frames
+    uint32_t max_frames = 600;
+    // 0 runs until killed
+    double seconds = 60;
+    uint64_t seed = 1;
+    // inputs that reached new edges and crash reproducers are written here, nothing is written when empty
+    std::string output_dir;
+};
+
+struct fuzz_stats
+{
+    uint64_t executions = 0;
+    uint64_t frames = 0;
+    size_t edges = 0;
+    size_t corpus = 0;
+    size_t crashes = 0;
+    double seconds = 0;
+};
+
+bool read_input(const char* file_name, fuzz_input* input);
+bool write_input(const char* file_name, const fuzz_input& input);
+
+// boots the rom, then mutates inputs on every core and keeps the ones that reach edges no earlier input
+// reached. every execution starts from the boot snapshot, restored one dirty ram page at a time.
+// progress goes to stderr once a second. returns false, with the reason on stderr, if the rom cannot be
+// loaded or faults before the snapshot
+bool run_fuzzer(const char* rom_name, const std::vector<fuzz_input>& seeds, const fuzz_options& options, fuzz_stats* stats);
+
+// runs one input from the boot snapshot, fault receives why it failed or stays empty.
+// returns false like run_fuzzer
+bool replay_input(const char* rom_name, const fuzz_input& input, const fuzz_options& options, std::string* fault, size_t* edges);
+
+#endif
@@ -0,0 +1,115 @@
+#include "fuzzer.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// g++ -O2 -pthread fuzzer_main.cpp fuzzer.cpp disassembler.cpp mapped_file.cpp rom_set.cpp -o fuzzer
+// ./fuzzer -o findings -t 600 invaders.set
+// ./fuzzer -r findings/crash-000 invaders.set
+static void usage()
+{
+    fprintf(stderr,
+        "usage: fuzzer [-j jobs] [-t seconds] [-b frames] [-m frames] [-s seed] [-o dir] rom [input]...\n"
+        "  -j jobs    worker threads, defaults to the number of cores\n"
+        "  -t seconds stop after this long, 0 runs until killed, 60 by default\n"
+        "  -b frames  frames to run before the snapshot every execution starts from, 120 by default\n"
+        "  -m frames  longest input, 600 by default\n"
+        "  -s seed    random seed\n"
+        "  -o dir     write inputs reaching new edges and crash reproducers into dir\n"
+        "  input      seed inputs, two bytes per frame for ports 1 and 2\n"
+        "       fuzzer [-b frames] -r input rom\n"
+        "  -r input   run one input, a crash reproducer for example, and report the fault\n");
+}
+
+int main(int argc, char** argv)
+{
+    fuzz_options options;
+    const char* rom_name = nullptr;
+    const char* replay_name = nullptr;
+    std::vector<const char*> seed_names;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+        {
+            options.jobs = strtoul(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+        {
+            options.seconds = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc)
+        {
+            options.boot_frames = strtoul(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc)
+        {
+            options.max_frames = strtoul(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+        {
+            options.seed = strtoull(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+        {
+            options.output_dir = argv[++i];
+        }
+        else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+        {
+            replay_name = argv[++i];
+        }
+        else if (!rom_name)
+        {
+            rom_name = argv[i];
+        }
+        else
+        {
+            seed_names.push_back(argv[i]);
+        }
+    }
+    if (!rom_name || options.max_frames == 0)
+    {
+        usage();
+        return 1;
+    }
+
+    if (replay_name)
+    {
+        fuzz_input input;
+        if (!read_input(replay_name, &input))
+        {
+            fprintf(stderr, "fuzzer: cannot read %s\n", replay_name);
+            return 1;
+        }
+        std::string fault;
+        size_t edges;
+        if (!replay_input(rom_name, input, options, &fault, &edges))
+        {
+            return 1;
+        }
+        fprintf(stderr, "%zu frames, %zu edges, %s\n", input.size(), edges, fault.empty() ? "no fault" : fault.c_str());
+        return fault.empty() ? 0 : 2;
+    }
+
+    std::vector<fuzz_input> seeds;
+    for (const char* name : seed_names)
+    {
+        fuzz_input input;
+        if (!read_input(name, &input))
+        {
+            fprintf(stderr, "fuzzer: cannot read %s\n", name);
+            return 1;
+        }
+        seeds.push_back(input);
+    }
+
+    fuzz_stats stats;
+    if (!run_fuzzer(rom_name, seeds, options, &stats))
+    {
+        return 1;
+    }
+    fprintf(stderr, "%llu executions in %.1f s, %.0f execs/s, %.0f frames/s, %zu edges, %zu inputs, %zu crashes\n",
+            (unsigned long long)stats.executions, stats.seconds, stats.executions / stats.seconds,
+            stats.frames / stats.seconds, stats.edges, stats.corpus, stats.crashes);
+    return stats.crashes ? 2 : 0;
+}
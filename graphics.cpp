@@ -1,36 +1,82 @@
 #include "graphics.hpp"
+#include "framebuffer.hpp"
 
-Graphics::Graphics(const char* _title, u_int16_t _width, u_int16_t _height, u_int16_t _pixel_size); 
+Graphics::Graphics(const char* _title, u_int16_t _width, u_int16_t _height, u_int16_t _pixel_size, present_mode _mode)
 {
+    mode = _mode;
     pixel_size = _pixel_size; 
     width = _width; 
     height = _height; 
 
     main_window = SDL_CreateWindow(_title, SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, _width * _pixel_size, _height * _pixel_size, SDL_WINDOW_SHOWN);
-    main_renderer = SDL_CreateRenderer(main_window, -1, SDL_RENDERER_ACCELERATED); 
-    main_texture - SDL_CreateTexture (main_renderer,SDL_PIXELFORMAT_ARGB4444, SDL_TEXTUREACCESS_STREAMING, _width, _height); 
+    main_renderer = SDL_CreateRenderer(main_window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC); 
+    if (mode == present_indexed)
+    {
+        // unrotated 256x224, one byte per pixel. white in rgb332 is 0xff, so the colour mod tints it exactly
+        main_texture = SDL_CreateTexture(main_renderer, SDL_PIXELFORMAT_RGB332, SDL_TEXTUREACCESS_STREAMING, _height, _width);
+    }
+    else
+    {
+        main_texture = SDL_CreateTexture (main_renderer,SDL_PIXELFORMAT_ARGB4444, SDL_TEXTUREACCESS_STREAMING, _width, _height); 
+    }
 
     SDL_SetRenderDrawColor(main_renderer, 0x00, 0x00, 0x00, 0x00); 
     SDL_RenderClear(main_renderer); 
 
 }
 
-void Graphics::update(uint8_t* vram)
+void Graphics::update(const uint8_t* vram)
 {
-    for (int x = 0; x < _width; ++x)
+    if (mode == present_indexed)
     {
-        for (int y = 0; y < _height; ++y)
-        {
-            uint8_t vram_byte = vram[x * (_height >> 3) + (y >> 3)];
-            for (int bit = 0; bit < 8; bit++)
-            {
-                uint8_t x_coord = x ; 
-                uint8_t y_coord = (_height - 1 - (y + bit)); 
-                pixels[y_coord * _width + x_coord] = 0xffff; 
-            }
-        }
+        update_indexed(vram);
+        return;
     }
-    SDL_UpdateTexture(main_texture, NULL, pixels, 2 * _width); 
+    convert_frame(vram, pixels);
+    SDL_UpdateTexture(main_texture, NULL, pixels, 2 * width); 
     SDL_RenderCopy (main_renderer, main_texture, NULL, NULL); 
     SDL_RenderPresent(main_renderer); 
-}
\ No newline at end of file
+}
+
+// draws screen rows top..bottom and columns left..right of the rotated screen, tinted with the given colour.
+// the texture holds the unrotated vram, so the source is the matching strip and the renderer rotates it
+void Graphics::draw_region(int top, int bottom, int left, int right, uint8_t red, uint8_t green, uint8_t blue)
+{
+    SDL_Rect source = {screen_height - bottom, left, bottom - top, right - left};
+
+    // the copy rotates around the centre of the destination, so centre the unrotated rectangle on the final spot
+    float center_x = (left + right) * 0.5f * pixel_size;
+    float center_y = (top + bottom) * 0.5f * pixel_size;
+    float w = (bottom - top) * pixel_size;
+    float h = (right - left) * pixel_size;
+    SDL_FRect destination = {center_x - w * 0.5f, center_y - h * 0.5f, w, h};
+
+    SDL_SetTextureColorMod(main_texture, red, green, blue);
+    SDL_RenderCopyExF(main_renderer, main_texture, &source, &destination, -90.0, NULL, SDL_FLIP_NONE);
+}
+
+void Graphics::update_indexed(const uint8_t* vram)
+{
+    // 56 KB expanded into the texture's staging memory, which the renderer still uploads whole on unlock. the
+    // argb4444 path converts 112 KB and uploads those, so this halves the bytes written and uploaded per frame.
+    // sdl2 renderers have no 1bpp texture and no shaders, so the 7 KB vram itself cannot be what is uploaded
+    void* texture_pixels;
+    int pitch;
+    if (SDL_LockTexture(main_texture, NULL, &texture_pixels, &pitch) < 0)
+    {
+        return;
+    }
+    expand_frame_8bpp(vram, (uint8_t*)texture_pixels, pitch);
+    SDL_UnlockTexture(main_texture);
+
+    SDL_RenderClear(main_renderer);
+    // cabinet overlay: red strip across the ufo, green over the player and shields and under the reserve bases
+    draw_region(0, 32, 0, screen_width, 0xff, 0xff, 0xff);
+    draw_region(32, 64, 0, screen_width, 0xff, 0x20, 0x20);
+    draw_region(64, 184, 0, screen_width, 0xff, 0xff, 0xff);
+    draw_region(184, 240, 0, screen_width, 0x20, 0xff, 0x20);
+    draw_region(240, screen_height, 0, 16, 0xff, 0xff, 0xff);
+    draw_region(240, screen_height, 16, 134, 0x20, 0xff, 0x20);
+    draw_region(240, screen_height, 134, screen_width, 0xff, 0xff, 0xff);
+    SDL_RenderPresent(main_renderer);
+}
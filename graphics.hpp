@@ -6,12 +6,26 @@
 #ifndef GRAPHICS_H 
 #define GRAPHICS_H
 
+// how frames get to the screen
+enum present_mode
+{
+    // vram is rotated and expanded to ARGB4444 on the cpu, then uploaded
+    present_argb4444,
+    // vram is expanded to one byte per pixel into the locked texture, half the bytes of argb4444.
+    // rotation and the cabinet colour overlay are applied by the renderer while drawing
+    present_indexed,
+};
+
 class Graphics
 {
     public:    
-        Graphics(const char* title, u_int16_t width, u_int16_t height, u_int16_t pixel_size); 
-        void update(uint8_t* vram); 
+        Graphics(const char* title, u_int16_t width, u_int16_t height, u_int16_t pixel_size, present_mode mode = present_argb4444); 
+        void update(const uint8_t* vram); 
     private: 
+        void update_indexed(const uint8_t* vram);
+        void draw_region(int top, int bottom, int left, int right, uint8_t red, uint8_t green, uint8_t blue);
+
+        present_mode mode;
         u_int16_t pixel_size; 
         uint16_t width; 
         u_int16_t height; 
@@ -19,5 +33,5 @@ class Graphics
         SDL_Window* main_window; 
         SDL_Renderer* main_renderer; 
         SDL_Texture* main_texture; 
-}
+};
 #endif
\ No newline at end of file
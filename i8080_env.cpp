@@ -0,0 +1,163 @@
+#include "i8080_env.h"
+#include "cpu.cpp"
+#include "framebuffer.hpp"
+#include "observation.hpp"
+#include <memory>
+#include <stdio.h>
+#include <string>
+
+// a machine keeps running past a fault, so the caller sees a done flag instead of the process exiting
+typedef basic_i8080<fault_observer> env_cpu;
+
+template class basic_i8080<fault_observer>;
+
+struct i8080_envs
+{
+    uint32_t count;
+    // one array, so machine i's memory is i * sizeof(env_cpu) past machine 0's
+    std::unique_ptr<env_cpu[]> machines;
+    std::unique_ptr<env_cpu> snapshot;
+    std::unique_ptr<uint8_t[]> done;
+    std::unique_ptr<uint64_t[]> frames;
+    std::unique_ptr<observation_plan> observation;
+    int stack = 1;
+};
+
+static void set_error(char* error, size_t error_size, const std::string& text)
+{
+    if (error && error_size)
+    {
+        snprintf(error, error_size, "%s", text.c_str());
+    }
+}
+
+i8080_envs* i8080_envs_create(const char* rom, uint32_t count, uint32_t boot_frames, char* error, size_t error_size)
+{
+    if (count == 0)
+    {
+        set_error(error, error_size, "no machines");
+        return nullptr;
+    }
+    std::unique_ptr<i8080_envs> envs(new i8080_envs);
+    envs->count = count;
+    envs->snapshot.reset(new env_cpu);
+
+    env_cpu* boot = envs->snapshot.get();
+    std::string reason;
+    if (!boot->load_rom_or_set(rom, &reason))
+    {
+        set_error(error, error_size, reason);
+        return nullptr;
+    }
+    for (uint32_t i = 0; i < boot_frames * 2; ++i)
+    {
+        boot->run_half_frame();
+        if (boot->observer.faulted(*boot))
+        {
+            set_error(error, error_size, boot->observer.fault + " in frame " + std::to_string(i / 2) + " of the boot");
+            return nullptr;
+        }
+    }
+
+    // every machine starts as a copy of the snapshot, from then on resets only copy the pages it wrote
+    std::unique_ptr<machine_state> state(new machine_state);
+    boot->save_state(state.get());
+    boot->dirty_pages = 0;
+    envs->machines.reset(new env_cpu[count]);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        envs->machines[i].load_state(*state);
+        envs->machines[i].dirty_pages = 0;
+    }
+    envs->done.reset(new uint8_t[count]());
+    envs->frames.reset(new uint64_t[count]());
+    return envs.release();
+}
+
+void i8080_envs_destroy(i8080_envs* envs)
+{
+    delete envs;
+}
+
+uint32_t i8080_envs_count(const i8080_envs* envs)
+{
+    return envs->count;
+}
+
+void i8080_envs_step(i8080_envs* envs, uint32_t first, uint32_t count, const uint8_t* actions)
+{
+    for (uint32_t i = first; i < first + count && i < envs->count; ++i)
+    {
+        env_cpu& cpu = envs->machines[i];
+        if (envs->done[i])
+        {
+            continue;
+        }
+        if (actions)
+        {
+            cpu.in_port[1] = actions[2 * (i - first)];
+            cpu.in_port[2] = actions[2 * (i - first) + 1];
+        }
+        cpu.run_half_frame();
+        cpu.run_half_frame();
+        ++envs->frames[i];
+        envs->done[i] = cpu.observer.faulted(cpu);
+    }
+}
+
+void i8080_envs_reset(i8080_envs* envs, uint32_t index)
+{
+    if (index >= envs->count)
+    {
+        return;
+    }
+    env_cpu& cpu = envs->machines[index];
+    cpu.restore(*envs->snapshot);
+    cpu.observer.fault.clear();
+    envs->done[index] = 0;
+    envs->frames[index] = 0;
+}
+
+const uint8_t* i8080_envs_vram(const i8080_envs* envs, size_t* stride)
+{
+    *stride = sizeof(env_cpu);
+    return envs->machines[0].vram();
+}
+
+const uint8_t* i8080_envs_ram(const i8080_envs* envs, size_t* stride)
+{
+    *stride = sizeof(env_cpu);
+    return envs->machines[0].ram();
+}
+
+const uint8_t* i8080_envs_done(const i8080_envs* envs)
+{
+    return envs->done.get();
+}
+
+const uint64_t* i8080_envs_frames(const i8080_envs* envs)
+{
+    return envs->frames.get();
+}
+
+int i8080_envs_set_observation(i8080_envs* envs, int width, int height, int stack, int mode)
+{
+    if (width < 1 || width > screen_width || height < 1 || height > screen_height || stack < 1 ||
+        (mode != observe_average && mode != observe_any))
+    {
+        return 0;
+    }
+    envs->observation.reset(new observation_plan(width, height, (observation_mode)mode));
+    envs->stack = stack;
+    return 1;
+}
+
+void i8080_envs_observe(const i8080_envs* envs, uint32_t first, uint32_t count, uint8_t* out)
+{
+    if (!envs->observation || first >= envs->count)
+    {
+        return;
+    }
+    count = std::min(count, envs->count - first);
+    envs->observation->observe_batch(envs->machines[first].vram(), sizeof(env_cpu), count, envs->stack, out);
+}
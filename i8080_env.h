@@ -0,0 +1,69 @@
+#ifndef I8080_ENV_H
+#define I8080_ENV_H
+
+/* a c interface for driving many machines at once from other languages, training code for example.
+ * build it as a shared library:
+ * g++ -O2 -shared -fPIC -fvisibility=hidden i8080_env.cpp observation.cpp framebuffer.cpp mapped_file.cpp rom_set.cpp -o libi8080env.so
+ *
+ * the machines live side by side in one block owned by the library. vram, ram and the done flags are
+ * read in place through the views below, nothing is copied between steps. a view stays valid until
+ * i8080_envs_destroy */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#define I8080_ENV_API __declspec(dllexport)
+#else
+#define I8080_ENV_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct i8080_envs i8080_envs;
+
+/* n machines running rom, an image or a .set manifest, each started from one snapshot taken
+ * boot_frames frames after reset. returns null with the reason in error if the rom cannot be loaded
+ * or faults during the boot */
+I8080_ENV_API i8080_envs* i8080_envs_create(const char* rom, uint32_t count, uint32_t boot_frames, char* error, size_t error_size);
+I8080_ENV_API void i8080_envs_destroy(i8080_envs* envs);
+
+I8080_ENV_API uint32_t i8080_envs_count(const i8080_envs* envs);
+
+/* runs machines first to first + count - 1 one frame each. actions holds two bytes per machine, the
+ * values the game reads from ports 1 and 2, starting with machine first. null leaves the ports as
+ * they are. machines that are done are skipped. separate ranges may be stepped from separate threads */
+I8080_ENV_API void i8080_envs_step(i8080_envs* envs, uint32_t first, uint32_t count, const uint8_t* actions);
+
+/* puts machine index back to the boot snapshot and clears its done flag. only the ram pages written
+ * since its last reset are copied */
+I8080_ENV_API void i8080_envs_reset(i8080_envs* envs, uint32_t index);
+
+/* views. the vram of machine i starts at the returned pointer plus i * stride, 7168 bytes of 1bpp
+ * pixels, 32 bytes per vram column, unrotated as in framebuffer.hpp. ram is the 8K at $2000, vram included */
+I8080_ENV_API const uint8_t* i8080_envs_vram(const i8080_envs* envs, size_t* stride);
+I8080_ENV_API const uint8_t* i8080_envs_ram(const i8080_envs* envs, size_t* stride);
+
+/* one byte per machine, set when it faulted, an unimplemented opcode or the stack leaving ram */
+I8080_ENV_API const uint8_t* i8080_envs_done(const i8080_envs* envs);
+
+/* frames run by each machine since its last reset */
+I8080_ENV_API const uint64_t* i8080_envs_frames(const i8080_envs* envs);
+
+/* observations are width x height grayscale frames, upright and downsampled straight from vram, see
+ * observation.hpp. mode 0 averages the pixels under each observed pixel, mode 1 lights it if any of
+ * them is lit. call once before observing, returns 0 if width or height is out of range */
+I8080_ENV_API int i8080_envs_set_observation(i8080_envs* envs, int width, int height, int stack, int mode);
+
+/* writes the observations of machines first to first + count - 1 into out, stack frames of
+ * width * height bytes per machine, oldest first. the frames out already holds move back one and
+ * the new one is written last, so out should be kept between calls */
+I8080_ENV_API void i8080_envs_observe(const i8080_envs* envs, uint32_t first, uint32_t count, uint8_t* out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,106 @@
+/* times the c api the way a training loop drives it: step every machine one frame, then observe them
+ * all, and reports the cost per machine of each call. written in c against i8080_env.h alone, so it
+ * also checks the header stays usable from c.
+ * cc -O2 i8080_env_bench.c -L. -li8080env -o i8080_env_bench
+ * ./i8080_env_bench invaders.set 64 2000 */
+
+#include "i8080_env.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static double now_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1e9 + now.tv_nsec;
+}
+
+/* a cheap generator, the actions only need to keep the machines busy */
+static uint32_t next_random(uint64_t* state)
+{
+    *state = *state * 6364136223846793005ull + 1442695040888963407ull;
+    return (uint32_t)(*state >> 33);
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        fprintf(stderr,
+            "usage: i8080_env_bench rom [machines] [steps] [width height]\n"
+            "  steps every machine a frame and observes it, steps times, 64 machines and 2000 steps by default.\n"
+            "  observations are 84x84 with a stack of 4 unless width and height are given\n");
+        return 1;
+    }
+    const char* rom = argv[1];
+    uint32_t count = argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 10) : 64;
+    uint32_t steps = argc > 3 ? (uint32_t)strtoul(argv[3], NULL, 10) : 2000;
+    int width = argc > 5 ? atoi(argv[4]) : 84;
+    int height = argc > 5 ? atoi(argv[5]) : 84;
+    const int stack = 4;
+
+    char error[256];
+    i8080_envs* envs = i8080_envs_create(rom, count, 120, error, sizeof(error));
+    if (!envs)
+    {
+        fprintf(stderr, "i8080_env_bench: %s\n", error);
+        return 1;
+    }
+    if (!i8080_envs_set_observation(envs, width, height, stack, 0))
+    {
+        fprintf(stderr, "i8080_env_bench: no %dx%d observation\n", width, height);
+        i8080_envs_destroy(envs);
+        return 1;
+    }
+
+    uint8_t* actions = malloc((size_t)count * 2);
+    uint8_t* observations = calloc((size_t)count * stack, (size_t)width * height);
+    if (!actions || !observations)
+    {
+        fprintf(stderr, "i8080_env_bench: out of memory\n");
+        return 1;
+    }
+
+    uint64_t random = 8080;
+    uint64_t resets = 0;
+    double step_ns = 0, observe_ns = 0;
+    const uint8_t* done = i8080_envs_done(envs);
+    for (uint32_t step = 0; step < steps; ++step)
+    {
+        /* port 1 bit 3 is wired high, the rest are coin, starts, fire, left and right */
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            actions[2 * i] = 0x08 | (next_random(&random) & 0x77);
+            actions[2 * i + 1] = 0;
+        }
+
+        double start = now_ns();
+        i8080_envs_step(envs, 0, count, actions);
+        double stepped = now_ns();
+        i8080_envs_observe(envs, 0, count, observations);
+        observe_ns += now_ns() - stepped;
+        step_ns += stepped - start;
+
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            if (done[i])
+            {
+                i8080_envs_reset(envs, i);
+                ++resets;
+            }
+        }
+    }
+
+    double calls = (double)steps * count;
+    printf("%u machines, %u steps, %dx%d observations, %llu resets\n", count, steps, width, height,
+           (unsigned long long)resets);
+    printf("i8080_envs_step     %10.0f ns per machine\n", step_ns / calls);
+    printf("i8080_envs_observe  %10.0f ns per machine\n", observe_ns / calls);
+    printf("%.0f machine frames/s\n", calls * 1e9 / (step_ns + observe_ns));
+
+    free(observations);
+    free(actions);
+    i8080_envs_destroy(envs);
+    return 0;
+}
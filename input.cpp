@@ -0,0 +1,123 @@
+#include "input.hpp"
+#include <chrono>
+#include <fcntl.h>
+#include <linux/input.h>
+#include <poll.h>
+#include <unistd.h>
+
+int64_t input_clock()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// port and bit of every button. port 1 bit 3 is wired high, port 2 holds the dip switches in the rest
+static const struct
+{
+    uint8_t port;
+    uint8_t mask;
+} wiring[button_count] = {
+    {1, 0x01}, // coin
+    {1, 0x04}, // 1p start
+    {1, 0x02}, // 2p start
+    {1, 0x10}, // 1p fire
+    {1, 0x20}, // 1p left
+    {1, 0x40}, // 1p right
+    {2, 0x10}, // 2p fire
+    {2, 0x20}, // 2p left
+    {2, 0x40}, // 2p right
+    {2, 0x04}, // tilt
+};
+
+void input_sampler::apply(uint8_t* ports, const button_event& event)
+{
+    if (event.button >= button_count)
+    {
+        return;
+    }
+    uint8_t& port = ports[wiring[event.button].port];
+    port = event.pressed ? port | wiring[event.button].mask : port & ~wiring[event.button].mask;
+}
+
+void latency_stats::report(FILE* out, const char* name) const
+{
+    if (count == 0)
+    {
+        fprintf(out, "%s: no input\n", name);
+        return;
+    }
+    fprintf(out, "%s: %llu events, mean %.3f ms, worst %.3f ms\n",
+            name, (unsigned long long)count, sum / count / 1e6, max / 1e6);
+}
+
+static int evdev_button(int code)
+{
+    switch (code)
+    {
+    case KEY_C: return button_coin;
+    case KEY_1: return button_p1_start;
+    case KEY_2: return button_p2_start;
+    case KEY_SPACE: return button_p1_fire;
+    case KEY_LEFT: return button_p1_left;
+    case KEY_RIGHT: return button_p1_right;
+    case KEY_W: return button_p2_fire;
+    case KEY_A: return button_p2_left;
+    case KEY_D: return button_p2_right;
+    case KEY_T: return button_tilt;
+    default: return -1;
+    }
+}
+
+bool evdev_input::start(const char* path, input_ring* target)
+{
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return false;
+    }
+    ring = target;
+    running = true;
+    reader = std::thread(&evdev_input::read_events, this);
+    return true;
+}
+
+void evdev_input::stop()
+{
+    if (!reader.joinable())
+    {
+        return;
+    }
+    running = false;
+    reader.join();
+    close(fd);
+    fd = -1;
+}
+
+void evdev_input::read_events()
+{
+    // polled with a timeout so stop never waits on a key press
+    pollfd waiting = {fd, POLLIN, 0};
+    while (running.load(std::memory_order_relaxed))
+    {
+        if (poll(&waiting, 1, 50) <= 0)
+        {
+            continue;
+        }
+        input_event events[16];
+        ssize_t n = read(fd, events, sizeof(events));
+        if (n <= 0)
+        {
+            break;
+        }
+        int64_t now = input_clock();
+        for (size_t i = 0; i < n / sizeof(input_event); ++i)
+        {
+            int id = evdev_button(events[i].code);
+            // value 2 is autorepeat, the button is already down
+            if (events[i].type != EV_KEY || id < 0 || events[i].value > 1)
+            {
+                continue;
+            }
+            ring->push({now, 0, (uint8_t)id, (uint8_t)events[i].value});
+        }
+    }
+}
@@ -0,0 +1,122 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include "spsc_ring.hpp"
+#include <algorithm>
+#include <atomic>
+#include <stdint.h>
+#include <stdio.h>
+#include <thread>
+#include <vector>
+
+// the cabinet controls, wired into in ports 1 and 2
+enum button : uint8_t
+{
+    button_coin,
+    button_p1_start,
+    button_p2_start,
+    button_p1_fire,
+    button_p1_left,
+    button_p1_right,
+    button_p2_fire,
+    button_p2_left,
+    button_p2_right,
+    button_tilt,
+    button_count,
+};
+
+// a button going down or up. time is input_clock when the host saw it, cycle the clock_count it
+// reached the ports at, filled in by input_sampler
+struct button_event
+{
+    int64_t time;
+    uint64_t cycle;
+    uint8_t button;
+    uint8_t pressed;
+};
+
+// monotonic ns, the clock event times and latencies are measured on
+int64_t input_clock();
+
+// one per producing thread, the cpu thread is the only consumer
+typedef spsc_ring<button_event, 256> input_ring;
+
+// keyboard read through evdev on a thread of its own, for runs without a window.
+// the arrows, space, c, 1 and 2 play like the window does
+class evdev_input
+{
+public:
+    ~evdev_input() { stop(); }
+
+    // path is a /dev/input/event* node, returns false if it cannot be opened
+    bool start(const char* path, input_ring* ring);
+    void stop();
+
+private:
+    void read_events();
+
+    int fd = -1;
+    input_ring* ring = nullptr;
+    std::atomic<bool> running{false};
+    std::thread reader;
+};
+
+// ns from one point to another, count, mean and worst
+struct latency_stats
+{
+    uint64_t count = 0;
+    double sum = 0;
+    int64_t max = 0;
+
+    void add(int64_t ns)
+    {
+        ++count;
+        sum += ns;
+        max = std::max(max, ns);
+    }
+    void report(FILE* out, const char* name) const;
+};
+
+// drains the rings into the ports on the cpu thread. called right before the cpu runs on, after the
+// pacer wait, so the game always reads what the player did up to the last moment before it runs
+class input_sampler
+{
+public:
+    void add(input_ring* ring) { rings.push_back(ring); }
+
+    // applies every pending event to in_port, returns the time of the oldest one or 0 if there was none
+    template<typename cpu_type>
+    int64_t sample(cpu_type* cpu)
+    {
+        int64_t oldest = 0;
+        for (input_ring* ring : rings)
+        {
+            button_event event;
+            while (ring->pop(&event))
+            {
+                event.cycle = cpu->clock_count;
+                apply(cpu->in_port, event);
+                if (log)
+                {
+                    log->push_back(event);
+                }
+                to_port.add(input_clock() - event.time);
+                oldest = oldest ? std::min(oldest, event.time) : event.time;
+            }
+        }
+        return oldest;
+    }
+
+    // from the host seeing an event to the ports holding it
+    latency_stats to_port;
+    // every applied event with its cycle, when set, enough to play the session back
+    std::vector<button_event>* log = nullptr;
+
+    // sets or clears the button's bit in ports 1 and 2, for replays too
+    static void apply(uint8_t* ports, const button_event& event);
+
+private:
+    std::vector<input_ring*> rings;
+};
+
+#endif
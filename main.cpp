@@ -1,22 +1,464 @@
 #include "cpu.cpp"
+#include "capture.hpp"
+#include "coverage.hpp"
+#include "debugger.hpp"
 #include "graphics.hpp"
+#include "input.hpp"
+#include "framebuffer.hpp"
+#include "pacer.hpp"
+#include "profile.hpp"
+#include "run_ahead.hpp"
+#include "session.hpp"
+#include "snapshot.hpp"
+#include "sound.hpp"
+#include "state_hash.hpp"
+#include "triple_buffer.hpp"
+#include <atomic>
+#include <chrono>
+#include <string.h>
+#include <thread>
 
-void load_rom(const char* file_name)
+// defined by a rom translated with the recompiler, when its output is linked in
+__attribute__((weak)) void recompiled_run_until(i8080& cpu, uint64_t cycle);
+__attribute__((weak)) bool recompiled_rom_matches(i8080& cpu);
+
+// vram as it was at the end of screen interrupt
+struct frame
+{
+    uint8_t vram[vram_size];
+    uint64_t number;
+    // input_clock time of the oldest input this frame is the first to show, 0 if none
+    int64_t input_time;
+};
+
+struct run_options
 {
-    std::ifstream file(file_name, std::ios::binary | std::ios::ate)
-    std::streampos size = file.tellg(); 
-    size_t memory_size = sizeof(memory) - 0xe0ff; 
+    // multiple of the 2 MHz clock
+    double speed = 1.0;
+    // no pacing at all
+    bool turbo = false;
+    // only every nth frame is handed to the renderer
+    int frame_skip = 1;
+    // no window, run frames as fast as possible and report the rate
+    bool headless = false;
+    uint64_t frames = 600;
+    bool skip_idle_loops = true;
+    bool fuse_instructions = true;
+    // run the recompiled rom linked into this build
+    bool native = false;
+    // headless run on a core with the opcode profile attached
+    bool profile = false;
+    // .cov file written at exit, from a core that records rom coverage and ram page traffic
+    const char* coverage = nullptr;
+    // debugger endpoint, "-", "unix:path" or "tcp:port"
+    const char* debug = nullptr;
+    // directory of snapshots taken boot_frames into a run, keyed by a hash of the rom.
+    // without it every run boots from reset
+    const char* boot_cache = nullptr;
+    uint32_t boot_frames = 120;
+    // frames presented ahead of the real one, 0 presents the real one
+    int run_ahead = 0;
+    // evdev keyboard, the only input without a window
+    const char* input_device = nullptr;
+    // headless runs mix the sound into this wav file
+    const char* wav = nullptr;
+    // directory of 0.wav to 9.wav played instead of the synthesized sounds
+    const char* samples = nullptr;
+    // every frame written to a frame store, a y4m stream or pngs, by the extension
+    const char* capture = nullptr;
+    // vram and state hashes of every frame written to a log, or checked against one a golden run wrote
+    const char* hash_log = nullptr;
+    const char* hash_check = nullptr;
+    // the input of the run with the cycle each event reached the ports at, for replay
+    const char* record = nullptr;
+    present_mode mode = present_argb4444;
+};
 
-    if (size > memory_size) { return; }
+// when the run was launched and how it got through the boot, reported with the first frame
+struct startup
+{
+    std::chrono::steady_clock::time_point launched;
+    const char* boot;
+};
 
-    file.seekg(0, std::ios::beg); 
-    file.reaad((char *)memory , size); 
-    file.close(); 
+static void report_first_frame(const startup& start)
+{
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start.launched).count();
+    fprintf(stderr, "first frame %.2f ms after launch, %s\n", ms, start.boot);
 }
 
-int main(int argc, char* argv[])
+// only the pages written since the last frame are hashed again. run-ahead clears dirty_pages itself at
+// every presented frame and needs what it says, without it nothing else reads it and it is cleared here
+template<typename cpu_type>
+static void hash_frame(hash_log* hashes, cpu_type* cpu, uint64_t number, bool running_ahead)
+{
+    hashes->add(cpu, number, cpu->dirty_pages);
+    if (!running_ahead)
+    {
+        cpu->dirty_pages = 0;
+    }
+}
+
+// the cpu never touches sdl and never waits on the renderer, it copies vram at rst 2 and moves on.
+// the only wait is the pacer holding it to the emulated clock
+template<typename cpu_type>
+static void emulation_loop(cpu_type* cpu, triple_buffer<frame>* frames, std::atomic<bool>* running, run_options options, startup start, input_sampler* input, sound_output* audio, frame_capture* capture, hash_log* hashes)
+{
+    pacer clock(options.turbo ? 0 : 2000000.0 * options.speed);
+    std::unique_ptr<run_ahead<cpu_type>> ahead(options.run_ahead ? new run_ahead<cpu_type>(cpu, options.run_ahead) : nullptr);
+    uint64_t number = 0;
+    int64_t unseen_input = 0;
+    sound_ports ports;
+    sound_event events[sound_count];
+    while (running->load(std::memory_order_relaxed))
+    {
+        // right after the pacer wait, the latest the ports can be set before the game reads them
+        int64_t input_time = input->sample(cpu);
+        unseen_input = unseen_input ? unseen_input : input_time;
+
+        uint8_t id = cpu->run_half_frame();
+        // before the run-ahead, which puts the ports back the way they were
+        for (size_t i = 0, n = ports.update(cpu->out_port[3], cpu->out_port[5], events); i < n; ++i)
+        {
+            audio->push(events[i]);
+        }
+        clock.wait_for(cpu->clock_count);
+        if (id != 2)
+        {
+            continue;
+        }
+        if (++number == 1)
+        {
+            report_first_frame(start);
+        }
+        if (capture)
+        {
+            capture->add(cpu->vram(), number);
+        }
+        if (hashes)
+        {
+            hash_frame(hashes, cpu, number, ahead != nullptr);
+        }
+        if (number % options.frame_skip == 0)
+        {
+            frame& back = frames->back();
+            if (ahead)
+            {
+                ahead->present(cpu, back.vram);
+            }
+            else
+            {
+                memcpy(back.vram, cpu->vram(), vram_size);
+            }
+            back.number = number;
+            back.input_time = unseen_input;
+            unseen_input = 0;
+            frames->publish();
+        }
+    }
+    clock.report(stderr);
+    if (ahead)
+    {
+        ahead->report(stderr, options.speed);
+    }
+}
+
+template<typename cpu_type>
+static int run_headless(cpu_type* cpu, const run_options& options, const startup& launch, input_sampler* input, frame_capture* capture, hash_log* hashes)
+{
+    // with run-ahead every frame is presented into scratch, so the rate shows what it costs
+    std::unique_ptr<run_ahead<cpu_type>> ahead(options.run_ahead ? new run_ahead<cpu_type>(cpu, options.run_ahead) : nullptr);
+    static uint8_t scratch[vram_size];
+
+    // the wav gets the samples the emulated clock has played so far at the end of every half frame
+    static sound_mixer mixer;
+    wav_writer wav;
+    sound_ports ports;
+    sound_event events[sound_count];
+    static int16_t samples[1024];
+    uint64_t written = 0;
+    if (options.wav && !wav.open(options.wav, mixer.rate()))
+    {
+        fprintf(stderr, "cannot write %s\n", options.wav);
+        return 1;
+    }
+    if (options.wav && options.samples)
+    {
+        fprintf(stderr, "%d samples loaded from %s\n", mixer.load_samples(options.samples), options.samples);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    uint64_t start_cycles = cpu->clock_count;
+    for (uint64_t frame = 0; frame < options.frames; )
+    {
+        input->sample(cpu);
+        uint8_t id = cpu->run_half_frame();
+        if (options.wav)
+        {
+            for (size_t i = 0, n = ports.update(cpu->out_port[3], cpu->out_port[5], events); i < n; ++i)
+            {
+                mixer.trigger(events[i]);
+            }
+            uint64_t due = (cpu->clock_count - start_cycles) * mixer.rate() / 2000000 - written;
+            while (due)
+            {
+                size_t n = std::min<uint64_t>(due, sizeof(samples) / sizeof(samples[0]));
+                mixer.mix(samples, n);
+                wav.write(samples, n);
+                written += n;
+                due -= n;
+            }
+        }
+        if (id != 2)
+        {
+            continue;
+        }
+        if (++frame == 1)
+        {
+            report_first_frame(launch);
+        }
+        // the real frame, before run-ahead steps past it
+        if (capture)
+        {
+            capture->add(cpu->vram(), frame);
+        }
+        if (hashes)
+        {
+            hash_frame(hashes, cpu, frame, ahead != nullptr);
+        }
+        if (ahead)
+        {
+            ahead->present(cpu, scratch);
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    uint64_t cycles = cpu->clock_count - start_cycles;
+
+    fprintf(stderr, "%llu frames in %.3f s, %.1f frames/s (%.1fx real time)\n",
+            (unsigned long long)options.frames, seconds, options.frames / seconds, options.frames / seconds / 60.0);
+    // an observer that sees every instruction turns both of these off
+    bool stepping = cpu->observer.needs_every_instruction();
+    fprintf(stderr, "idle skipping %s, %.1f%% of cycles fast forwarded\n",
+            cpu->skip_idle_loops && !stepping ? "on" : "off", cycles ? 100.0 * cpu->idle_cycles_skipped / cycles : 0.0);
+    fprintf(stderr, "%s core\n", cpu->native_code ? "recompiled" : "interpreted");
+    fprintf(stderr, "fusion %s, %llu fused dispatches for %llu instructions\n",
+            cpu->fuse_instructions && !stepping ? "on" : "off",
+            (unsigned long long)cpu->fused_dispatches, (unsigned long long)cpu->instruction_count);
+    if (ahead)
+    {
+        ahead->report(stderr);
+    }
+    if (options.wav)
+    {
+        if (!wav.close())
+        {
+            fprintf(stderr, "cannot write %s\n", options.wav);
+            return 1;
+        }
+        fprintf(stderr, "%.1f s of sound written to %s\n", (double)written / mixer.rate(), options.wav);
+    }
+    return 0;
+}
+
+// only the plain core has recompiled code
+static bool attach_native(i8080* cpu)
+{
+    if (!recompiled_run_until || !recompiled_rom_matches(*cpu))
+    {
+        return false;
+    }
+    cpu->native_code = recompiled_run_until;
+    return true;
+}
+
+template<typename cpu_type>
+static bool attach_native(cpu_type*)
+{
+    return false;
+}
+
+// lets a cpu stopped in the debugger go, so the emulation thread can be joined
+static void release(basic_i8080<debugger>* cpu)
+{
+    cpu->observer.stop();
+}
+
+template<typename cpu_type>
+static void release(cpu_type*)
+{
+}
+
+// the keys the window plays with, -1 for the rest
+static int sdl_button(SDL_Scancode code)
+{
+    switch (code)
+    {
+    case SDL_SCANCODE_C: return button_coin;
+    case SDL_SCANCODE_1: return button_p1_start;
+    case SDL_SCANCODE_2: return button_p2_start;
+    case SDL_SCANCODE_SPACE: return button_p1_fire;
+    case SDL_SCANCODE_LEFT: return button_p1_left;
+    case SDL_SCANCODE_RIGHT: return button_p1_right;
+    case SDL_SCANCODE_W: return button_p2_fire;
+    case SDL_SCANCODE_A: return button_p2_left;
+    case SDL_SCANCODE_D: return button_p2_right;
+    case SDL_SCANCODE_T: return button_tilt;
+    default: return -1;
+    }
+}
+
+// drains the capture queue and reports on it, false if the capture could not be written
+static bool finish_capture(frame_capture* capture, const run_options& options)
+{
+    if (!options.capture)
+    {
+        return true;
+    }
+    if (!capture->stop())
+    {
+        fprintf(stderr, "cannot write %s\n", options.capture);
+        return false;
+    }
+    capture->report(stderr);
+    return true;
+}
+
+// a failed check fails the run, so regression scripts only need the exit status
+static bool finish_hashes(hash_log* hashes)
+{
+    if (!hashes)
+    {
+        return true;
+    }
+    bool passed = hashes->close();
+    hashes->report(stderr);
+    return passed;
+}
+
+// the events were logged as they were applied, the end is where the cpu stopped
+template<typename cpu_type>
+static bool finish_recording(cpu_type* cpu, session* recorded, const run_options& options)
+{
+    if (!options.record)
+    {
+        return true;
+    }
+    state_hasher hasher;
+    recorded->end_cycle = cpu->clock_count;
+    recorded->end_hash = hasher.hash(cpu, ~0ull).state;
+    if (!write_session(options.record, *recorded))
+    {
+        fprintf(stderr, "cannot write %s\n", options.record);
+        return false;
+    }
+    fprintf(stderr, "%zu input events recorded to %s\n", recorded->events.size(), options.record);
+    return true;
+}
+
+// runs the first boot_frames frames, or loads the snapshot an earlier run took at that point.
+// returns how the boot went, for the startup report
+template<typename cpu_type>
+static const char* boot(cpu_type* cpu, const run_options& options)
+{
+    if (!options.boot_cache)
+    {
+        return "booted from reset";
+    }
+    uint64_t key = hash_bytes(cpu->rom(), cpu->rom_size);
+    key = hash_bytes((const uint8_t*)&options.boot_frames, sizeof(options.boot_frames), key);
+    std::string file_name = state_file_name(options.boot_cache, key);
+
+    static machine_state state;
+    if (read_state_file(file_name.c_str(), key, &state))
+    {
+        cpu->load_state(state);
+        return "boot snapshot loaded";
+    }
+    for (uint32_t i = 0; i < options.boot_frames * 2; ++i)
+    {
+        cpu->run_half_frame();
+    }
+    cpu->save_state(&state);
+    if (!write_state_file(file_name.c_str(), key, state))
+    {
+        fprintf(stderr, "cannot write %s\n", file_name.c_str());
+        return "booted from reset";
+    }
+    return "booted from reset, snapshot cached";
+}
+
+template<typename cpu_type>
+static int run(cpu_type* cpu, const char* rom_name, const run_options& options)
 {
-    i8080 cpu; 
+    auto launched = std::chrono::steady_clock::now();
+    std::string error;
+    if (!cpu->load_rom_or_set(rom_name, &error))
+    {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    cpu->skip_idle_loops = options.skip_idle_loops;
+    cpu->fuse_instructions = options.fuse_instructions;
+
+    if (options.native && !attach_native(cpu))
+    {
+        fprintf(stderr, "no recompiled code for %s in this build\n", rom_name);
+        return 1;
+    }
+    startup start = {launched, boot(cpu, options)};
+
+    // the window and evdev each feed a ring of their own, the cpu thread drains both
+    static input_ring window_input;
+    static input_ring device_input;
+    input_sampler input;
+    input.add(&window_input);
+    evdev_input device;
+    if (options.input_device)
+    {
+        if (!device.start(options.input_device, &device_input))
+        {
+            fprintf(stderr, "cannot open %s\n", options.input_device);
+            return 1;
+        }
+        input.add(&device_input);
+    }
+
+    // the encoder gets a thread of its own, the emulation only copies vram into its queue
+    frame_capture capture;
+    if (options.capture && !capture.start(options.capture))
+    {
+        fprintf(stderr, "cannot write %s\n", options.capture);
+        return 1;
+    }
+    hash_log hashes;
+    if (options.hash_log && !hashes.create(options.hash_log))
+    {
+        fprintf(stderr, "cannot write %s\n", options.hash_log);
+        return 1;
+    }
+    if (options.hash_check && !hashes.open(options.hash_check))
+    {
+        fprintf(stderr, "cannot read %s\n", options.hash_check);
+        return 1;
+    }
+    hash_log* hashing = options.hash_log || options.hash_check ? &hashes : nullptr;
+    session recorded;
+    if (options.record)
+    {
+        input.log = &recorded.events;
+    }
+
+    if (options.headless)
+    {
+        int result = run_headless(cpu, options, start, &input, options.capture ? &capture : nullptr, hashing);
+        if (options.input_device)
+        {
+            input.to_port.report(stderr, "input to port");
+        }
+        bool captured = finish_capture(&capture, options);
+        bool hashed = finish_hashes(hashing);
+        return finish_recording(cpu, &recorded, options) && captured && hashed ? result : 1;
+    }
 
     if (SDL_Init(SDL_INIT_EVERYTHING) < 0)
     {
@@ -24,15 +466,245 @@ int main(int argc, char* argv[])
         exit(1); 
     }
 
-    Graphics graphics; 
+    // sdl wants the window, renderer and event pump on the thread that created them,
+    // so the main thread is the render thread and the cpu gets a thread of its own
+    Graphics graphics("intel 8080", screen_width, screen_height, 2, options.mode);
+
+    // the callback mixes straight into the device buffer, a silent run if there is no device
+    static sound_mixer mixer;
+    if (options.samples)
+    {
+        fprintf(stderr, "%d samples loaded from %s\n", mixer.load_samples(options.samples), options.samples);
+    }
+    sound_output audio;
+    if (audio.open(&mixer))
+    {
+        fprintf(stderr, "sound buffer %.1f ms\n", audio.buffer_ms());
+    }
+    else
+    {
+        fprintf(stderr, "no audio device, %s\n", SDL_GetError());
+    }
 
-    load_rom(argv[2]); 
-    graphics = new Graphics("intel 8080", 224, 256, 2); 
+    static triple_buffer<frame> frames;
+    std::atomic<bool> running(true);
+    std::thread emulation(emulation_loop<cpu_type>, cpu, &frames, &running, options, start, &input, &audio, options.capture ? &capture : nullptr, hashing);
 
+    latency_stats to_photon;
     SDL_Event e; 
+    bool quit = false;
+    while (!quit)
+    {
+        while (SDL_PollEvent(&e))
+        {
+            if (e.type == SDL_QUIT)
+            {
+                quit = true;
+            }
+            else if ((e.type == SDL_KEYDOWN || e.type == SDL_KEYUP) && !e.key.repeat)
+            {
+                int id = sdl_button(e.key.keysym.scancode);
+                if (id >= 0)
+                {
+                    // stamped with when sdl queued it, the wait in the queue is part of the latency
+                    int64_t queued = (int64_t)(SDL_GetTicks() - e.key.timestamp) * 1000000;
+                    window_input.push({input_clock() - queued, 0, (uint8_t)id, (uint8_t)(e.type == SDL_KEYDOWN)});
+                }
+            }
+        }
 
+        // present blocks on vsync here, never on the cpu thread. no new frame means nothing to draw yet
+        if (frames.consume())
+        {
+            graphics.update(frames.front().vram);
+            if (frames.front().input_time)
+            {
+                to_photon.add(input_clock() - frames.front().input_time);
+            }
+        }
+        else
+        {
+            SDL_Delay(1);
+        }
+    }
 
-    
+    running = false;
+    release(cpu);
+    emulation.join();
+    audio.close();
+    SDL_Quit();
+    input.to_port.report(stderr, "input to port");
+    to_photon.report(stderr, "input to photon");
+    bool captured = finish_capture(&capture, options);
+    bool hashed = finish_hashes(hashing);
+    return finish_recording(cpu, &recorded, options) && captured && hashed ? 0 : 1;
 }
 
+int main(int argc, char* argv[])
+{
+    const char* rom_name = nullptr;
+    run_options options;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--indexed") == 0)
+        {
+            options.mode = present_indexed;
+        }
+        else if (strcmp(argv[i], "--speed") == 0 && i + 1 < argc)
+        {
+            options.speed = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--turbo") == 0)
+        {
+            options.turbo = true;
+        }
+        else if (strcmp(argv[i], "--frameskip") == 0 && i + 1 < argc)
+        {
+            options.frame_skip = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--headless") == 0)
+        {
+            options.headless = true;
+        }
+        else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+        {
+            options.frames = strtoull(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--no-idle-skip") == 0)
+        {
+            options.skip_idle_loops = false;
+        }
+        else if (strcmp(argv[i], "--no-fuse") == 0)
+        {
+            options.fuse_instructions = false;
+        }
+        else if (strcmp(argv[i], "--native") == 0)
+        {
+            options.native = true;
+        }
+        else if (strcmp(argv[i], "--profile") == 0)
+        {
+            options.profile = true;
+            options.headless = true;
+        }
+        else if (strcmp(argv[i], "--coverage") == 0 && i + 1 < argc)
+        {
+            options.coverage = argv[++i];
+        }
+        else if (strcmp(argv[i], "--boot-cache") == 0 && i + 1 < argc)
+        {
+            options.boot_cache = argv[++i];
+        }
+        else if (strcmp(argv[i], "--boot-frames") == 0 && i + 1 < argc)
+        {
+            options.boot_frames = strtoul(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--run-ahead") == 0 && i + 1 < argc)
+        {
+            options.run_ahead = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--input") == 0 && i + 1 < argc)
+        {
+            options.input_device = argv[++i];
+        }
+        else if (strcmp(argv[i], "--wav") == 0 && i + 1 < argc)
+        {
+            options.wav = argv[++i];
+        }
+        else if (strcmp(argv[i], "--samples") == 0 && i + 1 < argc)
+        {
+            options.samples = argv[++i];
+        }
+        else if (strcmp(argv[i], "--capture") == 0 && i + 1 < argc)
+        {
+            options.capture = argv[++i];
+        }
+        else if (strcmp(argv[i], "--hash-log") == 0 && i + 1 < argc)
+        {
+            options.hash_log = argv[++i];
+        }
+        else if (strcmp(argv[i], "--hash-check") == 0 && i + 1 < argc)
+        {
+            options.hash_check = argv[++i];
+        }
+        else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+        {
+            options.record = argv[++i];
+        }
+        else if (strcmp(argv[i], "--debug") == 0 && i + 1 < argc)
+        {
+            options.debug = argv[++i];
+        }
+        else
+        {
+            rom_name = argv[i];
+        }
+    }
+
+    if (!rom_name || options.speed <= 0 || options.frame_skip < 1 || options.run_ahead < 0)
+    {
+        fprintf(stderr,
+            "usage: intel-8080 [--indexed] [--speed x] [--turbo] [--frameskip n] [--headless] [--frames n] [--no-idle-skip] [--no-fuse] [--native] [--profile] [--coverage file] [--boot-cache dir] [--boot-frames n] [--run-ahead n] [--input device] [--wav file] [--samples dir] [--capture file] [--hash-log file] [--hash-check file] [--record file] [--debug endpoint] rom\n"
+            "  rom            an image loaded at $0000, or a .set manifest of images such as invaders.set\n"
+            "  keys           c coin, 1 and 2 start, arrows and space for player 1, a d w for player 2, t tilt\n"
+            "  --indexed      present through the 8bpp texture path\n"
+            "  --speed x      run at x times the 2 MHz clock\n"
+            "  --turbo        run unthrottled\n"
+            "  --frameskip n  render every nth frame\n"
+            "  --headless     no window, run --frames frames (default 600) unthrottled and report the rate\n"
+            "  --no-idle-skip interpret idle loops instead of fast forwarding through them\n"
+            "  --no-fuse      step hot sequences one instruction at a time\n"
+            "  --native       run the recompiled rom linked into this build\n"
+            "  --profile      run headless, stepping every instruction, and list the hottest opcode pairs and triples\n"
+            "  --coverage f   record which rom bytes run and how busy each ram page is, write them to f for disassembler -c\n"
+            "  --boot-cache d keep a snapshot of the machine after the boot in d and start later runs from it\n"
+            "  --boot-frames n frames the boot runs before the snapshot, 120 by default\n"
+            "  --run-ahead n  present the frame n frames ahead of the real one, hiding n frames of input lag\n"
+            "  --input dev    also read the keyboard from an evdev device, for headless runs\n"
+            "  --wav file     with --headless, write the sound of the run to a wav file\n"
+            "  --samples dir  play dir/0.wav to dir/9.wav, mame's invaders samples, instead of the synthesized sounds\n"
+            "  --capture file every frame to file.y4m (ffmpeg), file-000001.png on, or any other name as a\n"
+            "                 compressed 1bpp frame store\n"
+            "  --hash-log f  write a hash of vram and of the whole machine for every frame, a golden run\n"
+            "  --hash-check f check every frame against a golden run's hashes, exit 1 if any differ\n"
+            "  --record f     write the input of the run to f, for replay to play back and verify\n"
+            "  --debug where  attach the debugger to the console (-), unix:path or tcp:port on localhost\n");
+        return 1;
+    }
 
+    // each observer gets a core of its own, so the hooks cost nothing in the plain one
+    if (options.profile)
+    {
+        static basic_i8080<opcode_profile> cpu;
+        int result = run(&cpu, rom_name, options);
+        cpu.observer.report(stderr);
+        return result;
+    }
+    if (options.coverage)
+    {
+        static basic_i8080<code_coverage> cpu;
+        int result = run(&cpu, rom_name, options);
+        if (result == 0)
+        {
+            cpu.observer.report(stderr);
+            if (!cpu.observer.save(options.coverage, rom_name))
+            {
+                fprintf(stderr, "cannot write %s\n", options.coverage);
+                return 1;
+            }
+        }
+        return result;
+    }
+    if (options.debug)
+    {
+        static basic_i8080<debugger> cpu;
+        if (!cpu.observer.start(&cpu, options.debug))
+        {
+            fprintf(stderr, "cannot open debugger endpoint %s\n", options.debug);
+            return 1;
+        }
+        return run(&cpu, rom_name, options);
+    }
+    static i8080 cpu;
+    return run(&cpu, rom_name, options);
+}
@@ -0,0 +1,55 @@
+#include "mapped_file.hpp"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+bool map_file(const char* file_name, mapped_file* file)
+{
+    file->data = nullptr;
+    file->size = 0;
+
+    int fd = open(file_name, O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) < 0 || !S_ISREG(info.st_mode))
+    {
+        close(fd);
+        return false;
+    }
+
+    // mmap rejects zero length mappings, an empty file is just an empty view
+    if (info.st_size == 0)
+    {
+        close(fd);
+        return true;
+    }
+
+    void* data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        return false;
+    }
+
+    // everything we map is read front to back exactly once
+    madvise(data, info.st_size, MADV_SEQUENTIAL);
+
+    file->data = (const uint8_t*)data;
+    file->size = info.st_size;
+    return true;
+}
+
+void unmap_file(mapped_file* file)
+{
+    if (file->data)
+    {
+        munmap((void*)file->data, file->size);
+    }
+    file->data = nullptr;
+    file->size = 0;
+}
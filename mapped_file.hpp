@@ -0,0 +1,18 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// read only view of a whole file, backed by mmap
+struct mapped_file
+{
+    const uint8_t* data;
+    size_t size;
+};
+
+// maps file_name into memory, returns false if it cannot be opened or mapped
+bool map_file(const char* file_name, mapped_file* file);
+void unmap_file(mapped_file* file);
+
+#endif
@@ -0,0 +1,294 @@
+#include "observation.hpp"
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+/*
+a vram column is one screen column, 256 bits as four little endian words with screen row y at
+bit 255 - y, so an output row is a run of bits in every column.
+
+the scalar path counts each output row in each screen column as the lit bits below its top edge less
+the lit bits below its bottom edge, one masked popcount per edge, then sums the columns of each box.
+
+the avx2 path pools the columns first, while they are still bits: the columns of a box are added
+into a few bit planes, a carry save counter 256 bits wide (or just ored for observe_any). the planes
+of every box are then transposed 32 at a time so a register holds one vram byte of each, and the bits
+of every row are counted in all 32 at once with a nibble table. a pixel is its planes' counts weighted
+by their bit.
+*/
+
+observation_plan::observation_plan(int width, int height, observation_mode mode)
+    : out_width(width), out_height(height), mode(mode)
+{
+    int widest = 0;
+    for (int c = 0; c <= width; ++c)
+    {
+        column_first.push_back(c * screen_width / width);
+    }
+    for (int c = 0; c < width; ++c)
+    {
+        column_scale.push_back(1.0f / (column_first[c + 1] - column_first[c]));
+        widest = std::max(widest, column_first[c + 1] - column_first[c]);
+    }
+
+    int tallest = 0;
+    for (int r = 0; r <= height; ++r)
+    {
+        // the top edge of row r is screen row r * 256 / height, bit 256 - that
+        int high = screen_height - r * screen_height / height;
+        if (high == screen_height)
+        {
+            boundaries.push_back({3, ~0ull});
+        }
+        else
+        {
+            boundaries.push_back({(uint8_t)(high / 64), (1ull << (high % 64)) - 1});
+        }
+        if (r == height)
+        {
+            break;
+        }
+
+        int low = screen_height - (r + 1) * screen_height / height;
+        row_scale.push_back(255.0f / (high - low));
+        tallest = std::max(tallest, high - low);
+        piece_first.push_back(pieces.size());
+        for (int byte = (high - 1) / 8; byte * 8 + 8 > low; --byte)
+        {
+            int from = std::max(low - byte * 8, 0);
+            int to = std::min(high - byte * 8, 8);
+            pieces.push_back({(uint8_t)byte, (uint8_t)((0xff << from) & (0xff >> (8 - to)))});
+        }
+    }
+    piece_first.push_back(pieces.size());
+
+    planes = 1;
+    while (mode == observe_average && widest >> planes)
+    {
+        ++planes;
+    }
+    pooled_columns = (planes * width + 31) & ~31;
+    rows_fit_bytes = tallest < 256;
+}
+
+void observation_plan::observe_scalar(const uint8_t* vram, uint8_t* out) const
+{
+    static thread_local std::vector<uint16_t> counts;
+    counts.resize(out_height * screen_width);
+    const boundary* edges = boundaries.data();
+    for (int column = 0; column < screen_width; ++column)
+    {
+        uint64_t words[4];
+        memcpy(words, vram + column * (screen_height / 8), sizeof(words));
+        int below[4] = {0};
+        for (int w = 1; w < 4; ++w)
+        {
+            below[w] = below[w - 1] + __builtin_popcountll(words[w - 1]);
+        }
+
+        int top = below[edges[0].word] + __builtin_popcountll(words[edges[0].word] & edges[0].mask);
+        for (int r = 0; r < out_height; ++r)
+        {
+            const boundary& edge = edges[r + 1];
+            int bottom = below[edge.word] + __builtin_popcountll(words[edge.word] & edge.mask);
+            counts[r * screen_width + column] = top - bottom;
+            top = bottom;
+        }
+    }
+
+    for (int r = 0; r < out_height; ++r)
+    {
+        const uint16_t* row = counts.data() + r * screen_width;
+        for (int c = 0; c < out_width; ++c)
+        {
+            uint32_t sum = 0;
+            for (int column = column_first[c]; column < column_first[c + 1]; ++column)
+            {
+                sum += row[column];
+            }
+            out[r * out_width + c] = mode == observe_any ? (sum ? 255 : 0) : lrintf(sum * row_scale[r] * column_scale[c]);
+        }
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+// reverses the 4 bit index k, the order transpose_bytes leaves its columns in
+static inline int reverse4(int k)
+{
+    return (k & 1) << 3 | (k & 2) << 1 | (k & 4) >> 1 | (k & 8) >> 3;
+}
+
+// rows[k] is column reverse4(k). four rounds of unpacking leave byte m of the 16 columns in the
+// low lane of rows[m] and byte 16 + m in the high lane, columns in order
+__attribute__((target("avx2")))
+static inline void transpose_bytes(__m256i* rows)
+{
+    __m256i next[16];
+    for (int round = 0; round < 4; ++round)
+    {
+        for (int i = 0; i < 8; ++i)
+        {
+            __m256i x = rows[i];
+            __m256i y = rows[i + 8];
+            switch (round)
+            {
+            case 0: next[2 * i] = _mm256_unpacklo_epi8(x, y); next[2 * i + 1] = _mm256_unpackhi_epi8(x, y); break;
+            case 1: next[2 * i] = _mm256_unpacklo_epi16(x, y); next[2 * i + 1] = _mm256_unpackhi_epi16(x, y); break;
+            case 2: next[2 * i] = _mm256_unpacklo_epi32(x, y); next[2 * i + 1] = _mm256_unpackhi_epi32(x, y); break;
+            case 3: next[2 * i] = _mm256_unpacklo_epi64(x, y); next[2 * i + 1] = _mm256_unpackhi_epi64(x, y); break;
+            }
+        }
+        memcpy(rows, next, sizeof(next));
+    }
+}
+
+__attribute__((target("avx2")))
+void observation_plan::observe_avx2(const uint8_t* vram, uint8_t* out) const
+{
+    // bit plane p of box column c is pooled column p * width + c, the rest are zero
+    static thread_local std::vector<uint8_t> pooled;
+    static thread_local std::vector<uint8_t> counts;
+    pooled.resize(pooled_columns * (screen_height / 8));
+    counts.resize(out_height * pooled_columns);
+    const int width = out_width;
+
+    __m256i plane[8];
+    for (int c = 0; c < width; ++c)
+    {
+        for (int p = 0; p < planes; ++p)
+        {
+            plane[p] = _mm256_setzero_si256();
+        }
+        for (int column = column_first[c]; column < column_first[c + 1]; ++column)
+        {
+            __m256i carry = _mm256_loadu_si256((const __m256i*)(vram + column * (screen_height / 8)));
+            if (mode == observe_any)
+            {
+                plane[0] = _mm256_or_si256(plane[0], carry);
+                continue;
+            }
+            for (int p = 0; p < planes; ++p)
+            {
+                __m256i next = _mm256_and_si256(plane[p], carry);
+                plane[p] = _mm256_xor_si256(plane[p], carry);
+                carry = next;
+            }
+        }
+        for (int p = 0; p < planes; ++p)
+        {
+            _mm256_storeu_si256((__m256i*)(pooled.data() + (p * width + c) * (screen_height / 8)), plane[p]);
+        }
+    }
+    memset(pooled.data() + planes * width * (screen_height / 8), 0, (pooled_columns - planes * width) * (screen_height / 8));
+
+    const __m256i nibbles = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                             0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low_nibble = _mm256_set1_epi8(0x0f);
+    for (int column = 0; column < pooled_columns; column += 32)
+    {
+        __m256i left[16];
+        __m256i right[16];
+        for (int k = 0; k < 16; ++k)
+        {
+            left[k] = _mm256_loadu_si256((const __m256i*)(pooled.data() + (column + reverse4(k)) * (screen_height / 8)));
+            right[k] = _mm256_loadu_si256((const __m256i*)(pooled.data() + (column + 16 + reverse4(k)) * (screen_height / 8)));
+        }
+        transpose_bytes(left);
+        transpose_bytes(right);
+        // bytes[j] is vram byte j of the 32 columns
+        __m256i bytes[32];
+        for (int m = 0; m < 16; ++m)
+        {
+            bytes[m] = _mm256_permute2x128_si256(left[m], right[m], 0x20);
+            bytes[16 + m] = _mm256_permute2x128_si256(left[m], right[m], 0x31);
+        }
+
+        for (int r = 0; r < out_height; ++r)
+        {
+            __m256i sum = _mm256_setzero_si256();
+            for (uint32_t i = piece_first[r]; i < piece_first[r + 1]; ++i)
+            {
+                __m256i bits = _mm256_and_si256(bytes[pieces[i].byte], _mm256_set1_epi8(pieces[i].mask));
+                __m256i low = _mm256_shuffle_epi8(nibbles, _mm256_and_si256(bits, low_nibble));
+                __m256i high = _mm256_shuffle_epi8(nibbles, _mm256_and_si256(_mm256_srli_epi16(bits, 4), low_nibble));
+                sum = _mm256_add_epi8(sum, _mm256_add_epi8(low, high));
+            }
+            _mm256_storeu_si256((__m256i*)(counts.data() + r * pooled_columns + column), sum);
+        }
+    }
+
+    // 16 pixels at a time, the last few of a row one at a time
+    const __m256i zero = _mm256_setzero_si256();
+    for (int r = 0; r < out_height; ++r)
+    {
+        const uint8_t* row = counts.data() + r * pooled_columns;
+        uint8_t* to = out + r * width;
+        const __m256 scale = _mm256_set1_ps(row_scale[r]);
+        int c = 0;
+        for (; c + 16 <= width; c += 16)
+        {
+            __m256i sum = zero;
+            for (int p = 0; p < planes; ++p)
+            {
+                __m256i count = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(row + p * width + c)));
+                sum = _mm256_add_epi16(sum, _mm256_sll_epi16(count, _mm_cvtsi32_si128(p)));
+            }
+            __m256i pixels;
+            if (mode == observe_any)
+            {
+                // 255 rather than 0xffff, which packus would saturate to 0
+                pixels = _mm256_srli_epi16(_mm256_cmpgt_epi16(sum, zero), 8);
+            }
+            else
+            {
+                __m256 low = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm256_castsi256_si128(sum))),
+                                           _mm256_mul_ps(scale, _mm256_loadu_ps(column_scale.data() + c)));
+                __m256 high = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm256_extracti128_si256(sum, 1))),
+                                            _mm256_mul_ps(scale, _mm256_loadu_ps(column_scale.data() + c + 8)));
+                // packus works within 128 bit lanes, the permute puts the 16 pixels back in order
+                pixels = _mm256_permute4x64_epi64(_mm256_packus_epi32(_mm256_cvtps_epi32(low), _mm256_cvtps_epi32(high)), 0xd8);
+            }
+            _mm_storeu_si128((__m128i*)(to + c), _mm_packus_epi16(_mm256_castsi256_si128(pixels), _mm256_extracti128_si256(pixels, 1)));
+        }
+        for (; c < width; ++c)
+        {
+            uint32_t sum = 0;
+            for (int p = 0; p < planes; ++p)
+            {
+                sum += row[p * width + c] << p;
+            }
+            to[c] = mode == observe_any ? (sum ? 255 : 0) : lrintf(sum * row_scale[r] * column_scale[c]);
+        }
+    }
+}
+
+#endif
+
+void observation_plan::observe(const uint8_t* vram, uint8_t* out) const
+{
+#if defined(__x86_64__) || defined(__i386__)
+    static const bool avx2 = cpu_has_avx2();
+    if (avx2 && rows_fit_bytes)
+    {
+        observe_avx2(vram, out);
+        return;
+    }
+#endif
+    observe_scalar(vram, out);
+}
+
+void observation_plan::observe_batch(const uint8_t* vram, size_t stride, size_t count, int stack, uint8_t* out) const
+{
+    size_t frame = (size_t)out_width * out_height;
+    for (size_t i = 0; i < count; ++i)
+    {
+        uint8_t* frames = out + i * stack * frame;
+        memmove(frames, frames + frame, (stack - 1) * frame);
+        observe(vram + i * stride, frames + (stack - 1) * frame);
+    }
+}
@@ -0,0 +1,82 @@
+#ifndef OBSERVATION_H
+#define OBSERVATION_H
+
+#include "framebuffer.hpp"
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+enum observation_mode
+{
+    // each pixel is the share of the screen pixels under it that are lit, 0 to 255
+    observe_average,
+    // each pixel is 255 if any screen pixel under it is lit, so single pixel shots survive the downsampling
+    observe_any,
+};
+
+// small upright grayscale observations straight from vram, for learning code. the screen is cut into
+// width x height boxes and the lit pixels of each box are counted with popcount on the packed bits, so
+// the full size frame is never expanded. build one per size and reuse it, observe is read only
+class observation_plan
+{
+public:
+    // width at most screen_width, height at most screen_height
+    observation_plan(int width, int height, observation_mode mode);
+
+    // one frame, row major with the top row first, width * height bytes
+    void observe(const uint8_t* vram, uint8_t* out) const;
+
+    // count machines, vram i at vram + i * stride. out holds stack frames of width * height per machine,
+    // oldest first. the frames already there move back one and the new one is written last
+    void observe_batch(const uint8_t* vram, size_t stride, size_t count, int stack, uint8_t* out) const;
+
+    int width() const { return out_width; }
+    int height() const { return out_height; }
+
+    // the two paths observe picks between, exposed for checking them against each other. the avx2 one
+    // counts rows in bytes, avx2_fits says whether every output row is under 256 screen rows
+    void observe_scalar(const uint8_t* vram, uint8_t* out) const;
+#if defined(__x86_64__) || defined(__i386__)
+    void observe_avx2(const uint8_t* vram, uint8_t* out) const;
+#endif
+    bool avx2_fits() const { return rows_fit_bytes; }
+
+private:
+    // the lit pixels below bit b of a vram column are the words below word plus popcount(column word & mask)
+    struct boundary
+    {
+        uint8_t word;
+        uint64_t mask;
+    };
+
+    // the bits of one vram byte inside one output row
+    struct piece
+    {
+        uint8_t byte;
+        uint8_t mask;
+    };
+
+    int out_width;
+    int out_height;
+    observation_mode mode;
+    std::vector<float> row_scale;
+    // screen columns of output column c are column_first[c] to column_first[c + 1] - 1
+    std::vector<uint16_t> column_first;
+    std::vector<float> column_scale;
+
+    // boundaries[r] is the bottom edge of output row r - 1 and the top of row r, so the pixels of
+    // row r in a column are the ones below boundaries[r] less the ones below boundaries[r + 1]
+    std::vector<boundary> boundaries;
+
+    // pieces of output row r are pieces[piece_first[r]] to pieces[piece_first[r + 1] - 1]
+    std::vector<piece> pieces;
+    std::vector<uint32_t> piece_first;
+    // bits in the sums of the box columns, 1 for observe_any
+    int planes;
+    // planes * width rounded up to whole blocks of 32
+    int pooled_columns;
+    // the avx2 path counts rows in 8 bit lanes and takes the scalar one when a row does not fit
+    bool rows_fit_bytes;
+};
+
+#endif
@@ -0,0 +1,176 @@
+#include "observation.hpp"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+// g++ -O2 observation_check.cpp observation.cpp framebuffer.cpp -o observation_check
+// ./observation_check
+static void usage()
+{
+    fprintf(stderr,
+        "usage: observation_check\n"
+        "  observes a few vram patterns at every output width and every output height, in both modes, and\n"
+        "  exits 2 if the avx2 path differs from the scalar one or either strays from counting the pixels\n");
+}
+
+struct pattern
+{
+    const char* name;
+    uint8_t vram[vram_size];
+    // lit pixels in screen rows 0 to y - 1 of screen columns 0 to x - 1, at lit[y * (screen_width + 1) + x]
+    std::vector<uint32_t> lit;
+};
+
+// screen row y of a vram column is bit 255 - y, see observation.cpp
+static bool pixel(const uint8_t* vram, int x, int y)
+{
+    int bit = screen_height - 1 - y;
+    return vram[x * (screen_height / 8) + bit / 8] >> (bit % 8) & 1;
+}
+
+static void count_pixels(pattern* frame)
+{
+    frame->lit.assign((screen_width + 1) * (screen_height + 1), 0);
+    for (int y = 0; y < screen_height; ++y)
+    {
+        for (int x = 0; x < screen_width; ++x)
+        {
+            frame->lit[(y + 1) * (screen_width + 1) + x + 1] = pixel(frame->vram, x, y) +
+                frame->lit[y * (screen_width + 1) + x + 1] + frame->lit[(y + 1) * (screen_width + 1) + x] -
+                frame->lit[y * (screen_width + 1) + x];
+        }
+    }
+}
+
+static std::vector<pattern> patterns()
+{
+    std::vector<pattern> frames(4);
+    frames[0].name = "half lit";
+    frames[1].name = "sparse";
+    frames[2].name = "all lit";
+    frames[3].name = "one pixel";
+    srand(8080);
+    for (int i = 0; i < vram_size; ++i)
+    {
+        frames[0].vram[i] = rand();
+        frames[1].vram[i] = rand() % 8 == 0 ? 1 << rand() % 8 : 0;
+        frames[2].vram[i] = 0xff;
+        frames[3].vram[i] = 0;
+    }
+    // screen column 111, screen row 200
+    frames[3].vram[111 * 32 + 55 / 8] = 1 << (55 % 8);
+    for (pattern& frame : frames)
+    {
+        count_pixels(&frame);
+    }
+    return frames;
+}
+
+// each output box by counting its pixels, the way observation.hpp defines it. the plan scales in float,
+// so a box on a rounding edge may land one level away
+static void reference(const pattern& frame, int width, int height, observation_mode mode, uint8_t* out)
+{
+    for (int r = 0; r < height; ++r)
+    {
+        int top = r * screen_height / height;
+        int bottom = (r + 1) * screen_height / height;
+        for (int c = 0; c < width; ++c)
+        {
+            int left = c * screen_width / width;
+            int right = (c + 1) * screen_width / width;
+            const uint32_t* lit = frame.lit.data();
+            uint32_t sum = lit[bottom * (screen_width + 1) + right] - lit[top * (screen_width + 1) + right] -
+                           lit[bottom * (screen_width + 1) + left] + lit[top * (screen_width + 1) + left];
+            double area = (double)(bottom - top) * (right - left);
+            out[r * width + c] = mode == observe_any ? (sum ? 255 : 0) : (uint8_t)lrint(sum * 255.0 / area);
+        }
+    }
+}
+
+// returns false and says where on the first pixel further than slack from expected
+static bool compare(const char* what, const pattern& frame, int width, int height, observation_mode mode,
+                    const uint8_t* got, const uint8_t* expected, int slack)
+{
+    for (int i = 0; i < width * height; ++i)
+    {
+        if (abs(got[i] - expected[i]) > slack)
+        {
+            fprintf(stderr, "%s, %s, %dx%d %s: pixel %d,%d is %d, expected %d\n", what, frame.name, width, height,
+                    mode == observe_any ? "any" : "average", i % width, i / width, got[i], expected[i]);
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc != 1)
+    {
+        usage();
+        return 1;
+    }
+    (void)argv;
+
+    bool avx2 = false;
+#if defined(__x86_64__) || defined(__i386__)
+    avx2 = cpu_has_avx2();
+#endif
+    if (!avx2)
+    {
+        fprintf(stderr, "observation_check: no avx2 on this cpu, checking the scalar path alone\n");
+    }
+
+    // every width with a few heights and every height with a few widths, the edges of the boxes move with both
+    std::vector<std::pair<int, int>> sizes;
+    const int heights[] = {1, 2, 84, 100, 255, 256};
+    const int widths[] = {1, 84, 100, 223, 224};
+    for (int width = 1; width <= screen_width; ++width)
+    {
+        for (int height : heights)
+        {
+            sizes.push_back({width, height});
+        }
+    }
+    for (int height = 1; height <= screen_height; ++height)
+    {
+        for (int width : widths)
+        {
+            sizes.push_back({width, height});
+        }
+    }
+
+    std::vector<pattern> frames = patterns();
+    std::vector<uint8_t> expected(screen_width * screen_height);
+    std::vector<uint8_t> scalar(screen_width * screen_height);
+    std::vector<uint8_t> wide(screen_width * screen_height);
+    size_t checked = 0, failed = 0;
+    for (const std::pair<int, int>& size : sizes)
+    {
+        int width = size.first, height = size.second;
+        for (observation_mode mode : {observe_average, observe_any})
+        {
+            observation_plan plan(width, height, mode);
+            for (const pattern& frame : frames)
+            {
+                reference(frame, width, height, mode, expected.data());
+                plan.observe_scalar(frame.vram, scalar.data());
+                bool ok = compare("scalar", frame, width, height, mode, scalar.data(), expected.data(), 1);
+#if defined(__x86_64__) || defined(__i386__)
+                if (avx2 && plan.avx2_fits())
+                {
+                    // same float arithmetic on the same sums, so exactly the scalar result
+                    plan.observe_avx2(frame.vram, wide.data());
+                    ok = compare("avx2", frame, width, height, mode, wide.data(), scalar.data(), 0) && ok;
+                }
+#endif
+                ++checked;
+                failed += !ok;
+            }
+        }
+    }
+    fprintf(stderr, "%zu observations, %zu differ\n", checked, failed);
+    return failed ? 2 : 0;
+}
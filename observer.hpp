@@ -0,0 +1,74 @@
+#ifndef OBSERVER_H
+#define OBSERVER_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+
+// observer policy for basic_i8080. the core calls every hook inline at the point the event happens,
+// so an observer only pays for the hooks it gives a body. derive from null_observer and hide the ones
+// you need:
+//
+//   struct write_counter : null_observer
+//   {
+//       uint64_t writes = 0;
+//       void on_write(uint16_t, uint8_t) { ++writes; }
+//   };
+//   basic_i8080<write_counter> cpu;
+struct null_observer
+{
+    // true while the observer must see every instruction. turns off fused dispatch and idle loop skipping,
+    // which run several instructions without a hook for each. asked before every step, so it can change
+    // while the cpu runs
+    bool needs_every_instruction() const { return false; }
+
+    // before the instruction at pc runs
+    void on_instruction(uint16_t, uint8_t) {}
+    // every read_byte and write_byte, including stack traffic. opcode and operand fetches are not reads
+    void on_read(uint16_t, uint8_t) {}
+    // value is what the program stored, also reported when the address is rom and the write is dropped
+    void on_write(uint16_t, uint8_t) {}
+    void on_in(uint8_t, uint8_t) {}
+    void on_out(uint8_t, uint8_t) {}
+    // before the cpu jumps to the handler of rst id
+    void on_interrupt(uint8_t) {}
+    // an opcode the core does not implement. return true to skip it like a nop, false exits the program
+    bool on_unimplemented(uint16_t, uint8_t) { return false; }
+    // true before instructions that are run and then undone, such as run-ahead's frames, false after them
+    void on_speculation(bool) {}
+};
+
+// keeps a machine running past a bad opcode and records why the run failed, for the tools that drop a
+// faulted run instead of exiting: the fuzzer, the explorer and the c api
+struct fault_observer : null_observer
+{
+    bool on_unimplemented(uint16_t pc, uint8_t opcode)
+    {
+        if (fault.empty())
+        {
+            char text[64];
+            snprintf(text, sizeof(text), "unimplemented opcode %02x at %04x", opcode, pc);
+            fault = text;
+        }
+        return true;
+    }
+
+    // also faults once sp has left ram, $2000 up to an empty stack at $4000. sp moves on every push, so
+    // this is asked between half frames rather than by a hook
+    template<typename cpu_type>
+    bool faulted(const cpu_type& cpu)
+    {
+        if (fault.empty() && (cpu.sp < 0x2000 || cpu.sp > 0x4000))
+        {
+            char text[64];
+            snprintf(text, sizeof(text), "stack wrapped out of ram, sp %04x at %04x", cpu.sp, cpu.pc);
+            fault = text;
+        }
+        return !fault.empty();
+    }
+
+    // why the run failed, empty if it did not
+    std::string fault;
+};
+
+#endif
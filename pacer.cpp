@@ -0,0 +1,123 @@
+#include "pacer.hpp"
+#include <errno.h>
+#include <math.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define spin_pause() _mm_pause()
+#else
+#define spin_pause()
+#endif
+
+// falling further behind than this (a debugger stop, a slow host) restarts the time base instead of racing to catch up
+static const int64_t max_lag = 100000000;
+static const int64_t min_spin_margin = 50000;
+static const int64_t max_spin_margin = 2000000;
+
+pacer::pacer(double clock_hz)
+{
+    nominal_hz = 2000000.0;
+    ns_per_cycle = clock_hz > 0 ? 1e9 / clock_hz : 0;
+    started = false;
+    spin_margin = 200000;
+    waits = 0;
+    lateness_sum = 0;
+    lateness_squares = 0;
+    lateness_max = 0;
+    resyncs = 0;
+}
+
+int64_t pacer::now()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void pacer::resync(uint64_t cycle, int64_t time)
+{
+    start_cycle = cycle;
+    start_time = time;
+}
+
+void pacer::wait_for(uint64_t cycle)
+{
+    int64_t time = now();
+    if (!started)
+    {
+        started = true;
+        first_time = time;
+        first_cycle = cycle;
+        last_cycle = cycle;
+        resync(cycle, time);
+        return;
+    }
+    last_cycle = cycle;
+    if (ns_per_cycle == 0)
+    {
+        return;
+    }
+
+    int64_t deadline = start_time + (int64_t)((cycle - start_cycle) * ns_per_cycle);
+    if (time - deadline > max_lag)
+    {
+        ++resyncs;
+        resync(cycle, time);
+        return;
+    }
+
+    if (deadline - time > spin_margin)
+    {
+        int64_t wake = deadline - spin_margin;
+        timespec ts = {(time_t)(wake / 1000000000), (long)(wake % 1000000000)};
+        // it returns the error instead of setting errno. a signal restarts the sleep, any other error
+        // leaves the rest of the wait to the spin
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR)
+        {
+        }
+
+        // keep the margin just above the worst recent oversleep
+        int64_t oversleep = now() - wake;
+        if (oversleep > spin_margin)
+        {
+            spin_margin = oversleep + oversleep / 4;
+        }
+        else
+        {
+            spin_margin -= (spin_margin - oversleep) / 64;
+        }
+        spin_margin = spin_margin < min_spin_margin ? min_spin_margin : spin_margin > max_spin_margin ? max_spin_margin : spin_margin;
+    }
+
+    while ((time = now()) < deadline)
+    {
+        spin_pause();
+    }
+
+    int64_t lateness = time - deadline;
+    ++waits;
+    lateness_sum += lateness;
+    lateness_squares += (double)lateness * lateness;
+    if (lateness > lateness_max)
+    {
+        lateness_max = lateness;
+    }
+}
+
+void pacer::report(FILE* out) const
+{
+    if (!started)
+    {
+        return;
+    }
+    double seconds = (now() - first_time) * 1e-9;
+    double hz = seconds > 0 ? (last_cycle - first_cycle) / seconds : 0;
+    fprintf(out, "emulated clock %.3f MHz (%.2fx nominal) over %.1f s\n", hz * 1e-6, hz / nominal_hz, seconds);
+    if (waits > 0)
+    {
+        double mean = lateness_sum / waits;
+        double deviation = sqrt(fmax(0.0, lateness_squares / waits - mean * mean));
+        fprintf(out, "pacing jitter: mean %.1f us, stddev %.1f us, max %.1f us over %llu waits, %llu resyncs\n",
+                mean * 1e-3, deviation * 1e-3, lateness_max * 1e-3, (unsigned long long)waits, (unsigned long long)resyncs);
+    }
+}
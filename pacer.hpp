@@ -0,0 +1,46 @@
+#ifndef PACER_H
+#define PACER_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+// ties emulated clock cycles to wall time
+class pacer
+{
+public:
+    // clock_hz is the emulated clock, 2 MHz on the real board. 0 runs unthrottled
+    pacer(double clock_hz = 2000000.0);
+
+    // blocks until wall time catches up with cycle. sleeps for most of the wait and
+    // spins the last stretch, since sleeps only wake to within a scheduler tick
+    void wait_for(uint64_t cycle);
+
+    // achieved speed and wake up lateness since the pacer started
+    void report(FILE* out) const;
+
+private:
+    static int64_t now();
+    void resync(uint64_t cycle, int64_t time);
+
+    double ns_per_cycle;
+    double nominal_hz;
+    int64_t start_time;
+    uint64_t start_cycle;
+    int64_t first_time;
+    uint64_t first_cycle;
+    uint64_t last_cycle;
+    bool started;
+
+    // how early to wake up before the deadline, adapts to how late sleeps actually return
+    int64_t spin_margin;
+
+    // wake up lateness, ns past the deadline
+    uint64_t waits;
+    double lateness_sum;
+    double lateness_squares;
+    int64_t lateness_max;
+    uint64_t resyncs;
+};
+
+#endif
@@ -0,0 +1,94 @@
+#include "profile.hpp"
+#include "disassembler.hpp"
+#include <algorithm>
+#include <string>
+#include <vector>
+
+void opcode_profile::record(uint16_t pc, uint8_t opcode)
+{
+    if (pc != expected_pc)
+    {
+        run = 0;
+    }
+    window = (window << 8) | opcode;
+    run = std::min(run + 1, 3);
+    expected_pc = pc + opcode_lengths[opcode];
+
+    instructions++;
+    opcodes[opcode]++;
+    if (run >= 2)
+    {
+        pairs[window & 0xffff]++;
+    }
+    if (run == 3)
+    {
+        triples[window & 0xffffff]++;
+    }
+}
+
+// "LDAX   D" becomes "LDAX D", operands are left off
+static std::string mnemonic(uint8_t opcode)
+{
+    size_t length;
+    const char* text = opcode_text(opcode, &length);
+    std::string name;
+    for (size_t i = 0; i < length; ++i)
+    {
+        if (text[i] != ' ' || (!name.empty() && name.back() != ' '))
+        {
+            name += text[i];
+        }
+    }
+    while (!name.empty() && (name.back() == ' ' || name.back() == ','))
+    {
+        name.pop_back();
+    }
+    return name;
+}
+
+static void report_sequences(std::vector<std::pair<uint64_t, uint32_t>>& sequences, int length, uint64_t instructions, size_t top, FILE* out)
+{
+    size_t count = std::min(top, sequences.size());
+    std::partial_sort(sequences.begin(), sequences.begin() + count, sequences.end(),
+                      [](const std::pair<uint64_t, uint32_t>& l, const std::pair<uint64_t, uint32_t>& r) { return l.first > r.first; });
+
+    fprintf(out, "hottest %s:\n", length == 2 ? "pairs" : "triples");
+    for (size_t i = 0; i < count; ++i)
+    {
+        uint32_t key = sequences[i].second;
+        std::string text;
+        fprintf(out, "  %6.2f%%  %12llu  ", 100.0 * sequences[i].first / instructions, (unsigned long long)sequences[i].first);
+        for (int j = length - 1; j >= 0; --j)
+        {
+            uint8_t opcode = key >> (8 * j);
+            fprintf(out, "%02x ", opcode);
+            text += mnemonic(opcode);
+            text += j ? "; " : "";
+        }
+        fprintf(out, " %s\n", text.c_str());
+    }
+}
+
+void opcode_profile::report(FILE* out, size_t top) const
+{
+    if (instructions == 0)
+    {
+        return;
+    }
+    std::vector<std::pair<uint64_t, uint32_t>> sequences;
+    for (uint32_t key = 0; key < 256 * 256; ++key)
+    {
+        if (pairs[key])
+        {
+            sequences.emplace_back(pairs[key], key);
+        }
+    }
+    report_sequences(sequences, 2, instructions, top, out);
+
+    sequences.clear();
+    for (const auto& entry : triples)
+    {
+        sequences.emplace_back(entry.second, entry.first);
+    }
+    report_sequences(sequences, 3, instructions, top, out);
+}
@@ -0,0 +1,38 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include "observer.hpp"
+#include <stdint.h>
+#include <stdio.h>
+#include <unordered_map>
+
+// execution counts of single opcodes and of the pairs and triples they form. a sequence only
+// counts when each instruction is the fall through of the one before it, since that is the only
+// shape a fused handler can cover. attach it as the observer of a core, basic_i8080<opcode_profile>
+class opcode_profile : public null_observer
+{
+public:
+    bool needs_every_instruction() const { return true; }
+    void on_instruction(uint16_t pc, uint8_t opcode) { record(pc, opcode); }
+
+    void record(uint16_t pc, uint8_t opcode);
+
+    // the hottest pairs and triples, each with its share of all executed instructions
+    void report(FILE* out, size_t top = 16) const;
+
+    uint64_t instructions = 0;
+    uint64_t opcodes[256] = {};
+    // indexed by first opcode << 8 | second
+    uint64_t pairs[256 * 256] = {};
+    // keyed by first << 16 | second << 8 | third, sparse enough for a map
+    std::unordered_map<uint32_t, uint64_t> triples;
+
+private:
+    uint32_t expected_pc = 0x10000;
+    // the last three opcodes, newest in the low byte
+    uint32_t window = 0;
+    // how many of them ran in a straight line
+    int run = 0;
+};
+
+#endif
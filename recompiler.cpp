@@ -0,0 +1,412 @@
+#include "recompiler.hpp"
+#include "disassembler.hpp"
+#include "flow.hpp"
+#include <algorithm>
+#include <vector>
+
+// 8080 cycle counts. conditional calls and returns take 6 more when taken
+static const uint8_t opcode_cycles[256] = {
+    4, 10, 7, 5, 5, 5, 7, 4, 4, 10, 7, 5, 5, 5, 7, 4,
+    4, 10, 7, 5, 5, 5, 7, 4, 4, 10, 7, 5, 5, 5, 7, 4,
+    4, 10, 16, 5, 5, 5, 7, 4, 4, 10, 16, 5, 5, 5, 7, 4,
+    4, 10, 13, 5, 10, 10, 10, 4, 4, 10, 13, 5, 5, 5, 7, 4,
+    5, 5, 5, 5, 5, 5, 7, 5, 5, 5, 5, 5, 5, 5, 7, 5,
+    5, 5, 5, 5, 5, 5, 7, 5, 5, 5, 5, 5, 5, 5, 7, 5,
+    5, 5, 5, 5, 5, 5, 7, 5, 5, 5, 5, 5, 5, 5, 7, 5,
+    7, 7, 7, 7, 7, 7, 7, 7, 5, 5, 5, 5, 5, 5, 7, 5,
+    4, 4, 4, 4, 4, 4, 7, 4, 4, 4, 4, 4, 4, 4, 7, 4,
+    4, 4, 4, 4, 4, 4, 7, 4, 4, 4, 4, 4, 4, 4, 7, 4,
+    4, 4, 4, 4, 4, 4, 7, 4, 4, 4, 4, 4, 4, 4, 7, 4,
+    4, 4, 4, 4, 4, 4, 7, 4, 4, 4, 4, 4, 4, 4, 7, 4,
+    5, 10, 10, 10, 11, 11, 7, 11, 5, 10, 10, 10, 11, 17, 7, 11,
+    5, 10, 10, 10, 11, 11, 7, 11, 5, 10, 10, 10, 11, 17, 7, 11,
+    5, 10, 10, 18, 11, 11, 7, 11, 5, 5, 10, 5, 11, 17, 7, 11,
+    5, 10, 10, 4, 11, 11, 7, 11, 5, 5, 10, 4, 11, 17, 7, 11,
+};
+
+static const int taken_extra_cycles = 6;
+
+// register fields of the opcode, 6 is the memory operand at hl
+static const char* register_names[8] = {"b", "c", "d", "e", "h", "l", "m", "a"};
+// the pairs for the rp field, 3 is sp or psw depending on the instruction
+static const char* pair_high[4] = {"b", "d", "h", "a"};
+static const char* pair_low[4] = {"c", "e", "l", ""};
+// the helper for each alu operation, in opcode order
+static const char* alu_helpers[8] = {"ADD", "ADC", "SUB", "SBB", "ANA", "XRA", "ORA", "CMP"};
+// nz, z, nc, c, po, pe, p, m
+static const char* conditions[8] = {"!cpu.z", "cpu.z", "!cpu.cy", "cpu.cy", "!cpu.p", "cpu.p", "!cpu.s", "cpu.s"};
+
+#define HL "(cpu.h << 8 | cpu.l)"
+
+// source text of register or memory operand r
+static void operand_text(int r, char* out)
+{
+    if (r == 6)
+    {
+        sprintf(out, "cpu.read_byte(" HL ")");
+    }
+    else
+    {
+        sprintf(out, "cpu.%s", register_names[r]);
+    }
+}
+
+// writes the statement for one straight line instruction. returns false when the instruction has
+// no native form and has to go through the interpreter
+static bool write_instruction(const uint8_t* code, size_t offset, FILE* out)
+{
+    uint8_t opcode = code[offset];
+    uint8_t byte = opcode_lengths[opcode] > 1 ? code[offset + 1] : 0;
+    uint16_t word = opcode_lengths[opcode] > 2 ? code[offset + 1] | (code[offset + 2] << 8) : 0;
+    int dst = (opcode >> 3) & 7;
+    int src = opcode & 7;
+    int pair = (opcode >> 4) & 3;
+    char value[64];
+
+    // mov, everything but hlt
+    if ((opcode & 0xc0) == 0x40)
+    {
+        operand_text(src, value);
+        if (dst == 6)
+        {
+            fprintf(out, "        cpu.write_byte(" HL ", %s);\n", value);
+        }
+        else
+        {
+            fprintf(out, "        cpu.%s = %s;\n", register_names[dst], value);
+        }
+        return true;
+    }
+    // alu with a register or memory operand
+    if ((opcode & 0xc0) == 0x80)
+    {
+        if (src == 6)
+        {
+            operand_text(src, value);
+            fprintf(out, "        { uint8_t value = %s; cpu.%s(&value); }\n", value, alu_helpers[dst]);
+        }
+        else
+        {
+            fprintf(out, "        cpu.%s(&cpu.%s);\n", alu_helpers[dst], register_names[src]);
+        }
+        return true;
+    }
+    // alu with an immediate
+    if ((opcode & 0xc7) == 0xc6)
+    {
+        fprintf(out, "        { uint8_t value = 0x%02x; cpu.%s(&value); }\n", byte, alu_helpers[dst]);
+        return true;
+    }
+    // mvi
+    if ((opcode & 0xc7) == 0x06)
+    {
+        if (dst == 6)
+        {
+            fprintf(out, "        cpu.write_byte(" HL ", 0x%02x);\n", byte);
+        }
+        else
+        {
+            fprintf(out, "        cpu.%s = 0x%02x;\n", register_names[dst], byte);
+        }
+        return true;
+    }
+    // inr, dcr
+    if ((opcode & 0xc6) == 0x04)
+    {
+        const char* helper = opcode & 1 ? "DCR" : "INR";
+        if (dst == 6)
+        {
+            fprintf(out, "        { uint8_t value = cpu.read_byte(" HL "); cpu.%s(&value); cpu.write_byte(" HL ", value); }\n", helper);
+        }
+        else
+        {
+            fprintf(out, "        cpu.%s(&cpu.%s);\n", helper, register_names[dst]);
+        }
+        return true;
+    }
+
+    switch (opcode)
+    {
+    // nop, including the undocumented ones
+    case 0x00: case 0x08: case 0x10: case 0x18: case 0x20: case 0x28: case 0x30: case 0x38:
+        return true;
+    // lxi
+    case 0x01: case 0x11: case 0x21:
+        fprintf(out, "        cpu.%s = 0x%02x; cpu.%s = 0x%02x;\n", pair_high[pair], word >> 8, pair_low[pair], word & 0xff);
+        return true;
+    case 0x31:
+        fprintf(out, "        cpu.sp = 0x%04x;\n", word);
+        return true;
+    // stax, ldax
+    case 0x02: case 0x12:
+        fprintf(out, "        cpu.write_byte(cpu.%s << 8 | cpu.%s, cpu.a);\n", pair_high[pair], pair_low[pair]);
+        return true;
+    case 0x0a: case 0x1a:
+        fprintf(out, "        cpu.LDAX(&cpu.%s, &cpu.%s);\n", pair_high[pair], pair_low[pair]);
+        return true;
+    // inx, dcx, dad
+    case 0x03: case 0x13: case 0x23:
+        fprintf(out, "        cpu.INX(&cpu.%s, &cpu.%s);\n", pair_high[pair], pair_low[pair]);
+        return true;
+    case 0x0b: case 0x1b: case 0x2b:
+        fprintf(out, "        cpu.DCX(&cpu.%s, &cpu.%s);\n", pair_high[pair], pair_low[pair]);
+        return true;
+    case 0x09: case 0x19: case 0x29:
+        fprintf(out, "        cpu.DAD(&cpu.%s, &cpu.%s);\n", pair_high[pair], pair_low[pair]);
+        return true;
+    case 0x33:
+        fprintf(out, "        cpu.sp++;\n");
+        return true;
+    case 0x3b:
+        fprintf(out, "        cpu.sp--;\n");
+        return true;
+    case 0x39:
+        fprintf(out, "        { uint32_t result = " HL " + cpu.sp; cpu.cy = result > 0xffff; cpu.h = result >> 8; cpu.l = result; }\n");
+        return true;
+    // shld, lhld, sta, lda
+    case 0x22:
+        fprintf(out, "        cpu.write_byte(0x%04x, cpu.l); cpu.write_byte(0x%04x, cpu.h);\n", word, (uint16_t)(word + 1));
+        return true;
+    case 0x2a:
+        fprintf(out, "        cpu.l = cpu.read_byte(0x%04x); cpu.h = cpu.read_byte(0x%04x);\n", word, (uint16_t)(word + 1));
+        return true;
+    case 0x32:
+        fprintf(out, "        cpu.write_byte(0x%04x, cpu.a);\n", word);
+        return true;
+    case 0x3a:
+        fprintf(out, "        cpu.a = cpu.read_byte(0x%04x);\n", word);
+        return true;
+    // rotates, daa and the carry and accumulator complements
+    case 0x07:
+        fprintf(out, "        cpu.RLC();\n");
+        return true;
+    case 0x0f:
+        fprintf(out, "        cpu.RRC();\n");
+        return true;
+    case 0x17:
+        fprintf(out, "        cpu.RAL();\n");
+        return true;
+    case 0x1f:
+        fprintf(out, "        cpu.RAR();\n");
+        return true;
+    case 0x27:
+        fprintf(out, "        cpu.DAA();\n");
+        return true;
+    case 0x2f:
+        fprintf(out, "        cpu.CMA();\n");
+        return true;
+    case 0x37:
+        fprintf(out, "        cpu.cy = 1;\n");
+        return true;
+    case 0x3f:
+        fprintf(out, "        cpu.cy = !cpu.cy;\n");
+        return true;
+    // push, pop
+    case 0xc5: case 0xd5: case 0xe5:
+        fprintf(out, "        cpu.PUSH(&cpu.%s, &cpu.%s);\n", pair_high[pair], pair_low[pair]);
+        return true;
+    case 0xc1: case 0xd1: case 0xe1:
+        fprintf(out, "        cpu.POP(&cpu.%s, &cpu.%s);\n", pair_high[pair], pair_low[pair]);
+        return true;
+    case 0xf5:
+        fprintf(out, "        cpu.PUSH_PSW();\n");
+        return true;
+    case 0xf1:
+        fprintf(out, "        cpu.POP_PSW();\n");
+        return true;
+    // xthl, xchg, sphl
+    case 0xe3:
+        fprintf(out, "        cpu.XTHL();\n");
+        return true;
+    case 0xeb:
+        fprintf(out, "        cpu.XCHG();\n");
+        return true;
+    case 0xf9:
+        fprintf(out, "        cpu.sp = " HL ";\n");
+        return true;
+    // out, in
+    case 0xd3:
+        fprintf(out, "        cpu.write_port(0x%02x, cpu.a);\n", byte);
+        return true;
+    case 0xdb:
+        fprintf(out, "        cpu.a = cpu.read_port(0x%02x);\n", byte);
+        return true;
+    // di, ei. interrupts are only raised between run_until calls, so this takes effect in time
+    case 0xf3:
+        fprintf(out, "        cpu.interrupts_enabled = 0;\n");
+        return true;
+    case 0xfb:
+        fprintf(out, "        cpu.interrupts_enabled = 1;\n");
+        return true;
+    default:
+        return false;
+    }
+}
+
+// moves to target: straight to its block when the analysis found one, otherwise through the dispatch switch
+static void write_goto(const flow_graph& graph, uint16_t target, FILE* out)
+{
+    if (graph.block_at(target))
+    {
+        fprintf(out, "cpu.pc = 0x%04x; goto block_%04x;", target, target);
+    }
+    else
+    {
+        fprintf(out, "cpu.pc = 0x%04x; continue;", target);
+    }
+}
+
+static void write_push(uint16_t value, FILE* out)
+{
+    fprintf(out, "cpu.sp -= 2; cpu.write_word(cpu.sp, 0x%04x); ", value);
+}
+
+static void write_block(const flow_graph& graph, const basic_block& block, const uint8_t* code, recompile_stats* stats, FILE* out)
+{
+    // cycles of the whole block, worst case. the block only runs natively when all of it ends before cycle,
+    // so an interrupt lands on the same instruction it would when stepping
+    int budget = 0;
+    for (uint32_t address = block.start; address < block.end; address += opcode_lengths[code[address - graph.origin]])
+    {
+        budget += opcode_cycles[code[address - graph.origin]];
+    }
+    budget += taken_extra_cycles;
+
+    fprintf(out, "    block_%04x:\n", block.start);
+    // a direct goto skips the loop condition, so the cpu may already be at cycle
+    fprintf(out, "        if (cpu.clock_count + %d > cycle) { if (cpu.clock_count < cycle) cpu.emulate(); continue; }\n", budget);
+
+    // clock and instruction counts are added once at the exit, less whatever the interpreter counted itself
+    int cycles = 0;
+    int instructions = 0;
+    uint32_t address = block.start;
+    uint32_t last = block.start;
+    while (address < block.end)
+    {
+        size_t offset = address - graph.origin;
+        uint8_t opcode = code[offset];
+        last = address;
+        stats->instructions++;
+        if (classify_flow(opcode) != flow_none)
+        {
+            break;
+        }
+        if (write_instruction(code, offset, out))
+        {
+            cycles += opcode_cycles[opcode];
+            instructions++;
+        }
+        else
+        {
+            fprintf(out, "        cpu.pc = 0x%04x; cpu.emulate();\n", address);
+            stats->interpreted++;
+        }
+        address += opcode_lengths[opcode];
+    }
+
+    size_t offset = last - graph.origin;
+    uint8_t opcode = code[offset];
+    flow_kind kind = classify_flow(opcode);
+    uint16_t next = last + opcode_lengths[opcode];
+    uint16_t target = opcode_lengths[opcode] == 3 ? code[offset + 1] | (code[offset + 2] << 8) : 0;
+    const char* condition = conditions[(opcode >> 3) & 7];
+    if (kind != flow_none)
+    {
+        cycles += opcode_cycles[opcode];
+        instructions++;
+    }
+    fprintf(out, "        cpu.clock_count += %d; cpu.instruction_count += %d;\n", cycles, instructions);
+
+    fprintf(out, "        ");
+    switch (kind)
+    {
+    case flow_none:
+        write_goto(graph, next, out);
+        break;
+    case flow_jump:
+        write_goto(graph, target, out);
+        break;
+    case flow_branch:
+        fprintf(out, "if (%s) { ", condition);
+        write_goto(graph, target, out);
+        fprintf(out, " } ");
+        write_goto(graph, next, out);
+        break;
+    case flow_call:
+        write_push(next, out);
+        write_goto(graph, target, out);
+        break;
+    case flow_conditional_call:
+        fprintf(out, "if (%s) { cpu.clock_count += %d; ", condition, taken_extra_cycles);
+        write_push(next, out);
+        write_goto(graph, target, out);
+        fprintf(out, " } ");
+        write_goto(graph, next, out);
+        break;
+    case flow_return:
+        fprintf(out, "cpu.pc = cpu.read_word(cpu.sp); cpu.sp += 2; continue;");
+        break;
+    case flow_conditional_return:
+        fprintf(out, "if (%s) { cpu.clock_count += %d; cpu.pc = cpu.read_word(cpu.sp); cpu.sp += 2; continue; } ",
+                condition, taken_extra_cycles);
+        write_goto(graph, next, out);
+        break;
+    case flow_restart:
+        write_push(next, out);
+        write_goto(graph, opcode & 0x38, out);
+        break;
+    case flow_indirect:
+        fprintf(out, "cpu.pc = " HL "; continue;");
+        break;
+    case flow_halt:
+        fprintf(out, "cpu.pc = 0x%04x; cpu.halt = 1; continue;", next);
+        break;
+    }
+    fprintf(out, "\n\n");
+    stats->blocks++;
+}
+
+recompile_stats write_recompiled(const flow_graph& graph, const uint8_t* code, const char* source_name, FILE* out)
+{
+    recompile_stats stats;
+    std::vector<uint16_t> starts;
+    for (const auto& entry : graph.blocks)
+    {
+        starts.push_back(entry.first);
+    }
+    std::sort(starts.begin(), starts.end());
+
+    fprintf(out, "// generated by recompiler from %s, do not edit\n", source_name);
+    fprintf(out, "#include \"cpu.hpp\"\n\n");
+
+    fprintf(out, "static const uint8_t rom[%zu] = {", graph.size);
+    for (size_t i = 0; i < graph.size; ++i)
+    {
+        fprintf(out, "%s0x%02x,", i % 16 ? " " : "\n    ", code[i]);
+    }
+    fprintf(out, "\n};\n\n");
+
+    fprintf(out, "bool recompiled_rom_matches(i8080& cpu)\n{\n");
+    fprintf(out, "    for (uint32_t i = 0; i < sizeof(rom); ++i)\n    {\n");
+    fprintf(out, "        if (cpu.read_byte(0x%04x + i) != rom[i])\n        {\n            return false;\n        }\n    }\n", graph.origin);
+    fprintf(out, "    return true;\n}\n\n");
+
+    fprintf(out, "void recompiled_run_until(i8080& cpu, uint64_t cycle)\n{\n");
+    fprintf(out, "    while (cpu.clock_count < cycle)\n    {\n");
+    fprintf(out, "        if (cpu.halt)\n        {\n            cpu.clock_count = cycle;\n            return;\n        }\n");
+    fprintf(out, "        switch (cpu.pc)\n        {\n");
+    for (uint16_t start : starts)
+    {
+        fprintf(out, "        case 0x%04x: goto block_%04x;\n", start, start);
+    }
+    fprintf(out, "        }\n");
+    fprintf(out, "        // ram, code the analysis never reached, or the middle of a block after a partial step\n");
+    fprintf(out, "        cpu.emulate();\n        continue;\n\n");
+
+    for (uint16_t start : starts)
+    {
+        write_block(graph, *graph.block_at(start), code, &stats, out);
+    }
+    fprintf(out, "    }\n}\n");
+    return stats;
+}
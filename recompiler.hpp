@@ -0,0 +1,26 @@
+#ifndef RECOMPILER_H
+#define RECOMPILER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+
+class flow_graph;
+
+struct recompile_stats
+{
+    size_t blocks = 0;
+    size_t instructions = 0;
+    // instructions the generated code hands to i8080::emulate, those without a native form
+    size_t interpreted = 0;
+};
+
+// writes a c++ translation unit that runs the analyzed rom natively. it defines
+//   void recompiled_run_until(i8080& cpu, uint64_t cycle);
+//   bool recompiled_rom_matches(i8080& cpu);
+// every basic block becomes a label, reached through a switch on pc or directly from the block before it.
+// code the analysis never reached, ram code and jumps through pchl go back through the switch and fall
+// back to the interpreter when no block starts there
+recompile_stats write_recompiled(const flow_graph& graph, const uint8_t* code, const char* source_name, FILE* out);
+
+#endif
@@ -0,0 +1,173 @@
+#include "cpu.cpp"
+#include <memory>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+// ./recompiler -o invaders_native.cpp invaders
+// g++ -O2 recompiler_check.cpp invaders_native.cpp mapped_file.cpp rom_set.cpp -o recompiler_check
+// ./recompiler_check invaders.set
+bool recompiled_rom_matches(i8080& cpu);
+
+static void usage()
+{
+    fprintf(stderr,
+        "usage: recompiler_check [-f frames] [-i input] rom\n"
+        "  runs the rom on the interpreter and on the recompiled code linked into this build side by side\n"
+        "  and compares the whole machine after every half frame, exits 2 at the first difference\n"
+        "  -f frames  frames to run, 3600 (a minute) by default\n"
+        "  -i input   two bytes per frame for ports 1 and 2, like the fuzzer's. by default a coin and 1p start\n"
+        "             are pressed and the player then sweeps left and right shooting\n");
+}
+
+// port 1 of the built in script: bit 3 is wired high, coin, then start, then play. fire only shoots again
+// once released, so it is pulsed to score points
+static uint8_t scripted_port1(uint64_t frame)
+{
+    if (frame >= 100 && frame < 105)
+    {
+        return 0x09;
+    }
+    if (frame >= 200 && frame < 205)
+    {
+        return 0x0c;
+    }
+    if (frame < 300)
+    {
+        return 0x08;
+    }
+    return (frame & 32 ? 0x48 : 0x28) | (frame & 4 ? 0x10 : 0);
+}
+
+static bool read_input(const char* file_name, std::vector<uint8_t>* input)
+{
+    FILE* in = fopen(file_name, "rb");
+    if (!in)
+    {
+        return false;
+    }
+    uint8_t bytes[256];
+    size_t count;
+    while ((count = fread(bytes, 1, sizeof(bytes), in)) > 0)
+    {
+        input->insert(input->end(), bytes, bytes + count);
+    }
+    fclose(in);
+    return true;
+}
+
+// says where two machines that should match part ways
+static void report_difference(const machine_state& interpreted, const machine_state& native, uint64_t frame, int half)
+{
+    const machine_registers& x = interpreted.registers;
+    const machine_registers& y = native.registers;
+    fprintf(stderr, "frame %llu, half %d: the machines differ\n", (unsigned long long)frame, half);
+    fprintf(stderr, "  interpreted pc %04x sp %04x a %02x flags %02x bc %02x%02x de %02x%02x hl %02x%02x cycle %llu, %llu instructions\n",
+            x.pc, x.sp, x.a, x.flags, x.b, x.c, x.d, x.e, x.h, x.l, (unsigned long long)x.clock_count,
+            (unsigned long long)x.instruction_count);
+    fprintf(stderr, "  recompiled  pc %04x sp %04x a %02x flags %02x bc %02x%02x de %02x%02x hl %02x%02x cycle %llu, %llu instructions\n",
+            y.pc, y.sp, y.a, y.flags, y.b, y.c, y.d, y.e, y.h, y.l, (unsigned long long)y.clock_count,
+            (unsigned long long)y.instruction_count);
+    for (uint32_t address = 0; address < 0x10000; ++address)
+    {
+        if (interpreted.memory[address] != native.memory[address])
+        {
+            fprintf(stderr, "  first memory difference at %04x: %02x interpreted, %02x recompiled\n", address,
+                    interpreted.memory[address], native.memory[address]);
+            break;
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    uint64_t frames = 3600;
+    const char* input_name = nullptr;
+    const char* rom_name = nullptr;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "-f") == 0 && i + 1 < argc)
+        {
+            frames = strtoull(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "-i") == 0 && i + 1 < argc)
+        {
+            input_name = argv[++i];
+        }
+        else if (!rom_name)
+        {
+            rom_name = argv[i];
+        }
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+    if (!rom_name)
+    {
+        usage();
+        return 1;
+    }
+
+    std::vector<uint8_t> input;
+    if (input_name && !read_input(input_name, &input))
+    {
+        fprintf(stderr, "recompiler_check: cannot read %s\n", input_name);
+        return 1;
+    }
+
+    // the interpreter keeps idle skipping and fusion on, both must come out exactly as stepping would
+    std::unique_ptr<i8080> interpreted(new i8080);
+    std::unique_ptr<i8080> native(new i8080);
+    std::string error;
+    for (i8080* cpu : {interpreted.get(), native.get()})
+    {
+        if (!cpu->load_rom_or_set(rom_name, &error))
+        {
+            fprintf(stderr, "recompiler_check: %s\n", error.c_str());
+            return 1;
+        }
+    }
+    if (!recompiled_rom_matches(*native))
+    {
+        fprintf(stderr, "recompiler_check: the code linked into this build was recompiled from another rom\n");
+        return 1;
+    }
+    native->native_code = recompiled_run_until;
+
+    // zeroed so the padding between the registers compares equal
+    std::unique_ptr<machine_state> interpreted_state(new machine_state());
+    std::unique_ptr<machine_state> native_state(new machine_state());
+    for (uint64_t frame = 0; frame < frames; ++frame)
+    {
+        uint8_t port1 = scripted_port1(frame);
+        uint8_t port2 = interpreted->in_port[2];
+        if (input_name)
+        {
+            port1 = frame * 2 < input.size() ? input[frame * 2] : 0x08;
+            port2 = frame * 2 + 1 < input.size() ? input[frame * 2 + 1] : port2;
+        }
+        for (int half = 0; half < 2; ++half)
+        {
+            for (i8080* cpu : {interpreted.get(), native.get()})
+            {
+                cpu->in_port[1] = port1;
+                cpu->in_port[2] = port2;
+                cpu->run_half_frame();
+            }
+            interpreted->save_state(interpreted_state.get());
+            native->save_state(native_state.get());
+            if (memcmp(interpreted_state.get(), native_state.get(), sizeof(machine_state)) != 0)
+            {
+                report_difference(*interpreted_state, *native_state, frame, half);
+                return 2;
+            }
+        }
+    }
+    fprintf(stderr, "%llu frames, the interpreter and the recompiled code agree after every half frame, %llu instructions\n",
+            (unsigned long long)frames, (unsigned long long)interpreted->instruction_count);
+    return 0;
+}
@@ -0,0 +1,84 @@
+#include "flow.hpp"
+#include "mapped_file.hpp"
+#include "recompiler.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// g++ -O2 recompiler_main.cpp recompiler.cpp flow.cpp disassembler.cpp mapped_file.cpp -o recompiler
+// ./recompiler -o invaders_native.cpp invaders
+// g++ -O3 main.cpp invaders_native.cpp ... and run with --native
+static void usage()
+{
+    fprintf(stderr,
+        "usage: recompiler [-o output] [-e entry]... rom\n"
+        "  -o output  file for the generated c++, stdout by default\n"
+        "  -e entry   extra entry point in hex, the reset and interrupt vectors are always used\n");
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<uint16_t> entry_points = flow_graph::default_entry_points();
+    const char* output_name = nullptr;
+    const char* file_name = nullptr;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+        {
+            output_name = argv[++i];
+        }
+        else if (strcmp(argv[i], "-e") == 0 && i + 1 < argc)
+        {
+            entry_points.push_back(strtoul(argv[++i], nullptr, 16));
+        }
+        else if (!file_name)
+        {
+            file_name = argv[i];
+        }
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+    if (!file_name)
+    {
+        usage();
+        return 1;
+    }
+
+    mapped_file file;
+    if (!map_file(file_name, &file))
+    {
+        return 1;
+    }
+    // the board maps rom at $0000 and write_byte never lets the program change it
+    if (file.size == 0 || file.size > 0x2000)
+    {
+        fprintf(stderr, "recompiler: %s does not fit the $0000-$1fff rom\n", file_name);
+        unmap_file(&file);
+        return 1;
+    }
+
+    flow_graph graph;
+    graph.analyze(file.data, file.size, 0, entry_points);
+
+    FILE* out = output_name ? fopen(output_name, "w") : stdout;
+    if (!out)
+    {
+        unmap_file(&file);
+        return 1;
+    }
+    recompile_stats stats = write_recompiled(graph, file.data, file_name, out);
+    bool ok = !ferror(out);
+    if (out != stdout)
+    {
+        ok &= fclose(out) == 0;
+    }
+    unmap_file(&file);
+
+    fprintf(stderr, "%zu blocks, %zu instructions, %zu left to the interpreter\n",
+            stats.blocks, stats.instructions, stats.interpreted);
+    return ok ? 0 : 1;
+}
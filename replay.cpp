@@ -0,0 +1,254 @@
+#include "replay.hpp"
+#include "cpu.cpp"
+#include "snapshot.hpp"
+#include "state_hash.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <thread>
+#include <time.h>
+
+/*
+a checkpoint dir holds the machine_state of every checkpoint as a snapshot file, named after its
+frame, and an index: a header line with the key, then one "frame cycle event hash" line per checkpoint,
+event being the first session event not applied yet. the last line is the end of the session, it has a
+hash but no state.
+*/
+
+static const char index_magic[] = "i8080 checkpoints 2";
+
+struct checkpoint
+{
+    uint64_t frame;
+    uint64_t cycle;
+    // events are applied before a half frame, those due during the one that ended here are still pending
+    uint64_t event;
+    uint64_t hash;
+};
+
+// checkpoints belong to one rom and one session
+static uint64_t checkpoint_key(const i8080& cpu, const session& recorded)
+{
+    uint64_t key = hash_bytes(cpu.rom(), cpu.rom_size);
+    for (const button_event& event : recorded.events)
+    {
+        key = hash_bytes((const uint8_t*)&event.cycle, sizeof(event.cycle), key);
+        key = hash_bytes(&event.button, 1, key);
+        key = hash_bytes(&event.pressed, 1, key);
+    }
+    return hash_bytes((const uint8_t*)&recorded.end_cycle, sizeof(recorded.end_cycle), key);
+}
+
+static std::string checkpoint_name(const std::string& dir, uint64_t frame)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "/%08llu.state", (unsigned long long)frame);
+    return dir + name;
+}
+
+// the events due by the cpu's clock, applied the way input_sampler does before every half frame
+static void apply_due(i8080* cpu, const session& recorded, size_t* next)
+{
+    while (*next < recorded.events.size() && recorded.events[*next].cycle <= cpu->clock_count)
+    {
+        input_sampler::apply(cpu->in_port, recorded.events[(*next)++]);
+    }
+}
+
+bool replay_session(const char* rom_name, const session& recorded, const replay_options& options,
+                    std::string* error, replay_stats* stats)
+{
+    auto start = std::chrono::steady_clock::now();
+    std::unique_ptr<i8080> cpu(new i8080);
+    if (!cpu->load_rom_or_set(rom_name, error))
+    {
+        return false;
+    }
+
+    const std::string& dir = options.checkpoint_dir;
+    FILE* index = nullptr;
+    uint64_t key = checkpoint_key(*cpu, recorded);
+    if (!dir.empty())
+    {
+        mkdir(dir.c_str(), 0755);
+        index = fopen((dir + "/index").c_str(), "w");
+        if (!index || fprintf(index, "%s %016llx\n", index_magic, (unsigned long long)key) < 0)
+        {
+            *error = "cannot write " + dir + "/index";
+            if (index)
+            {
+                fclose(index);
+            }
+            return false;
+        }
+    }
+
+    // hashed from the pages written since the checkpoint before
+    std::unique_ptr<machine_state> state(new machine_state);
+    state_hasher hasher;
+    size_t next = 0;
+    auto save = [&](uint64_t frame, bool with_state) -> bool
+    {
+        uint64_t hash = hasher.hash(cpu.get(), cpu->dirty_pages).state;
+        cpu->dirty_pages = 0;
+        stats->end_hash = hash;
+        if (!index)
+        {
+            return true;
+        }
+        std::string name = checkpoint_name(dir, frame);
+        if (with_state)
+        {
+            ++stats->checkpoints;
+            cpu->save_state(state.get());
+            if (!write_state_file(name.c_str(), key, *state))
+            {
+                *error = "cannot write " + name;
+                return false;
+            }
+        }
+        return fprintf(index, "%llu %llu %llu %016llx\n", (unsigned long long)frame,
+                       (unsigned long long)cpu->clock_count, (unsigned long long)next, (unsigned long long)hash) > 0;
+    };
+
+    bool ok = !index || save(0, true);
+    uint64_t frames = 0;
+    while (ok && cpu->clock_count < recorded.end_cycle)
+    {
+        apply_due(cpu.get(), recorded, &next);
+        if (cpu->run_half_frame() == 2 && ++frames % options.interval == 0 && index &&
+            cpu->clock_count < recorded.end_cycle)
+        {
+            ok = save(frames, true);
+        }
+    }
+    ok = ok && save(frames, false);
+    if (index && fclose(index) != 0 && ok)
+    {
+        *error = "cannot write " + dir + "/index";
+        ok = false;
+    }
+    stats->frames = frames;
+    stats->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return ok;
+}
+
+static bool read_index(const std::string& dir, uint64_t key, std::vector<checkpoint>* checkpoints, std::string* error)
+{
+    std::string name = dir + "/index";
+    FILE* in = fopen(name.c_str(), "r");
+    if (!in)
+    {
+        *error = "cannot open " + name;
+        return false;
+    }
+    char magic[sizeof(index_magic)] = {0};
+    unsigned long long logged_key = 0;
+    bool ok = fread(magic, sizeof(magic) - 1, 1, in) == 1 && strcmp(magic, index_magic) == 0 &&
+              fscanf(in, " %llx", &logged_key) == 1;
+    unsigned long long frame, cycle, event, hash;
+    while (ok && fscanf(in, "%llu %llu %llu %llx", &frame, &cycle, &event, &hash) == 4)
+    {
+        checkpoints->push_back({frame, cycle, event, hash});
+    }
+    fclose(in);
+    if (!ok || checkpoints->size() < 2)
+    {
+        *error = name + " is not a checkpoint index";
+        return false;
+    }
+    if (logged_key != key)
+    {
+        *error = "the checkpoints in " + dir + " were taken with another rom or session";
+        return false;
+    }
+    return true;
+}
+
+// cpu time of the calling thread, which a busy machine does not inflate the way wall time is
+static double thread_seconds()
+{
+    timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// from the checkpoint at from up to the cycle of to, then the state hash there
+static void run_segment(i8080* cpu, machine_state* state, state_hasher* hasher, const session& recorded,
+                        const std::string& dir, uint64_t key, const checkpoint& from, const checkpoint& to,
+                        replay_segment* segment)
+{
+    double start = thread_seconds();
+    segment->first_frame = from.frame;
+    segment->last_frame = to.frame;
+    segment->expected_hash = to.hash;
+    std::string name = checkpoint_name(dir, from.frame);
+    if (!read_state_file(name.c_str(), key, state))
+    {
+        segment->error = "cannot read " + name;
+        return;
+    }
+    cpu->load_state(*state);
+
+    size_t next = std::min<uint64_t>(from.event, recorded.events.size());
+    while (cpu->clock_count < to.cycle)
+    {
+        apply_due(cpu, recorded, &next);
+        cpu->run_half_frame();
+    }
+    hasher->reset();
+    segment->hash = hasher->hash(cpu, ~0ull).state;
+    segment->seconds = thread_seconds() - start;
+}
+
+bool verify_session(const char* rom_name, const session& recorded, const replay_options& options,
+                    std::string* error, std::vector<replay_segment>* segments)
+{
+    std::unique_ptr<i8080> loaded(new i8080);
+    if (!loaded->load_rom_or_set(rom_name, error))
+    {
+        return false;
+    }
+    // the machines start from the checkpoints, the rom is only needed for the key
+    uint64_t key = checkpoint_key(*loaded, recorded);
+    loaded.reset();
+    std::vector<checkpoint> checkpoints;
+    if (!read_index(options.checkpoint_dir, key, &checkpoints, error))
+    {
+        return false;
+    }
+
+    segments->assign(checkpoints.size() - 1, replay_segment());
+    unsigned jobs = options.jobs ? options.jobs : std::max(1u, std::thread::hardware_concurrency());
+    jobs = std::min<size_t>(jobs, segments->size());
+
+    // segments are about the same length, but a thread that finishes early still takes the next one
+    std::atomic<size_t> next(0);
+    auto worker = [&]()
+    {
+        std::unique_ptr<i8080> cpu(new i8080);
+        std::unique_ptr<machine_state> state(new machine_state);
+        state_hasher hasher;
+        for (size_t i = next++; i < segments->size(); i = next++)
+        {
+            run_segment(cpu.get(), state.get(), &hasher, recorded, options.checkpoint_dir, key,
+                        checkpoints[i], checkpoints[i + 1], &(*segments)[i]);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned i = 1; i < jobs; ++i)
+    {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+    return true;
+}
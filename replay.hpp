@@ -0,0 +1,54 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include "session.hpp"
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+struct replay_options
+{
+    unsigned jobs = 0; // 0 uses every core
+    // frames between checkpoints
+    uint32_t interval = 3600;
+    // where the reference run writes its checkpoints and a verification reads them
+    std::string checkpoint_dir;
+};
+
+// one stretch between two checkpoints of a verification
+struct replay_segment
+{
+    uint64_t first_frame = 0;
+    uint64_t last_frame = 0;
+    uint64_t expected_hash = 0;
+    uint64_t hash = 0;
+    // empty when the segment ran, else why it could not start
+    std::string error;
+    // cpu time, summed over the segments it is what a serial replay would take
+    double seconds = 0;
+
+    bool matched() const { return error.empty() && hash == expected_hash; }
+};
+
+struct replay_stats
+{
+    uint64_t frames = 0;
+    uint64_t checkpoints = 0;
+    uint64_t end_hash = 0;
+    double seconds = 0;
+};
+
+// plays the session from reset on one thread and checks that it ends in the recorded state. with a
+// checkpoint dir, the machine is saved there every interval frames along with the state hash it has,
+// the reference a verification splits the replay at. false with the reason in error if the rom
+// cannot be loaded or the checkpoints cannot be written, a replay that ends elsewhere is not an error
+bool replay_session(const char* rom_name, const session& recorded, const replay_options& options,
+                    std::string* error, replay_stats* stats);
+
+// the same replay cut into the segments between the reference run's checkpoints, run concurrently on
+// a pool of threads. each segment starts from the checkpoint at its first frame and must end in the
+// state hash the reference run had at the next one. segments are in order
+bool verify_session(const char* rom_name, const session& recorded, const replay_options& options,
+                    std::string* error, std::vector<replay_segment>* segments);
+
+#endif
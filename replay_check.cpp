@@ -0,0 +1,123 @@
+#include "replay.hpp"
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+// g++ -O2 -pthread replay_check.cpp replay.cpp session.cpp state_hash.cpp framebuffer.cpp snapshot.cpp input.cpp mapped_file.cpp rom_set.cpp -o replay_check
+// ./replay_check invaders.set
+static void usage()
+{
+    fprintf(stderr,
+        "usage: replay_check rom\n"
+        "  records checkpoints of a few sessions with events around the checkpoints, verifies them from\n"
+        "  those checkpoints and exits 2 if any segment ends elsewhere than the reference run did\n");
+}
+
+struct check_case
+{
+    const char* name;
+    uint32_t interval;
+    session recorded;
+};
+
+static void press(session* recorded, uint64_t cycle, button pressed_button, bool pressed)
+{
+    recorded->events.push_back({0, cycle, (uint8_t)pressed_button, (uint8_t)pressed});
+}
+
+static std::vector<check_case> check_cases()
+{
+    std::vector<check_case> cases;
+
+    // a coin dropped in the half frame that ends at the frame 100 checkpoint, still pending when it is saved
+    check_case pending = {"event pending at a checkpoint", 100, session()};
+    press(&pending.recorded, 3333100, button_coin, true);
+    press(&pending.recorded, 3500000, button_coin, false);
+    pending.recorded.end_cycle = 20000000;
+    cases.push_back(pending);
+
+    // events every 16001 cycles drift across every half frame boundary, so every checkpoint has some pending
+    check_case dense = {"events in every half frame", 25, session()};
+    const button buttons[] = {button_coin, button_p1_start, button_p1_left, button_p1_fire, button_p1_right};
+    for (uint64_t i = 0; i < 1200; ++i)
+    {
+        press(&dense.recorded, 100000 + i * 16001, buttons[i / 2 % 5], i % 2 == 0);
+    }
+    dense.recorded.end_cycle = 20000000;
+    cases.push_back(dense);
+    return cases;
+}
+
+static void remove_dir(const std::string& path)
+{
+    if (DIR* dir = opendir(path.c_str()))
+    {
+        while (dirent* entry = readdir(dir))
+        {
+            if (entry->d_name[0] != '.')
+            {
+                unlink((path + "/" + entry->d_name).c_str());
+            }
+        }
+        closedir(dir);
+    }
+    rmdir(path.c_str());
+}
+
+int main(int argc, char** argv)
+{
+    if (argc != 2)
+    {
+        usage();
+        return 1;
+    }
+    const char* rom_name = argv[1];
+
+    int failed = 0;
+    for (check_case& check : check_cases())
+    {
+        char dir[] = "/tmp/replay_check.XXXXXX";
+        if (!mkdtemp(dir))
+        {
+            fprintf(stderr, "replay_check: cannot make a checkpoint directory\n");
+            return 1;
+        }
+        replay_options options;
+        options.interval = check.interval;
+        options.checkpoint_dir = dir;
+
+        // the reference run's own end state, the check is whether the segments agree with it
+        std::string error;
+        replay_stats stats;
+        std::vector<replay_segment> segments;
+        bool ok = replay_session(rom_name, check.recorded, options, &error, &stats);
+        check.recorded.end_hash = stats.end_hash;
+        ok = ok && verify_session(rom_name, check.recorded, options, &error, &segments);
+        remove_dir(dir);
+        if (!ok)
+        {
+            fprintf(stderr, "replay_check: %s\n", error.c_str());
+            return 1;
+        }
+
+        size_t differ = 0;
+        for (const replay_segment& segment : segments)
+        {
+            if (!segment.matched())
+            {
+                ++differ;
+                fprintf(stderr, "%s: frames %llu to %llu end in state %016llx, the reference in %016llx%s%s\n",
+                        check.name, (unsigned long long)segment.first_frame, (unsigned long long)segment.last_frame,
+                        (unsigned long long)segment.hash, (unsigned long long)segment.expected_hash,
+                        segment.error.empty() ? "" : ", ", segment.error.c_str());
+            }
+        }
+        fprintf(stderr, "%s: %zu events, %zu segments, %zu differ\n", check.name, check.recorded.events.size(),
+                segments.size(), differ);
+        failed += differ != 0;
+    }
+    return failed ? 2 : 0;
+}
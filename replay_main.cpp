@@ -0,0 +1,133 @@
+#include "replay.hpp"
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// g++ -O2 -pthread replay_main.cpp replay.cpp session.cpp state_hash.cpp framebuffer.cpp snapshot.cpp input.cpp mapped_file.cpp rom_set.cpp -o replay
+// ./intel-8080 --record run.session invaders.set
+// ./replay -c checkpoints invaders.set run.session
+// ./replay -v checkpoints invaders.set run.session
+static void usage()
+{
+    fprintf(stderr,
+        "usage: replay [-c dir] [-i frames] rom session\n"
+        "  session    a run recorded with intel-8080 --record, played back from reset on one thread and\n"
+        "             checked against the state it was recorded to end in\n"
+        "  -c dir     save the machine into dir every -i frames, the reference -v splits the replay at\n"
+        "  -i frames  frames between checkpoints, 3600 (a minute) by default\n"
+        "       replay [-j jobs] -v dir rom session\n"
+        "  -v dir     run the stretches between the checkpoints in dir concurrently, each from its first\n"
+        "             checkpoint, and check each ends in the state the reference run had there\n"
+        "  -j jobs    worker threads, defaults to the number of cores\n");
+}
+
+int main(int argc, char** argv)
+{
+    replay_options options;
+    const char* rom_name = nullptr;
+    const char* session_name = nullptr;
+    bool verify = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+        {
+            options.jobs = strtoul(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "-i") == 0 && i + 1 < argc)
+        {
+            options.interval = strtoul(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc)
+        {
+            options.checkpoint_dir = argv[++i];
+        }
+        else if (strcmp(argv[i], "-v") == 0 && i + 1 < argc)
+        {
+            options.checkpoint_dir = argv[++i];
+            verify = true;
+        }
+        else if (!rom_name)
+        {
+            rom_name = argv[i];
+        }
+        else if (!session_name)
+        {
+            session_name = argv[i];
+        }
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+    if (!rom_name || !session_name || options.interval == 0)
+    {
+        usage();
+        return 1;
+    }
+
+    session recorded;
+    if (!read_session(session_name, &recorded))
+    {
+        fprintf(stderr, "replay: cannot read %s\n", session_name);
+        return 1;
+    }
+    std::string error;
+
+    if (!verify)
+    {
+        replay_stats stats;
+        if (!replay_session(rom_name, recorded, options, &error, &stats))
+        {
+            fprintf(stderr, "replay: %s\n", error.c_str());
+            return 1;
+        }
+        fprintf(stderr, "%llu frames in %.2f s, %.0f frames/s, %llu checkpoints\n", (unsigned long long)stats.frames,
+                stats.seconds, stats.frames / stats.seconds, (unsigned long long)stats.checkpoints);
+        if (stats.end_hash != recorded.end_hash)
+        {
+            fprintf(stderr, "replay ends in state %016llx, the recording in %016llx\n",
+                    (unsigned long long)stats.end_hash, (unsigned long long)recorded.end_hash);
+            return 2;
+        }
+        fprintf(stderr, "replay ends in the recorded state %016llx\n", (unsigned long long)stats.end_hash);
+        return 0;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<replay_segment> segments;
+    if (!verify_session(rom_name, recorded, options, &error, &segments))
+    {
+        fprintf(stderr, "replay: %s\n", error.c_str());
+        return 1;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    size_t failed = 0;
+    double replayed = 0;
+    for (const replay_segment& segment : segments)
+    {
+        replayed += segment.seconds;
+        if (segment.matched())
+        {
+            continue;
+        }
+        ++failed;
+        if (!segment.error.empty())
+        {
+            fprintf(stderr, "frames %llu to %llu: %s\n", (unsigned long long)segment.first_frame,
+                    (unsigned long long)segment.last_frame, segment.error.c_str());
+        }
+        else
+        {
+            fprintf(stderr, "frames %llu to %llu: ends in state %016llx, the reference in %016llx\n",
+                    (unsigned long long)segment.first_frame, (unsigned long long)segment.last_frame,
+                    (unsigned long long)segment.hash, (unsigned long long)segment.expected_hash);
+        }
+    }
+    fprintf(stderr, "%zu segments, %zu differ, %.2f s for %.2f s of serial replay (%.1fx)\n",
+            segments.size(), failed, seconds, replayed, seconds ? replayed / seconds : 0.0);
+    return failed ? 2 : 0;
+}
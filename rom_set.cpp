@@ -0,0 +1,168 @@
+#include "rom_set.hpp"
+#include "mapped_file.hpp"
+#include <stdio.h>
+#include <string.h>
+
+struct crc_tables
+{
+    uint32_t table[8][256];
+
+    crc_tables()
+    {
+        for (uint32_t i = 0; i < 256; ++i)
+        {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; ++bit)
+            {
+                crc = crc & 1 ? (crc >> 1) ^ 0xedb88320 : crc >> 1;
+            }
+            table[0][i] = crc;
+        }
+        // table[k][i] is the crc of byte i followed by k zero bytes
+        for (int k = 1; k < 8; ++k)
+        {
+            for (uint32_t i = 0; i < 256; ++i)
+            {
+                table[k][i] = (table[k - 1][i] >> 8) ^ table[0][table[k - 1][i] & 0xff];
+            }
+        }
+    }
+};
+
+uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc)
+{
+    static const crc_tables tables;
+    const uint32_t (*t)[256] = tables.table;
+    crc = ~crc;
+    // little endian loads, the low byte of one is the first byte of the block
+    while (size >= 8)
+    {
+        uint32_t one, two;
+        memcpy(&one, data, 4);
+        memcpy(&two, data + 4, 4);
+        one ^= crc;
+        crc = t[7][one & 0xff] ^ t[6][(one >> 8) & 0xff] ^ t[5][(one >> 16) & 0xff] ^ t[4][one >> 24] ^
+              t[3][two & 0xff] ^ t[2][(two >> 8) & 0xff] ^ t[1][(two >> 16) & 0xff] ^ t[0][two >> 24];
+        data += 8;
+        size -= 8;
+    }
+    while (size--)
+    {
+        crc = t[0][(crc ^ *data++) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+bool is_rom_set(const char* file_name)
+{
+    size_t length = strlen(file_name);
+    return length > 4 && strcmp(file_name + length - 4, ".set") == 0;
+}
+
+bool read_rom_set(const char* manifest_name, std::vector<rom_image>* images, std::string* error)
+{
+    FILE* in = fopen(manifest_name, "r");
+    if (!in)
+    {
+        *error = std::string("cannot open ") + manifest_name;
+        return false;
+    }
+    std::string dir = manifest_name;
+    size_t slash = dir.find_last_of('/');
+    dir = slash == std::string::npos ? "" : dir.substr(0, slash + 1);
+
+    images->clear();
+    char line[512];
+    int number = 0;
+    bool ok = true;
+    while (ok && fgets(line, sizeof(line), in))
+    {
+        ++number;
+        char* comment = strchr(line, '#');
+        if (comment)
+        {
+            *comment = 0;
+        }
+        char path[256];
+        rom_image image;
+        int fields = sscanf(line, "%255s %x %x %x", path, &image.base, &image.size, &image.crc);
+        if (fields <= 0)
+        {
+            continue;
+        }
+        if (fields != 4)
+        {
+            *error = std::string(manifest_name) + ":" + std::to_string(number) + ": expected file base size crc32";
+            ok = false;
+            break;
+        }
+        image.path = path[0] == '/' ? path : dir + path;
+        images->push_back(image);
+    }
+    fclose(in);
+    if (ok && images->empty())
+    {
+        *error = std::string(manifest_name) + ": no images listed";
+        ok = false;
+    }
+    return ok;
+}
+
+bool load_rom_set(const char* manifest_name, uint8_t* rom, size_t rom_size, std::string* error)
+{
+    std::vector<rom_image> images;
+    if (!read_rom_set(manifest_name, &images, error))
+    {
+        return false;
+    }
+
+    // every check that needs no file data comes first, so a bad manifest fails before anything is mapped
+    char text[128];
+    std::vector<bool> used(rom_size);
+    for (const rom_image& image : images)
+    {
+        if ((size_t)image.base + image.size > rom_size)
+        {
+            snprintf(text, sizeof(text), ": $%x bytes at $%04x run past the end of rom", image.size, image.base);
+            *error = image.path + text;
+            return false;
+        }
+        for (uint32_t address = image.base; address < image.base + image.size; ++address)
+        {
+            if (used[address])
+            {
+                *error = image.path + ": overlaps another image";
+                return false;
+            }
+            used[address] = true;
+        }
+    }
+
+    for (const rom_image& image : images)
+    {
+        mapped_file file;
+        if (!map_file(image.path.c_str(), &file))
+        {
+            *error = image.path + ": cannot open";
+            return false;
+        }
+        if (file.size != image.size)
+        {
+            snprintf(text, sizeof(text), ": %zu bytes, the manifest says %u", file.size, image.size);
+            *error = image.path + text;
+            unmap_file(&file);
+            return false;
+        }
+        uint32_t crc = crc32(file.data, file.size);
+        if (crc != image.crc)
+        {
+            snprintf(text, sizeof(text), ": crc32 %08x, the manifest says %08x, bad dump", crc, image.crc);
+            *error = image.path + text;
+            unmap_file(&file);
+            return false;
+        }
+        memcpy(rom + image.base, file.data, file.size);
+        unmap_file(&file);
+    }
+    return true;
+}
@@ -0,0 +1,32 @@
+#ifndef ROM_SET_H
+#define ROM_SET_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// one image of a rom set, as a line of the manifest lists it
+struct rom_image
+{
+    std::string path;
+    uint32_t base;
+    uint32_t size;
+    uint32_t crc;
+};
+
+// true for names ending in .set, the extension rom set manifests use
+bool is_rom_set(const char* file_name);
+
+// reads a manifest, lines of "file base size crc32" in hex with # comments.
+// paths are taken relative to the directory of the manifest
+bool read_rom_set(const char* manifest_name, std::vector<rom_image>* images, std::string* error);
+
+// maps every image, checks its size and crc and places it at its base in rom. stops at the first
+// image that is missing, the wrong size, outside rom, over another image or a bad dump, and says which
+bool load_rom_set(const char* manifest_name, uint8_t* rom, size_t rom_size, std::string* error);
+
+// crc-32 as zip and mame use it, eight bytes per step through eight tables
+uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc = 0);
+
+#endif
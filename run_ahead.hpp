@@ -0,0 +1,77 @@
+#ifndef RUN_AHEAD_H
+#define RUN_AHEAD_H
+
+#include "cpu.hpp"
+#include "framebuffer.hpp"
+#include <chrono>
+#include <memory>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+// shows the frame the game will draw frames from now instead of the current one, which hides that many
+// frames of the game's own input lag. at every presented frame the machine is saved, run ahead with the
+// current inputs, its vram taken, and put back. saving and putting back copy only the ram pages written
+// since the last time, tracked by the core in dirty_pages.
+// the observer is told through on_speculation, so the debugger never stops in a frame that is undone
+template<typename cpu_type>
+class run_ahead
+{
+public:
+    // frames is how far ahead to run, the cpu must be at the end of a frame
+    run_ahead(cpu_type* cpu, int frames)
+        : saved(new cpu_type), frames(frames)
+    {
+        // through a machine_state, observers such as the debugger cannot be copied
+        std::unique_ptr<machine_state> state(new machine_state);
+        cpu->save_state(state.get());
+        saved->load_state(*state);
+        saved->dirty_pages = 0;
+        cpu->dirty_pages = 0;
+    }
+
+    // call at the end of a real frame. runs ahead, copies the vram of the last frame into out and
+    // leaves cpu exactly as it was
+    void present(cpu_type* cpu, uint8_t* out)
+    {
+        auto start = std::chrono::steady_clock::now();
+        // bring the copy up to the real frame, the pages it lacks are the ones the cpu wrote since
+        saved->dirty_pages = cpu->dirty_pages;
+        saved->restore(*cpu);
+        cpu->dirty_pages = 0;
+
+        cpu->observer.on_speculation(true);
+        for (int i = 0; i < frames; ++i)
+        {
+            cpu->run_half_frame();
+            cpu->run_half_frame();
+        }
+        cpu->observer.on_speculation(false);
+        memcpy(out, cpu->vram(), vram_size);
+        cpu->restore(*saved);
+
+        seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        ++presented;
+    }
+
+    // time spent ahead per presented frame against the frame period, and the lag hidden
+    void report(FILE* out, double speed = 1.0) const
+    {
+        if (presented == 0)
+        {
+            return;
+        }
+        double frame_ms = 1000.0 / 60.0 / speed;
+        double ms = 1000.0 * seconds / presented;
+        fprintf(out, "run-ahead %d frames: %.3f ms per presented frame, %.1f%% of the %.2f ms frame, %.1f ms of input lag hidden\n",
+                frames, ms, 100.0 * ms / frame_ms, frame_ms, frames * frame_ms);
+    }
+
+private:
+    std::unique_ptr<cpu_type> saved;
+    int frames;
+    double seconds = 0;
+    uint64_t presented = 0;
+};
+
+#endif
@@ -0,0 +1,49 @@
+#include "session.hpp"
+#include <stdio.h>
+#include <string.h>
+
+static const char session_magic[] = "i8080 session 1";
+
+bool write_session(const char* file_name, const session& recorded)
+{
+    FILE* out = fopen(file_name, "w");
+    if (!out)
+    {
+        return false;
+    }
+    bool ok = fprintf(out, "%s\nend %llu %016llx\n", session_magic, (unsigned long long)recorded.end_cycle,
+                      (unsigned long long)recorded.end_hash) > 0;
+    for (const button_event& event : recorded.events)
+    {
+        ok = ok && fprintf(out, "%llu %u %u\n", (unsigned long long)event.cycle, event.button, event.pressed) > 0;
+    }
+    return fclose(out) == 0 && ok;
+}
+
+bool read_session(const char* file_name, session* recorded)
+{
+    FILE* in = fopen(file_name, "r");
+    if (!in)
+    {
+        return false;
+    }
+    char line[64];
+    unsigned long long cycle = 0, hash = 0;
+    bool ok = fgets(line, sizeof(line), in) && strncmp(line, session_magic, strlen(session_magic)) == 0 &&
+              fscanf(in, " end %llu %llx", &cycle, &hash) == 2;
+    recorded->end_cycle = cycle;
+    recorded->end_hash = hash;
+    recorded->events.clear();
+
+    unsigned button, pressed;
+    while (ok && fscanf(in, "%llu %u %u", &cycle, &button, &pressed) == 3)
+    {
+        // sorted by cycle, the replay walks them in order
+        ok = button < button_count && cycle <= recorded->end_cycle &&
+             (recorded->events.empty() || cycle >= recorded->events.back().cycle);
+        recorded->events.push_back({0, cycle, (uint8_t)button, (uint8_t)pressed});
+    }
+    ok = ok && feof(in);
+    fclose(in);
+    return ok;
+}
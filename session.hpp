@@ -0,0 +1,22 @@
+#ifndef SESSION_H
+#define SESSION_H
+
+#include "input.hpp"
+#include <stdint.h>
+#include <vector>
+
+// a recorded run, every input event with the cycle it reached the ports at. the core is deterministic,
+// so playing the events back from reset at the same cycles reproduces the run exactly, see replay.hpp
+struct session
+{
+    std::vector<button_event> events;
+    // where the run stopped, and its state hash there (state_hasher) for the replay to match
+    uint64_t end_cycle = 0;
+    uint64_t end_hash = 0;
+};
+
+// text, a header line, "end cycle hash", then one "cycle button pressed" line per event
+bool write_session(const char* file_name, const session& recorded);
+bool read_session(const char* file_name, session* recorded);
+
+#endif
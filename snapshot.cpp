@@ -0,0 +1,74 @@
+#include "snapshot.hpp"
+#include "cpu.hpp"
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+struct state_header
+{
+    char magic[8];
+    uint32_t state_size;
+    uint32_t reserved;
+    uint64_t key;
+};
+
+static const char state_magic[8] = {'i', '8', '0', '8', '0', 's', 't', '1'};
+
+uint64_t hash_bytes(const uint8_t* data, size_t size, uint64_t seed)
+{
+    uint64_t hash = seed;
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash = (hash ^ data[i]) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+bool write_state_file(const char* file_name, uint64_t key, const machine_state& state)
+{
+    state_header header = {};
+    memcpy(header.magic, state_magic, sizeof(state_magic));
+    header.state_size = sizeof(machine_state);
+    header.key = key;
+
+    // written next to the target and renamed, so a parallel run never reads half a file
+    std::string temporary = std::string(file_name) + "." + std::to_string(getpid());
+    FILE* out = fopen(temporary.c_str(), "wb");
+    if (!out)
+    {
+        return false;
+    }
+    bool ok = fwrite(&header, sizeof(header), 1, out) == 1 && fwrite(&state, sizeof(state), 1, out) == 1;
+    ok = fclose(out) == 0 && ok;
+    if (!ok || rename(temporary.c_str(), file_name) != 0)
+    {
+        unlink(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool read_state_file(const char* file_name, uint64_t key, machine_state* state)
+{
+    FILE* in = fopen(file_name, "rb");
+    if (!in)
+    {
+        return false;
+    }
+    state_header header;
+    bool ok = fread(&header, sizeof(header), 1, in) == 1 &&
+              memcmp(header.magic, state_magic, sizeof(state_magic)) == 0 &&
+              header.state_size == sizeof(machine_state) && header.key == key &&
+              fread(state, sizeof(*state), 1, in) == 1;
+    fclose(in);
+    return ok;
+}
+
+std::string state_file_name(const char* dir, uint64_t key)
+{
+    mkdir(dir, 0755);
+    char name[32];
+    snprintf(name, sizeof(name), "/%016llx.state", (unsigned long long)key);
+    return dir + std::string(name);
+}
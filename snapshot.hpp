@@ -0,0 +1,21 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+struct machine_state;
+
+// 64 bit fnv-1a, names cached snapshots after the rom they were taken from
+uint64_t hash_bytes(const uint8_t* data, size_t size, uint64_t seed = 0xcbf29ce484222325ull);
+
+// a machine_state behind a small header. key says what the state belongs to, a file written for another
+// key, by another build with a different state layout, or cut short reads as a miss
+bool write_state_file(const char* file_name, uint64_t key, const machine_state& state);
+bool read_state_file(const char* file_name, uint64_t key, machine_state* state);
+
+// file in dir for key, the directory is created if needed
+std::string state_file_name(const char* dir, uint64_t key);
+
+#endif
@@ -0,0 +1,372 @@
+#include "sound.hpp"
+#include <math.h>
+#include <string.h>
+#include <string>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+size_t sound_ports::update(uint8_t port3, uint8_t port5, sound_event* events)
+{
+    size_t n = 0;
+    uint8_t rising3 = port3 & ~last3;
+    uint8_t rising5 = port5 & ~last5;
+    for (int bit = 0; bit < 5; ++bit)
+    {
+        if (rising3 >> bit & 1)
+        {
+            events[n++] = {(uint8_t)(sound_ufo + bit), 1};
+        }
+        if (rising5 >> bit & 1)
+        {
+            events[n++] = {(uint8_t)(sound_fleet_1 + bit), 1};
+        }
+    }
+    if ((last3 & ~port3) & 0x01)
+    {
+        events[n++] = {sound_ufo, 0};
+    }
+    last3 = port3;
+    last5 = port5;
+    return n;
+}
+
+// the synthesized sounds are square waves and sample and hold noise, the way the board's discrete
+// circuits make them
+static uint32_t noise_state = 0x12345678;
+
+static float noise()
+{
+    noise_state ^= noise_state << 13;
+    noise_state ^= noise_state >> 17;
+    noise_state ^= noise_state << 5;
+    return (noise_state & 0xffff) / 32768.0f - 1.0f;
+}
+
+static float square(double phase)
+{
+    return phase - floor(phase) < 0.5 ? 1.0f : -1.0f;
+}
+
+static std::vector<int16_t> synthesize(sound_id id, int rate)
+{
+    const double lengths[sound_count] = {0.25, 0.35, 1.2, 0.25, 0.6, 0.1, 0.1, 0.1, 0.1, 0.8};
+    size_t count = (size_t)(lengths[id] * rate);
+    std::vector<int16_t> samples(count);
+    double phase = 0;
+    float held = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        double t = (double)i / rate;
+        float value = 0;
+        switch (id)
+        {
+        case sound_ufo:
+            // 0.25 s is two periods of the warble, so the loop has no seam
+            phase += (450 + 120 * sin(2 * M_PI * 8 * t)) / rate;
+            value = 0.5f * square(phase);
+            break;
+        case sound_shot:
+            // noise held longer and longer, a falling hiss
+            if (i % (1 + (size_t)(t * 40)) == 0)
+            {
+                held = noise();
+            }
+            value = held * (float)exp(-t * 9);
+            break;
+        case sound_player_die:
+            if (i % 6 == 0)
+            {
+                held = noise();
+            }
+            value = held * (float)exp(-t * 2.5);
+            break;
+        case sound_invader_die:
+            if (i % 3 == 0)
+            {
+                held = noise();
+            }
+            value = held * (float)exp(-t * 14);
+            break;
+        case sound_extra_life:
+            // three beeps
+            phase += 1200.0 / rate;
+            value = fmod(t, 0.2) < 0.12 ? 0.4f * square(phase) : 0.0f;
+            break;
+        case sound_fleet_1:
+        case sound_fleet_2:
+        case sound_fleet_3:
+        case sound_fleet_4:
+        {
+            const double notes[4] = {98.0, 87.3, 77.8, 73.4};
+            phase += notes[id - sound_fleet_1] / rate;
+            value = 0.7f * square(phase) * (float)exp(-t * 25);
+            break;
+        }
+        case sound_ufo_hit:
+            phase += (900 + 500 * sin(2 * M_PI * 14 * t)) / rate;
+            value = 0.45f * square(phase) * (float)(1 - t / lengths[id]);
+            break;
+        default:
+            break;
+        }
+        // about a third of full scale, so a few voices at once rarely saturate
+        samples[i] = (int16_t)(value * 11000);
+    }
+    return samples;
+}
+
+sound_mixer::sound_mixer(int rate)
+    : sample_rate(rate)
+{
+    for (int id = 0; id < sound_count; ++id)
+    {
+        samples[id] = synthesize((sound_id)id, rate);
+        lengths[id] = samples[id].size();
+        samples[id].resize((lengths[id] + 7) & ~(size_t)7);
+        voices[id] = {0, false, id == sound_ufo};
+    }
+}
+
+static uint32_t read_u32(const uint8_t* p)
+{
+    return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+// pcm wav resampled to rate, empty if the file is not one
+static std::vector<int16_t> read_wav(const char* file_name, int rate)
+{
+    std::vector<int16_t> result;
+    FILE* in = fopen(file_name, "rb");
+    if (!in)
+    {
+        return result;
+    }
+    std::vector<uint8_t> file;
+    uint8_t buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), in)) > 0)
+    {
+        file.insert(file.end(), buffer, buffer + n);
+    }
+    fclose(in);
+    if (file.size() < 12 || memcmp(file.data(), "RIFF", 4) != 0 || memcmp(file.data() + 8, "WAVE", 4) != 0)
+    {
+        return result;
+    }
+
+    int channels = 0;
+    int bits = 0;
+    uint32_t source_rate = 0;
+    const uint8_t* data = nullptr;
+    uint32_t data_size = 0;
+    for (size_t at = 12; at + 8 <= file.size();)
+    {
+        uint32_t size = read_u32(&file[at + 4]);
+        if (at + 8 + size > file.size())
+        {
+            size = file.size() - at - 8;
+        }
+        if (memcmp(&file[at], "fmt ", 4) == 0 && size >= 16 && (file[at + 8] | file[at + 9] << 8) == 1)
+        {
+            channels = file[at + 10] | file[at + 11] << 8;
+            source_rate = read_u32(&file[at + 12]);
+            bits = file[at + 22] | file[at + 23] << 8;
+        }
+        else if (memcmp(&file[at], "data", 4) == 0)
+        {
+            data = &file[at + 8];
+            data_size = size;
+        }
+        at += 8 + size + (size & 1);
+    }
+    if (!data || channels < 1 || source_rate == 0 || (bits != 8 && bits != 16))
+    {
+        return result;
+    }
+
+    size_t frame_bytes = channels * bits / 8;
+    size_t frames = data_size / frame_bytes;
+    std::vector<int16_t> source(frames);
+    for (size_t i = 0; i < frames; ++i)
+    {
+        const uint8_t* p = data + i * frame_bytes;
+        source[i] = bits == 8 ? (int16_t)((p[0] - 128) << 8) : (int16_t)(p[0] | p[1] << 8);
+    }
+    if (frames == 0)
+    {
+        return result;
+    }
+
+    // linear interpolation, the board's samples are low rate and short
+    size_t count = (size_t)((double)frames * rate / source_rate);
+    result.resize(count);
+    double step = (double)source_rate / rate;
+    for (size_t i = 0; i < count; ++i)
+    {
+        double at = i * step;
+        size_t index = (size_t)at;
+        double fraction = at - index;
+        int16_t next = index + 1 < frames ? source[index + 1] : source[index];
+        result[i] = (int16_t)(source[index] + (next - source[index]) * fraction);
+    }
+    return result;
+}
+
+int sound_mixer::load_samples(const char* dir)
+{
+    int loaded = 0;
+    for (int id = 0; id < sound_count; ++id)
+    {
+        std::vector<int16_t> sample = read_wav((std::string(dir) + "/" + std::to_string(id) + ".wav").c_str(), sample_rate);
+        if (sample.empty())
+        {
+            continue;
+        }
+        samples[id] = sample;
+        lengths[id] = sample.size();
+        samples[id].resize((lengths[id] + 7) & ~(size_t)7);
+        ++loaded;
+    }
+    return loaded;
+}
+
+void sound_mixer::trigger(const sound_event& event)
+{
+    if (event.sound >= sound_count)
+    {
+        return;
+    }
+    voice& v = voices[event.sound];
+    v.active = event.start;
+    v.position = 0;
+}
+
+void sound_mixer::mix(int16_t* out, size_t count)
+{
+    memset(out, 0, count * sizeof(int16_t));
+    for (int id = 0; id < sound_count; ++id)
+    {
+        voice& v = voices[id];
+        size_t done = 0;
+        while (v.active && done < count)
+        {
+            // a block of the voice up to the end of its sample or of out, whichever comes first
+            size_t n = std::min(count - done, lengths[id] - v.position);
+            const int16_t* in = samples[id].data() + v.position;
+            int16_t* to = out + done;
+            size_t i = 0;
+#if defined(__x86_64__) || defined(__i386__)
+            for (; i + 8 <= n; i += 8)
+            {
+                __m128i sum = _mm_adds_epi16(_mm_loadu_si128((const __m128i*)(to + i)), _mm_loadu_si128((const __m128i*)(in + i)));
+                _mm_storeu_si128((__m128i*)(to + i), sum);
+            }
+#endif
+            for (; i < n; ++i)
+            {
+                int sum = to[i] + in[i];
+                to[i] = (int16_t)(sum > 32767 ? 32767 : sum < -32768 ? -32768 : sum);
+            }
+            done += n;
+            v.position += n;
+            if (v.position == lengths[id])
+            {
+                v.position = 0;
+                v.active = v.repeat;
+            }
+        }
+    }
+}
+
+bool sound_output::open(sound_mixer* sound, int samples)
+{
+    mixer = sound;
+    SDL_AudioSpec want = {};
+    SDL_AudioSpec have;
+    want.freq = mixer->rate();
+    want.format = AUDIO_S16SYS;
+    want.channels = 1;
+    want.samples = samples;
+    want.callback = callback;
+    want.userdata = this;
+    // no changes allowed, the mixer only makes 16 bit mono at its own rate
+    device = SDL_OpenAudioDevice(nullptr, 0, &want, &have, 0);
+    if (!device)
+    {
+        return false;
+    }
+    buffer_samples = have.samples;
+    SDL_PauseAudioDevice(device, 0);
+    return true;
+}
+
+void sound_output::close()
+{
+    if (device)
+    {
+        SDL_CloseAudioDevice(device);
+        device = 0;
+    }
+}
+
+void sound_output::callback(void* self, uint8_t* stream, int bytes)
+{
+    sound_output* output = (sound_output*)self;
+    sound_event event;
+    while (output->events.pop(&event))
+    {
+        output->mixer->trigger(event);
+    }
+    output->mixer->mix((int16_t*)stream, bytes / sizeof(int16_t));
+}
+
+static void put_u32(uint8_t* p, uint32_t value)
+{
+    p[0] = value;
+    p[1] = value >> 8;
+    p[2] = value >> 16;
+    p[3] = value >> 24;
+}
+
+bool wav_writer::open(const char* file_name, int rate)
+{
+    out = fopen(file_name, "wb");
+    if (!out)
+    {
+        return false;
+    }
+    // sizes are patched in by close
+    uint8_t header[44] = {'R', 'I', 'F', 'F', 0, 0, 0, 0, 'W', 'A', 'V', 'E',
+                          'f', 'm', 't', ' ', 16, 0, 0, 0, 1, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 0, 16, 0,
+                          'd', 'a', 't', 'a', 0, 0, 0, 0};
+    put_u32(header + 24, rate);
+    put_u32(header + 28, rate * 2);
+    data_bytes = 0;
+    error = fwrite(header, sizeof(header), 1, out) != 1;
+    return !error;
+}
+
+void wav_writer::write(const int16_t* samples, size_t count)
+{
+    // wav is little endian, as is every host this builds for
+    error |= fwrite(samples, sizeof(int16_t), count, out) != count;
+    data_bytes += count * sizeof(int16_t);
+}
+
+bool wav_writer::close()
+{
+    if (!out)
+    {
+        return !error;
+    }
+    uint8_t size[4];
+    put_u32(size, 36 + data_bytes);
+    error |= fseek(out, 4, SEEK_SET) != 0 || fwrite(size, 4, 1, out) != 1;
+    put_u32(size, data_bytes);
+    error |= fseek(out, 40, SEEK_SET) != 0 || fwrite(size, 4, 1, out) != 1;
+    error |= fclose(out) != 0;
+    out = nullptr;
+    return !error;
+}
@@ -0,0 +1,123 @@
+#ifndef SOUND_H
+#define SOUND_H
+
+#include "spsc_ring.hpp"
+#include <SDL2/SDL.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+
+// the sounds of the board, in the order of the samples mame names 0.wav to 9.wav
+enum sound_id : uint8_t
+{
+    sound_ufo,          // out 3 bit 0, repeats while the bit is set
+    sound_shot,         // out 3 bit 1
+    sound_player_die,   // out 3 bit 2
+    sound_invader_die,  // out 3 bit 3
+    sound_extra_life,   // out 3 bit 4
+    sound_fleet_1,      // out 5 bits 0 to 3, the four notes of the marching fleet
+    sound_fleet_2,
+    sound_fleet_3,
+    sound_fleet_4,
+    sound_ufo_hit,      // out 5 bit 4
+    sound_count,
+};
+
+struct sound_event
+{
+    uint8_t sound;
+    // 1 starts the sound, 0 stops it when it repeats
+    uint8_t start;
+};
+
+// turns the sound bits of out ports 3 and 5 into events. a sound starts when its bit goes up,
+// the ufo also stops when its bit goes down. call after every half frame, with the ports as the cpu left them
+class sound_ports
+{
+public:
+    // writes up to sound_count events into events, returns how many
+    size_t update(uint8_t port3, uint8_t port5, sound_event* events);
+
+private:
+    uint8_t last3 = 0;
+    uint8_t last5 = 0;
+};
+
+// plays the sounds into 16 bit mono, one voice per sound, a new start restarts it.
+// the sounds are synthesized when it is built unless load_samples finds wav files for them.
+// mix never allocates and adds the voices 8 samples at a time with saturating simd adds
+class sound_mixer
+{
+public:
+    explicit sound_mixer(int rate = 44100);
+
+    // replaces the synthesized sounds with dir/0.wav to dir/9.wav where they exist. pcm wav of any rate,
+    // 8 or 16 bit, the first channel is used. returns the number loaded
+    int load_samples(const char* dir);
+
+    void trigger(const sound_event& event);
+    void mix(int16_t* out, size_t count);
+
+    int rate() const { return sample_rate; }
+
+private:
+    struct voice
+    {
+        size_t position;
+        bool active;
+        bool repeat;
+    };
+
+    int sample_rate;
+    // padded with silence to a multiple of 8 so mix never reads a partial block
+    std::vector<int16_t> samples[sound_count];
+    size_t lengths[sound_count];
+    voice voices[sound_count];
+};
+
+// the mixer behind an sdl audio device. the cpu thread pushes events through a lock free ring and the
+// audio callback drains it before every buffer, so a sound starts at most one device buffer after its
+// half frame, 256 samples or 5.8 ms at 44.1 kHz
+class sound_output
+{
+public:
+    ~sound_output() { close(); }
+
+    // returns false if there is no audio device, the run goes on silent
+    bool open(sound_mixer* mixer, int buffer_samples = 256);
+    void close();
+
+    // cpu thread, events that do not fit are dropped
+    void push(const sound_event& event) { events.push(event); }
+
+    // samples in one device buffer, in ms
+    double buffer_ms() const { return device ? 1000.0 * buffer_samples / mixer->rate() : 0; }
+
+private:
+    static void callback(void* self, uint8_t* stream, int bytes);
+
+    spsc_ring<sound_event, 64> events;
+    sound_mixer* mixer = nullptr;
+    SDL_AudioDeviceID device = 0;
+    int buffer_samples = 0;
+};
+
+// 16 bit mono wav file, for listening to headless runs
+class wav_writer
+{
+public:
+    ~wav_writer() { close(); }
+
+    bool open(const char* file_name, int rate);
+    void write(const int16_t* samples, size_t count);
+    // patches the sizes into the header, returns false if anything failed to write
+    bool close();
+
+private:
+    FILE* out = nullptr;
+    uint32_t data_bytes = 0;
+    bool error = false;
+};
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <atomic>
+#include <stddef.h>
+
+// lock free single producer, single consumer queue of n items, n a power of two.
+// neither side ever waits, a push into a full ring fails and the caller decides what to drop
+template <typename T, size_t n>
+class spsc_ring
+{
+    static_assert((n & (n - 1)) == 0, "ring size must be a power of two");
+
+public:
+    // producer
+    bool push(const T& item)
+    {
+        size_t write = write_index.load(std::memory_order_relaxed);
+        if (write - read_index.load(std::memory_order_acquire) == n)
+        {
+            return false;
+        }
+        items[write & (n - 1)] = item;
+        write_index.store(write + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer, false when there is nothing to take
+    bool pop(T* item)
+    {
+        size_t read = read_index.load(std::memory_order_relaxed);
+        if (read == write_index.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+        *item = items[read & (n - 1)];
+        read_index.store(read + 1, std::memory_order_release);
+        return true;
+    }
+
+    // in place forms of push and pop for items too big to copy twice. the producer fills the slot
+    // claim returns, null when the ring is full, and publishes it. the consumer reads the item front
+    // returns, null when there is none, and releases it
+    T* claim()
+    {
+        size_t write = write_index.load(std::memory_order_relaxed);
+        return write - read_index.load(std::memory_order_acquire) == n ? nullptr : &items[write & (n - 1)];
+    }
+
+    void publish()
+    {
+        write_index.store(write_index.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    const T* front()
+    {
+        size_t read = read_index.load(std::memory_order_relaxed);
+        return read == write_index.load(std::memory_order_acquire) ? nullptr : &items[read & (n - 1)];
+    }
+
+    void release()
+    {
+        read_index.store(read_index.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+private:
+    T items[n];
+    // each index on a cache line of its own, the two sides write one each
+    alignas(64) std::atomic<size_t> write_index{0};
+    alignas(64) std::atomic<size_t> read_index{0};
+};
+
+#endif
@@ -0,0 +1,299 @@
+#include "state_hash.hpp"
+#include "framebuffer.hpp"
+#include <chrono>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+/*
+a page is hashed the way xxh3 hashes its long inputs: four 64 bit lanes take 32 bytes at a time, each
+lane adds the product of the low and high halves of its word xored with a key, plus the word of its
+neighbour, so every input bit reaches the accumulators. the lanes are folded into one hash at the end.
+avx2 does the four lanes in one register, the scalar path one lane at a time with the same arithmetic.
+*/
+
+static const int stripe_bytes = 32;
+static const int page_stripes = 256 / stripe_bytes;
+
+// splitmix64 from a fixed seed, one key per lane of every stripe of a page
+struct stripe_keys
+{
+    stripe_keys()
+    {
+        uint64_t x = 0x8080808080808080ull;
+        for (uint64_t& key : keys)
+        {
+            x += 0x9e3779b97f4a7c15ull;
+            uint64_t z = x;
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+            key = z ^ (z >> 31);
+        }
+    }
+
+    uint64_t keys[page_stripes * 4];
+};
+
+static const stripe_keys keys;
+static const uint64_t lanes_start[4] = {0x9e3779b185ebca87ull, 0xc2b2ae3d27d4eb4full, 0x165667b19e3779f9ull, 0x85ebca77c2b2ae63ull};
+
+static uint64_t mix(uint64_t x)
+{
+    x = (x ^ (x >> 33)) * 0xff51afd7ed558ccdull;
+    x = (x ^ (x >> 33)) * 0xc4ceb9fe1a85ec53ull;
+    return x ^ (x >> 33);
+}
+
+static uint64_t fold(const uint64_t* lanes)
+{
+    uint64_t hash = 0x27d4eb2f165667c5ull;
+    for (int i = 0; i < 4; ++i)
+    {
+        hash = (hash ^ mix(lanes[i])) * 0x9e3779b97f4a7c15ull;
+    }
+    return mix(hash);
+}
+
+static uint64_t hash_stripes_scalar(const uint8_t* data, int stripes)
+{
+    uint64_t lanes[4];
+    memcpy(lanes, lanes_start, sizeof(lanes));
+    for (int s = 0; s < stripes; ++s)
+    {
+        uint64_t words[4];
+        memcpy(words, data + s * stripe_bytes, sizeof(words));
+        for (int i = 0; i < 4; ++i)
+        {
+            uint64_t keyed = words[i] ^ keys.keys[s * 4 + i];
+            lanes[i] += (keyed & 0xffffffff) * (keyed >> 32) + words[i ^ 1];
+        }
+    }
+    return fold(lanes);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+__attribute__((target("avx2")))
+static uint64_t hash_stripes_avx2(const uint8_t* data, int stripes)
+{
+    __m256i lanes = _mm256_loadu_si256((const __m256i*)lanes_start);
+    for (int s = 0; s < stripes; ++s)
+    {
+        __m256i words = _mm256_loadu_si256((const __m256i*)(data + s * stripe_bytes));
+        __m256i keyed = _mm256_xor_si256(words, _mm256_loadu_si256((const __m256i*)(keys.keys + s * 4)));
+        __m256i product = _mm256_mul_epu32(keyed, _mm256_srli_epi64(keyed, 32));
+        // word i ^ 1 into lane i
+        __m256i neighbour = _mm256_shuffle_epi32(words, _MM_SHUFFLE(1, 0, 3, 2));
+        lanes = _mm256_add_epi64(lanes, _mm256_add_epi64(product, neighbour));
+    }
+    uint64_t folded[4];
+    _mm256_storeu_si256((__m256i*)folded, lanes);
+    return fold(folded);
+}
+
+#endif
+
+static uint64_t hash_stripes(const uint8_t* data, int stripes)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    static const bool avx2 = cpu_has_avx2();
+    if (avx2)
+    {
+        return hash_stripes_avx2(data, stripes);
+    }
+#endif
+    return hash_stripes_scalar(data, stripes);
+}
+
+uint64_t hash_page(const uint8_t* page)
+{
+    return hash_stripes(page, page_stripes);
+}
+
+uint64_t hash_page_scalar(const uint8_t* page)
+{
+    return hash_stripes_scalar(page, page_stripes);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+uint64_t hash_page_avx2(const uint8_t* page)
+{
+    return hash_stripes_avx2(page, page_stripes);
+}
+
+#endif
+
+void state_hasher::set_pages(const uint64_t* hashes)
+{
+    memcpy(page_hashes, hashes, sizeof(page_hashes));
+    primed = true;
+}
+
+frame_hashes state_hasher::hash_ram(const uint8_t* ram, uint64_t dirty)
+{
+    auto start = std::chrono::steady_clock::now();
+    if (!primed)
+    {
+        dirty = ~0ull;
+        primed = true;
+    }
+    for (uint64_t pages = dirty & ((1ull << ram_pages) - 1); pages; pages &= pages - 1)
+    {
+        int page = __builtin_ctzll(pages);
+        page_hashes[page] = hash_page(ram + page * 256);
+        ++pages_hashed;
+    }
+
+    frame_hashes hashes;
+    // vram is pages 4 to 31, their hashes are one page's worth short of 256 bytes
+    uint8_t block[256] = {0};
+    memcpy(block, page_hashes + 4, (ram_pages - 4) * sizeof(uint64_t));
+    hashes.vram = hash_page(block);
+
+    // two stripes of registers, packed so the padding of machine_registers stays out of it. the
+    // timeless hash takes what comes before the input ports and the clocks
+    const machine_registers& r = registers;
+    uint8_t packed[2 * stripe_bytes] = {0};
+    uint8_t* p = packed;
+    auto put = [&p](const void* field, size_t size) { memcpy(p, field, size); p += size; };
+    put(&r.pc, 2);
+    put(&r.sp, 2);
+    put(&r.a, 1);
+    put(&r.b, 1);
+    put(&r.c, 1);
+    put(&r.d, 1);
+    put(&r.e, 1);
+    put(&r.h, 1);
+    put(&r.l, 1);
+    put(&r.flags, 1);
+    put(&r.reg_shift, 2);
+    put(&r.shift_offset, 1);
+    put(r.out_port, sizeof(r.out_port));
+    put(&r.halt, 1);
+    put(&r.interrupts_enabled, 1);
+    put(&r.next_interrupt_id, 1);
+    // the byte at $4000, just past ram, that write_byte lets through
+    put(ram + ram_pages * 256, 1);
+    // how far off the next interrupt is rather than when
+    uint64_t next_interrupt_in = r.next_interrupt - r.clock_count;
+    put(&next_interrupt_in, 8);
+    uint8_t timeless[sizeof(packed)] = {0};
+    memcpy(timeless, packed, p - packed);
+    put(r.in_port, sizeof(r.in_port));
+    put(&r.clock_count, 8);
+    put(&r.instruction_count, 8);
+    put(&r.next_interrupt, 8);
+
+    uint64_t pages = hash_page((const uint8_t*)page_hashes);
+    hashes.state = mix(pages ^ hash_stripes(packed, 2) * 0x9e3779b97f4a7c15ull);
+    hashes.timeless = mix(pages ^ hash_stripes(timeless, 2) * 0xc2b2ae3d27d4eb4full);
+
+    ++frames;
+    seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return hashes;
+}
+
+hash_log::~hash_log()
+{
+    if (file)
+    {
+        fclose(file);
+    }
+}
+
+bool hash_log::create(const char* file_name)
+{
+    name = file_name;
+    checking = false;
+    file = fopen(file_name, "w");
+    return file != nullptr;
+}
+
+bool hash_log::open(const char* file_name)
+{
+    name = file_name;
+    checking = true;
+    file = fopen(file_name, "r");
+    return file != nullptr;
+}
+
+void hash_log::add(uint64_t frame, const frame_hashes& hashes)
+{
+    if (!checking)
+    {
+        error = error || fprintf(file, "%llu %016llx %016llx\n", (unsigned long long)frame,
+                                 (unsigned long long)hashes.vram, (unsigned long long)hashes.state) < 0;
+        return;
+    }
+    if (ended)
+    {
+        return;
+    }
+    unsigned long long logged_frame, vram, state;
+    if (fscanf(file, "%llu %llx %llx", &logged_frame, &vram, &state) != 3)
+    {
+        ended = true;
+        return;
+    }
+    // a line for another frame means the run and the log fell out of step, which is both
+    bool in_step = logged_frame == frame;
+    bool vram_differs = !in_step || vram != hashes.vram;
+    bool state_differs = !in_step || state != hashes.state;
+    if (!vram_differs && !state_differs)
+    {
+        return;
+    }
+    if (mismatches++ == 0)
+    {
+        first_mismatch = frame;
+        first_vram = vram_differs;
+        first_state = state_differs;
+    }
+}
+
+bool hash_log::close()
+{
+    unsigned long long logged_frame, vram, state;
+    while (file && checking && !ended && fscanf(file, "%llu %llx %llx", &logged_frame, &vram, &state) == 3)
+    {
+        ++unchecked;
+    }
+    if (file && fclose(file) != 0)
+    {
+        error = true;
+    }
+    file = nullptr;
+    return !error && !mismatches && !ended && !unchecked;
+}
+
+void hash_log::report(FILE* out) const
+{
+    uint64_t frames = hasher.frames;
+    if (!checking)
+    {
+        fprintf(out, "%llu frame hashes written to %s\n", (unsigned long long)frames, name);
+    }
+    else if (mismatches)
+    {
+        fprintf(out, "hash check failed, %llu of %llu frames differ from %s, the first at frame %llu in %s\n",
+                (unsigned long long)mismatches, (unsigned long long)frames, name, (unsigned long long)first_mismatch,
+                first_vram && first_state ? "vram and state" : first_vram ? "vram" : "state");
+    }
+    else if (ended)
+    {
+        fprintf(out, "hash check failed, %s ends before the run does\n", name);
+    }
+    else if (unchecked)
+    {
+        fprintf(out, "hash check failed, the run ends %llu frames before %s does\n", (unsigned long long)unchecked, name);
+    }
+    else
+    {
+        fprintf(out, "hash check passed, %llu frames match %s\n", (unsigned long long)frames, name);
+    }
+    fprintf(out, "hashing %.2f us per frame, %.1f of 32 ram pages rehashed per frame\n",
+            frames ? hasher.seconds * 1e6 / frames : 0.0, frames ? (double)hasher.pages_hashed / frames : 0.0);
+}
@@ -0,0 +1,107 @@
+#ifndef STATE_HASH_H
+#define STATE_HASH_H
+
+#include "cpu.hpp"
+#include <stdint.h>
+#include <stdio.h>
+
+// 64 bit hash of one 256 byte ram page. avx2 when the cpu has it, the scalar path gives the same
+// hash, so logs written on one machine check on any other
+uint64_t hash_page(const uint8_t* page);
+
+// the two paths hash_page picks between, exposed for checking them against each other
+uint64_t hash_page_scalar(const uint8_t* page);
+#if defined(__x86_64__) || defined(__i386__)
+uint64_t hash_page_avx2(const uint8_t* page);
+#endif
+
+struct frame_hashes
+{
+    uint64_t vram;
+    // ram, registers, ports and clocks, everything a later frame depends on except the rom
+    uint64_t state;
+    // the state without the clocks and the input ports, the same machine reached at another time or
+    // with other buttons held hashes alike. what a search dedups on
+    uint64_t timeless;
+};
+
+// hashes a machine at the end of every screen. every ram page keeps its hash and only the pages the
+// core marked dirty since the last frame are hashed again, the frame hashes are then a hash over the
+// page hashes. the caller says which pages are dirty, the core's dirty_pages also drives restore and
+// run-ahead, so only the code that clears it knows what it covers
+class state_hasher
+{
+public:
+    static const int ram_pages = 32;
+
+    // the first call after construction or reset hashes every page whatever dirty says
+    template<typename cpu_type>
+    frame_hashes hash(cpu_type* cpu, uint64_t dirty)
+    {
+        cpu->save_registers(&registers);
+        return hash_ram(cpu->ram(), dirty);
+    }
+
+    void reset() { primed = false; }
+
+    // the hash of every ram page, for a machine forked from this one to start its hasher from
+    const uint64_t* pages() const { return page_hashes; }
+    // primes the hasher with the page hashes of the machine it hashes next, taken with pages
+    void set_pages(const uint64_t* hashes);
+
+    uint64_t frames = 0;
+    uint64_t pages_hashed = 0;
+    double seconds = 0;
+
+private:
+    frame_hashes hash_ram(const uint8_t* ram, uint64_t dirty);
+
+    uint64_t page_hashes[ram_pages];
+    bool primed = false;
+    machine_registers registers;
+};
+
+// a golden run's hashes, one line of "frame vram state" in hex per frame. a run either writes the log
+// or checks itself against one, so a regression run verifies every frame without keeping a framebuffer
+class hash_log
+{
+public:
+    ~hash_log();
+
+    // write a new log, or check against an existing one
+    bool create(const char* name);
+    bool open(const char* name);
+
+    // call at the end of every screen with the frame number. dirty as for state_hasher
+    template<typename cpu_type>
+    void add(cpu_type* cpu, uint64_t frame, uint64_t dirty)
+    {
+        add(frame, hasher.hash(cpu, dirty));
+    }
+
+    // false if the log could not be written, a checked frame differed or the log and the run ended apart
+    bool close();
+
+    // what was written, or how the check went and where the run first left the log
+    void report(FILE* out) const;
+
+private:
+    void add(uint64_t frame, const frame_hashes& hashes);
+
+    state_hasher hasher;
+    FILE* file = nullptr;
+    const char* name = nullptr;
+    bool checking = false;
+    bool error = false;
+
+    uint64_t mismatches = 0;
+    // the log ran out before the run did
+    bool ended = false;
+    // frames the log has past the end of the run
+    uint64_t unchecked = 0;
+    uint64_t first_mismatch = 0;
+    bool first_vram = false;
+    bool first_state = false;
+};
+
+#endif
@@ -0,0 +1,122 @@
+#include "state_hash.hpp"
+#include "framebuffer.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+// g++ -O2 state_hash_check.cpp state_hash.cpp framebuffer.cpp -o state_hash_check
+// ./state_hash_check
+static void usage()
+{
+    fprintf(stderr,
+        "usage: state_hash_check\n"
+        "  hashes pages with both paths of hash_page and exits 2 if the avx2 one differs from the scalar one,\n"
+        "  a few fixed pages no longer hash to what hash logs were written with, or a flipped bit goes unseen\n");
+}
+
+// a hash log written by any build has to check on any other, so these never change
+struct golden_page
+{
+    const char* name;
+    uint8_t fill;
+    bool counting;
+    uint64_t hash;
+};
+
+static const golden_page golden[] = {
+    {"zeros", 0x00, false, 0x8ae94366c717a5b0ull},
+    {"0 to 255", 0x00, true, 0xef64c0045ccc5542ull},
+    {"ones", 0xff, false, 0x6112c66067c49f47ull},
+};
+
+int main(int argc, char** argv)
+{
+    if (argc != 1)
+    {
+        usage();
+        return 1;
+    }
+    (void)argv;
+
+    bool avx2 = false;
+#if defined(__x86_64__) || defined(__i386__)
+    avx2 = cpu_has_avx2();
+#endif
+    if (!avx2)
+    {
+        fprintf(stderr, "state_hash_check: no avx2 on this cpu, checking the scalar path alone\n");
+    }
+
+    // every flipped bit of a few base pages, then random pages
+    std::vector<std::vector<uint8_t>> pages;
+    srand(8080);
+    for (int base = 0; base < 3; ++base)
+    {
+        std::vector<uint8_t> page(256);
+        for (int i = 0; i < 256; ++i)
+        {
+            page[i] = base == 0 ? 0 : base == 1 ? 0xff : rand();
+        }
+        pages.push_back(page);
+        for (int bit = 0; bit < 256 * 8; ++bit)
+        {
+            pages.push_back(page);
+            pages.back()[bit / 8] ^= 1 << bit % 8;
+        }
+    }
+    for (int i = 0; i < 10000; ++i)
+    {
+        std::vector<uint8_t> page(256);
+        for (uint8_t& byte : page)
+        {
+            byte = rand();
+        }
+        pages.push_back(page);
+    }
+
+    int failed = 0;
+    for (const golden_page& page : golden)
+    {
+        uint8_t data[256];
+        for (int i = 0; i < 256; ++i)
+        {
+            data[i] = page.counting ? i : page.fill;
+        }
+        uint64_t hash = hash_page_scalar(data);
+        if (hash != page.hash)
+        {
+            fprintf(stderr, "page of %s hashes to %016llx, hash logs have %016llx\n", page.name,
+                    (unsigned long long)hash, (unsigned long long)page.hash);
+            ++failed;
+        }
+    }
+
+    size_t differ = 0, unseen = 0;
+    for (size_t i = 0; i < pages.size(); ++i)
+    {
+        uint64_t hash = hash_page_scalar(pages[i].data());
+#if defined(__x86_64__) || defined(__i386__)
+        if (avx2 && hash_page_avx2(pages[i].data()) != hash)
+        {
+            if (differ++ == 0)
+            {
+                fprintf(stderr, "page %zu hashes to %016llx with avx2, %016llx without\n", i,
+                        (unsigned long long)hash_page_avx2(pages[i].data()), (unsigned long long)hash);
+            }
+        }
+#endif
+        // the flipped bit pages follow their base, 2049 pages per base
+        size_t base = i / 2049 * 2049;
+        if (i < 3 * 2049 && i != base && hash == hash_page_scalar(pages[base].data()))
+        {
+            if (unseen++ == 0)
+            {
+                fprintf(stderr, "flipping bit %zu of base page %zu leaves its hash alone\n", i - base - 1, i / 2049);
+            }
+        }
+    }
+    fprintf(stderr, "%zu pages, %zu differ between the paths, %zu flipped bits unseen\n", pages.size(), differ, unseen);
+    failed += differ != 0 || unseen != 0;
+    return failed ? 2 : 0;
+}
@@ -0,0 +1,74 @@
+#ifndef STATE_SET_H
+#define STATE_SET_H
+
+#include <atomic>
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+
+// lock free set of 64 bit state hashes for any number of threads. open addressing with linear probing
+// over atomic words, an insert is loads and one compare and swap on an empty slot, and nothing is ever
+// removed. 0 marks an empty slot, so the hash 0 is kept as 1
+class state_set
+{
+public:
+    // room for at least capacity hashes, the table is kept at most half full
+    explicit state_set(size_t capacity)
+    {
+        size_t slots = 16;
+        while (slots < capacity * 2)
+        {
+            slots *= 2;
+        }
+        table.reset(new std::atomic<uint64_t>[slots]);
+        for (size_t i = 0; i < slots; ++i)
+        {
+            table[i].store(0, std::memory_order_relaxed);
+        }
+        mask = slots - 1;
+        limit = slots / 2;
+    }
+
+    // true if hash was not in the set yet. false too once the set is full, a full set reads as nothing new
+    bool insert(uint64_t hash)
+    {
+        hash = hash ? hash : 1;
+        // the low bits pick the slot, the hashes are already well mixed
+        for (size_t i = hash & mask;; i = (i + 1) & mask)
+        {
+            uint64_t seen = table[i].load(std::memory_order_relaxed);
+            if (seen == hash)
+            {
+                return false;
+            }
+            if (seen == 0)
+            {
+                if (count.load(std::memory_order_relaxed) >= limit)
+                {
+                    return false;
+                }
+                if (table[i].compare_exchange_strong(seen, hash, std::memory_order_relaxed))
+                {
+                    count.fetch_add(1, std::memory_order_relaxed);
+                    return true;
+                }
+                // another thread took the slot, it may have been for this very hash
+                if (seen == hash)
+                {
+                    return false;
+                }
+            }
+        }
+    }
+
+    size_t size() const { return count.load(std::memory_order_relaxed); }
+    bool full() const { return size() >= limit; }
+
+private:
+    std::unique_ptr<std::atomic<uint64_t>[]> table;
+    size_t mask;
+    size_t limit;
+    std::atomic<size_t> count{0};
+};
+
+#endif
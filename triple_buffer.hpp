@@ -0,0 +1,48 @@
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <atomic>
+#include <stdint.h>
+
+// lock free single producer, single consumer triple buffer.
+// the producer always has a buffer to write into and the consumer always reads the newest
+// complete one, neither side ever waits for the other. frames the consumer is too slow for are dropped
+template <typename T>
+class triple_buffer
+{
+public:
+    // producer: buffer to fill next
+    T& back() { return buffers[back_index]; }
+
+    // producer: hands the filled back buffer over, whatever was waiting unread is recycled
+    void publish()
+    {
+        back_index = middle.exchange(back_index | fresh, std::memory_order_acq_rel) & index_mask;
+    }
+
+    // consumer: swaps in the newest published buffer, returns false if nothing new was published
+    bool consume()
+    {
+        if (!(middle.load(std::memory_order_relaxed) & fresh))
+        {
+            return false;
+        }
+        front_index = middle.exchange(front_index, std::memory_order_acq_rel) & index_mask;
+        return true;
+    }
+
+    // consumer: buffer returned by the last successful consume
+    const T& front() const { return buffers[front_index]; }
+
+private:
+    static const uint8_t index_mask = 0x3;
+    static const uint8_t fresh = 0x4;
+
+    T buffers[3];
+    // index of the buffer in the middle, with fresh set while it holds an unread frame
+    alignas(64) std::atomic<uint8_t> middle{1};
+    alignas(64) uint8_t back_index = 0;
+    alignas(64) uint8_t front_index = 2;
+};
+
+#endif